@@ -15,11 +15,19 @@
 // Параметры тестового стенда
 //----------------------------
 
+#ifndef NUM_THREADS
 #define NUM_THREADS 8U
+#endif
+
+#ifndef NUM_HARDWARE_THREAD
 #define NUM_HARDWARE_THREAD 8U
+#endif
+
 #define CACHE_LINE_SIZE 64U
 
-const size_t NUM_ITERATIONS = 10000000U;
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 10000000U
+#endif
 
 //------------------------------------------------------------------
 // Array-based queue lock
@@ -126,7 +134,7 @@ void AQL_acquire(ArrayQueue_Lock* lock)
         if (iteration == ARRAYQUEUE_CYCLES_TO_YEILD)
         {
             iteration = 0U;
-            pthread_yield();
+            sched_yield();
         }
         iteration++;
     }
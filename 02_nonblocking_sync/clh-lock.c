@@ -0,0 +1,266 @@
+// Copyright Vladislav Alenik, 2024
+
+// Feature test macro.
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//----------------------------
+// Параметры тестового стенда
+//----------------------------
+
+#ifndef NUM_THREADS
+#define NUM_THREADS 8U
+#endif
+
+#ifndef NUM_HARDWARE_THREAD
+#define NUM_HARDWARE_THREAD 8U
+#endif
+
+#define CACHE_LINE_SIZE 64U
+
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 10000000U
+#endif
+
+//------------------------------------------------------------------
+// CLH lock
+//------------------------------------------------------------------
+// Оптимизации:
+// - FIFO fairness
+// - Инструкция x86 "pause" для энергоэффективного ожидания.
+// - Каждый поток ожидает только на линии кеша узла предшественника.
+// - Указатели на узлы хранятся в thread-local storage: размер очереди
+//   не ограничен, а захват не требует обращения к pthread_getspecific().
+// Узлы мигрируют между потоками: освободив блокировку, поток забирает себе
+// узел предшественника. Поэтому сами узлы выделяются в куче, а не в TLS.
+// Ограничение: у потока один узел, поэтому одновременно
+// он может удерживать только одну CLH-блокировку.
+//------------------------------------------------------------------
+
+#define spinloop_pause() __asm__ volatile("pause")
+
+typedef struct
+{
+    // Владелец узла удерживает блокировку или ожидает её.
+    _Atomic uint8_t locked;
+} __attribute__((aligned(CACHE_LINE_SIZE))) CLH_Node;
+
+_Static_assert(
+    sizeof(CLH_Node) == CACHE_LINE_SIZE,
+    "Invalid CLH_Node size\n");
+
+typedef struct
+{
+    // Узел последнего потока в очереди.
+    _Atomic(CLH_Node*) tail;
+} CLH_Lock;
+
+const uint32_t CLH_CYCLES_TO_YEILD = 10000;
+
+// Узел очереди текущего потока.
+_Thread_local CLH_Node* CLH_node;
+// Узел предшественника: станет узлом текущего потока после освобождения.
+_Thread_local CLH_Node* CLH_pred;
+
+CLH_Node* CLH_alloc_node()
+{
+    CLH_Node* node = aligned_alloc(CACHE_LINE_SIZE, sizeof(CLH_Node));
+    if (node == NULL)
+    {
+        printf("Unable to allocate CLH queue node\n");
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_store_explicit(&node->locked, 0, memory_order_relaxed);
+
+    return node;
+}
+
+void CLH_init(CLH_Lock* lock)
+{
+    // Фиктивный узел свободной блокировки.
+    atomic_store_explicit(&lock->tail, CLH_alloc_node(), memory_order_release);
+}
+
+void CLH_destroy(CLH_Lock* lock)
+{
+    // Узел в хвосте не принадлежит ни одному потоку.
+    free(atomic_load_explicit(&lock->tail, memory_order_relaxed));
+}
+
+void CLH_init_perthread()
+{
+    CLH_node = CLH_alloc_node();
+}
+
+void CLH_destroy_perthread()
+{
+    // После освобождения блокировки текущий узел потока больше никем не используется.
+    free(CLH_node);
+}
+
+void CLH_acquire(CLH_Lock* lock)
+{
+    CLH_Node* node = CLH_node;
+
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+
+    // Встаём в конец очереди.
+    CLH_Node* pred = atomic_exchange_explicit(&lock->tail, node, memory_order_acq_rel);
+
+    // Ждём на узле предшественника.
+    uint32_t iteration = 0U;
+    while (atomic_load_explicit(&pred->locked, memory_order_acquire) != 0)
+    {
+        spinloop_pause();
+
+        if (iteration == CLH_CYCLES_TO_YEILD)
+        {
+            iteration = 0U;
+            sched_yield();
+        }
+        iteration++;
+    }
+
+    CLH_pred = pred;
+}
+
+void CLH_release(CLH_Lock* lock)
+{
+    (void) lock;
+
+    CLH_Node* node = CLH_node;
+
+    // Узел предшественника больше никем не используется: забираем его себе.
+    CLH_node = CLH_pred;
+
+    atomic_store_explicit(&node->locked, 0, memory_order_release);
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+typedef struct {
+    size_t thread_i;
+    CLH_Lock* spinlock;
+} THREAD_ARGS;
+
+// Переменная, которую инкрементируют все потоки.
+uint32_t var = 0U;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    printf("I am thread#%zu\n", args->thread_i);
+
+    CLH_init_perthread();
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        // Создание критической секции с помощью spinlock-а.
+        CLH_acquire(args->spinlock);
+
+        var++;
+
+        CLH_release(args->spinlock);
+    }
+
+    CLH_destroy_perthread();
+
+    return NULL;
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+int main()
+{
+    // Инициализируем объект синхронизации.
+    CLH_Lock spinlock;
+    CLH_init(&spinlock);
+
+    // Инициализируем параметры потоков.
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].spinlock = &spinlock;
+    }
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Предположения о системе:
+        // - Система имеет NUM_HARDWARE_THREAD аппаратных потоков.
+        //   Это число возможно извлекать из системы напрямую
+        // - Все аппаратные потоки с 0 по NUM_HARDWARE_THREAD-1 активны.
+        //   Это требование может нарушаться при выходе из строя какого-нибудь из ядер процессора.
+        size_t hart_i = i % NUM_HARDWARE_THREAD;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    CLH_destroy(&spinlock);
+
+    // Выводим результат вычисления.
+    printf("Result of the computation: %u\n", var);
+
+    return EXIT_SUCCESS;
+}
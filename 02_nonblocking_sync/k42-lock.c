@@ -0,0 +1,300 @@
+// Copyright Vladislav Alenik, 2024
+
+// Feature test macro.
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//----------------------------
+// Параметры тестового стенда
+//----------------------------
+
+#ifndef NUM_THREADS
+#define NUM_THREADS 8U
+#endif
+
+#ifndef NUM_HARDWARE_THREAD
+#define NUM_HARDWARE_THREAD 8U
+#endif
+
+#define CACHE_LINE_SIZE 64U
+
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 10000000U
+#endif
+
+//------------------------------------------------------------------
+// K42 lock
+//------------------------------------------------------------------
+// Вариант MCS lock, не передающий узел очереди от захвата к освобождению.
+// Оптимизации:
+// - FIFO fairness
+// - Инструкция x86 "pause" для энергоэффективного ожидания.
+// - Каждый поток ожидает только на линии кеша своего узла очереди.
+// - Сама блокировка является узлом очереди: захватив её, поток
+//   переносит ссылку на преемника из своего узла в блокировку.
+//   Поэтому узел из thread-local storage нужен только во время ожидания,
+//   а поток может удерживать сколько угодно K42-блокировок одновременно.
+//------------------------------------------------------------------
+
+#define spinloop_pause() __asm__ volatile("pause")
+
+typedef struct K42_Node
+{
+    // В узле ожидающего потока: K42_WAITING до передачи блокировки.
+    // В блокировке: последний поток в очереди (NULL - блокировка свободна,
+    // сама блокировка - захвачена без ожидающих).
+    _Atomic(struct K42_Node*) tail;
+    // Следующий поток в очереди.
+    _Atomic(struct K42_Node*) next;
+} __attribute__((aligned(CACHE_LINE_SIZE))) K42_Node;
+
+_Static_assert(
+    sizeof(K42_Node) == CACHE_LINE_SIZE,
+    "Invalid K42_Node size\n");
+
+typedef K42_Node K42_Lock;
+
+#define K42_WAITING ((K42_Node*) 1U)
+
+const uint32_t K42_CYCLES_TO_YEILD = 10000;
+
+// Узел очереди текущего потока.
+_Thread_local K42_Node K42_node;
+
+void K42_init(K42_Lock* lock)
+{
+    atomic_store_explicit(&lock->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&lock->tail, NULL, memory_order_release);
+}
+
+void K42_acquire(K42_Lock* lock)
+{
+    K42_Node* node = &K42_node;
+
+    while (1)
+    {
+        K42_Node* prev = atomic_load_explicit(&lock->tail, memory_order_relaxed);
+        if (prev == NULL)
+        {
+            // Блокировка свободна: захватываем её без постановки в очередь.
+            if (atomic_compare_exchange_weak_explicit(
+                &lock->tail, &prev, lock, memory_order_acquire, memory_order_relaxed))
+            {
+                return;
+            }
+
+            continue;
+        }
+
+        atomic_store_explicit(&node->tail, K42_WAITING, memory_order_relaxed);
+        atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+        // Встаём в конец очереди.
+        if (!atomic_compare_exchange_weak_explicit(
+            &lock->tail, &prev, node, memory_order_acq_rel, memory_order_relaxed))
+        {
+            continue;
+        }
+
+        // Сообщаем предшественнику о себе и ждём на собственном узле.
+        atomic_store_explicit(&prev->next, node, memory_order_release);
+
+        uint32_t iteration = 0U;
+        while (atomic_load_explicit(&node->tail, memory_order_acquire) == K42_WAITING)
+        {
+            spinloop_pause();
+
+            if (iteration == K42_CYCLES_TO_YEILD)
+            {
+                iteration = 0U;
+                sched_yield();
+            }
+            iteration++;
+        }
+
+        // Блокировка получена: переносим ссылку на преемника в блокировку.
+        K42_Node* succ = atomic_load_explicit(&node->next, memory_order_acquire);
+        if (succ == NULL)
+        {
+            atomic_store_explicit(&lock->next, NULL, memory_order_relaxed);
+
+            // Мы последние в очереди: возвращаем хвост блокировке.
+            K42_Node* expected = node;
+            if (atomic_compare_exchange_strong_explicit(
+                &lock->tail, &expected, lock, memory_order_acq_rel, memory_order_relaxed))
+            {
+                return;
+            }
+
+            // Преемник уже встал в очередь, но ещё не записал себя в node->next.
+            iteration = 0U;
+            while ((succ = atomic_load_explicit(&node->next, memory_order_acquire)) == NULL)
+            {
+                spinloop_pause();
+
+                if (iteration == K42_CYCLES_TO_YEILD)
+                {
+                    iteration = 0U;
+                    sched_yield();
+                }
+                iteration++;
+            }
+        }
+
+        atomic_store_explicit(&lock->next, succ, memory_order_relaxed);
+        return;
+    }
+}
+
+void K42_release(K42_Lock* lock)
+{
+    K42_Node* succ = atomic_load_explicit(&lock->next, memory_order_acquire);
+    if (succ == NULL)
+    {
+        // Очередь пуста: освобождаем блокировку.
+        K42_Node* expected = lock;
+        if (atomic_compare_exchange_strong_explicit(
+            &lock->tail, &expected, NULL, memory_order_release, memory_order_relaxed))
+        {
+            return;
+        }
+
+        // Преемник уже встал в очередь, но ещё не записал себя в lock->next.
+        uint32_t iteration = 0U;
+        while ((succ = atomic_load_explicit(&lock->next, memory_order_acquire)) == NULL)
+        {
+            spinloop_pause();
+
+            if (iteration == K42_CYCLES_TO_YEILD)
+            {
+                iteration = 0U;
+                sched_yield();
+            }
+            iteration++;
+        }
+    }
+
+    atomic_store_explicit(&succ->tail, NULL, memory_order_release);
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+typedef struct {
+    size_t thread_i;
+    K42_Lock* spinlock;
+} THREAD_ARGS;
+
+// Переменная, которую инкрементируют все потоки.
+uint32_t var = 0U;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    printf("I am thread#%zu\n", args->thread_i);
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        // Создание критической секции с помощью spinlock-а.
+        K42_acquire(args->spinlock);
+
+        var++;
+
+        K42_release(args->spinlock);
+    }
+
+    return NULL;
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+int main()
+{
+    // Инициализируем объект синхронизации.
+    K42_Lock spinlock;
+    K42_init(&spinlock);
+
+    // Инициализируем параметры потоков.
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].spinlock = &spinlock;
+    }
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Предположения о системе:
+        // - Система имеет NUM_HARDWARE_THREAD аппаратных потоков.
+        //   Это число возможно извлекать из системы напрямую
+        // - Все аппаратные потоки с 0 по NUM_HARDWARE_THREAD-1 активны.
+        //   Это требование может нарушаться при выходе из строя какого-нибудь из ядер процессора.
+        size_t hart_i = i % NUM_HARDWARE_THREAD;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Выводим результат вычисления.
+    printf("Result of the computation: %u\n", var);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+// Copyright Vladislav Alenik, 2024
+
+// Feature test macro.
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//----------------------------
+// Параметры тестового стенда
+//----------------------------
+
+#ifndef NUM_THREADS
+#define NUM_THREADS 8U
+#endif
+
+#ifndef NUM_HARDWARE_THREAD
+#define NUM_HARDWARE_THREAD 8U
+#endif
+
+#define CACHE_LINE_SIZE 64U
+
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 10000000U
+#endif
+
+//------------------------------------------------------------------
+// MCS lock
+//------------------------------------------------------------------
+// Оптимизации:
+// - FIFO fairness
+// - Инструкция x86 "pause" для энергоэффективного ожидания.
+// - Каждый поток ожидает только на линии кеша своего узла очереди.
+// - Узел очереди хранится в thread-local storage: в отличие от
+//   array-based queue lock размер очереди не ограничен,
+//   а захват не требует обращения к pthread_getspecific().
+// Ограничение: у потока один узел, поэтому одновременно
+// он может удерживать только одну MCS-блокировку.
+//------------------------------------------------------------------
+
+#define spinloop_pause() __asm__ volatile("pause")
+
+typedef struct MCS_Node
+{
+    // Следующий поток в очереди.
+    _Atomic(struct MCS_Node*) next;
+    // Поток ожидает передачи блокировки.
+    _Atomic uint8_t locked;
+} __attribute__((aligned(CACHE_LINE_SIZE))) MCS_Node;
+
+_Static_assert(
+    sizeof(MCS_Node) == CACHE_LINE_SIZE,
+    "Invalid MCS_Node size\n");
+
+typedef struct
+{
+    // Последний поток в очереди (NULL - блокировка свободна).
+    _Atomic(MCS_Node*) tail;
+} MCS_Lock;
+
+const uint32_t MCS_CYCLES_TO_YEILD = 10000;
+
+// Узел очереди текущего потока.
+_Thread_local MCS_Node MCS_node;
+
+void MCS_init(MCS_Lock* lock)
+{
+    atomic_store_explicit(&lock->tail, NULL, memory_order_release);
+}
+
+void MCS_acquire(MCS_Lock* lock)
+{
+    MCS_Node* node = &MCS_node;
+
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+
+    // Встаём в конец очереди.
+    MCS_Node* prev = atomic_exchange_explicit(&lock->tail, node, memory_order_acq_rel);
+    if (prev == NULL)
+    {
+        return;
+    }
+
+    // Сообщаем предшественнику о себе и ждём на собственном узле.
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+
+    uint32_t iteration = 0U;
+    while (atomic_load_explicit(&node->locked, memory_order_acquire) != 0)
+    {
+        spinloop_pause();
+
+        if (iteration == MCS_CYCLES_TO_YEILD)
+        {
+            iteration = 0U;
+            sched_yield();
+        }
+        iteration++;
+    }
+}
+
+void MCS_release(MCS_Lock* lock)
+{
+    MCS_Node* node = &MCS_node;
+
+    MCS_Node* next = atomic_load_explicit(&node->next, memory_order_acquire);
+    if (next == NULL)
+    {
+        // Очередь пуста: освобождаем блокировку.
+        MCS_Node* expected = node;
+        if (atomic_compare_exchange_strong_explicit(
+            &lock->tail, &expected, NULL, memory_order_release, memory_order_relaxed))
+        {
+            return;
+        }
+
+        // Преемник уже встал в очередь, но ещё не записал себя в node->next.
+        uint32_t iteration = 0U;
+        while ((next = atomic_load_explicit(&node->next, memory_order_acquire)) == NULL)
+        {
+            spinloop_pause();
+
+            if (iteration == MCS_CYCLES_TO_YEILD)
+            {
+                iteration = 0U;
+                sched_yield();
+            }
+            iteration++;
+        }
+    }
+
+    atomic_store_explicit(&next->locked, 0, memory_order_release);
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+typedef struct {
+    size_t thread_i;
+    MCS_Lock* spinlock;
+} THREAD_ARGS;
+
+// Переменная, которую инкрементируют все потоки.
+uint32_t var = 0U;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    printf("I am thread#%zu\n", args->thread_i);
+
+    for (size_t i = 0U; i < NUM_ITERATIONS; ++i)
+    {
+        // Создание критической секции с помощью spinlock-а.
+        MCS_acquire(args->spinlock);
+
+        var++;
+
+        MCS_release(args->spinlock);
+    }
+
+    return NULL;
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+int main()
+{
+    // Инициализируем объект синхронизации.
+    MCS_Lock spinlock;
+    MCS_init(&spinlock);
+
+    // Инициализируем параметры потоков.
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].spinlock = &spinlock;
+    }
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Предположения о системе:
+        // - Система имеет NUM_HARDWARE_THREAD аппаратных потоков.
+        //   Это число возможно извлекать из системы напрямую
+        // - Все аппаратные потоки с 0 по NUM_HARDWARE_THREAD-1 активны.
+        //   Это требование может нарушаться при выходе из строя какого-нибудь из ядер процессора.
+        size_t hart_i = i % NUM_HARDWARE_THREAD;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Выводим результат вычисления.
+    printf("Result of the computation: %u\n", var);
+
+    return EXIT_SUCCESS;
+}
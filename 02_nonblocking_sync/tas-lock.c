@@ -15,10 +15,17 @@
 // Параметры тестового стенда
 //----------------------------
 
+#ifndef NUM_THREADS
 #define NUM_THREADS 32U
+#endif
+
+#ifndef NUM_HARDWARE_THREAD
 #define NUM_HARDWARE_THREAD 8U
+#endif
 
-const size_t NUM_ITERATIONS = 10000000U;
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 10000000U
+#endif
 
 //------------------------------------------------------------------
 // TAS lock
@@ -15,10 +15,17 @@
 // Параметры тестового стенда
 //----------------------------
 
+#ifndef NUM_THREADS
 #define NUM_THREADS 8U
+#endif
+
+#ifndef NUM_HARDWARE_THREAD
 #define NUM_HARDWARE_THREAD 8U
+#endif
 
-const size_t NUM_ITERATIONS = 10000000U;
+#ifndef NUM_ITERATIONS
+#define NUM_ITERATIONS 10000000U
+#endif
 
 //------------------------------------------------------------------
 // Ticket lock
@@ -58,7 +65,7 @@ void TicketLock_acquire(TicketLock* lock)
         if (iteration == TICKET_CYCLES_TO_YEILD)
         {
             iteration = 0U;
-            pthread_yield();
+            sched_yield();
         }
         iteration++;
     }
@@ -0,0 +1,339 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define QUEUE_SIZE     256U
+#define NUM_ITERATIONS 10000000ULL
+
+#define BLOCK_SIZE 256U
+
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#define NUM_HARDWARE_THREADS 4U
+
+#include "broadcast-ring.h"
+#include "spsc-ring.h"
+
+typedef struct {
+    uint64_t seq;
+    uint8_t payload[BLOCK_SIZE - sizeof(uint64_t)];
+} BLOCK;
+
+// Читатели, каждый из которых должен увидеть каждый блок.
+typedef enum {
+    STAGE_WRITER      = 0,
+    STAGE_CHECKSUMMER = 1,
+    STAGE_REPLICATOR  = 2,
+    NUM_STAGES        = 3
+} STAGE;
+
+const char* stage_names[NUM_STAGES] = {"writer", "checksummer", "replicator"};
+
+// Ожидание при пустой или полной очереди.
+void backoff(uint32_t* retry)
+{
+    (*retry)++;
+
+    if (ENABLE_BACKOFF && *retry == NUM_RETRIES)
+    {
+        *retry = 0U;
+        sched_yield();
+    }
+}
+
+void fill_block(BLOCK* block, uint64_t snd_i)
+{
+    block->seq = snd_i;
+    memset(block->payload, (uint8_t) snd_i, sizeof(block->payload));
+}
+
+// Работа стадии: проход по всему блоку с подсчётом контрольной суммы.
+void process_block(const BLOCK* block, uint64_t rcv_i, STAGE stage)
+{
+    uint32_t checksum = 0U;
+    for (size_t i = 0U; i < sizeof(block->payload); ++i)
+    {
+        checksum += block->payload[i];
+    }
+
+    // Compare result:
+    if (block->seq != rcv_i || checksum != (uint32_t) sizeof(block->payload) * (uint8_t) rcv_i)
+    {
+        printf("Invalid block at %s: expected %lu, got %lu\n", stage_names[stage], rcv_i, block->seq);
+        exit(EXIT_FAILURE);
+    }
+}
+
+//------------------------------------
+// Отдельная SPSC очередь на читателя
+//------------------------------------
+// Писатель копирует каждый блок в очередь каждого читателя.
+
+DEFINE_SPSC_RING(BLOCK_RING, BLOCK, QUEUE_SIZE)
+
+BLOCK_RING copy_rings[NUM_STAGES];
+
+void copy_producer()
+{
+    BLOCK block;
+
+    for (uint64_t snd_i = 0U; snd_i < NUM_ITERATIONS; ++snd_i)
+    {
+        fill_block(&block, snd_i);
+
+        for (size_t stage = 0U; stage < NUM_STAGES; ++stage)
+        {
+            uint32_t retry = 0U;
+            while (!BLOCK_RING_push(&copy_rings[stage], block))
+            {
+                backoff(&retry);
+            }
+        }
+    }
+}
+
+void copy_consumer(STAGE stage)
+{
+    BLOCK block;
+
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_ITERATIONS; ++rcv_i)
+    {
+        uint32_t retry = 0U;
+        while (!BLOCK_RING_pop(&copy_rings[stage], &block))
+        {
+            backoff(&retry);
+        }
+
+        process_block(&block, rcv_i, stage);
+    }
+}
+
+//-------------------------
+// Широковещательный буфер
+//-------------------------
+// Писатель записывает блок один раз, читатели обрабатывают его на месте.
+
+BROADCAST_RING ring;
+SEQUENCE stage_sequences[NUM_STAGES];
+SEQUENCE_BARRIER stage_barriers[NUM_STAGES];
+
+void broadcast_producer()
+{
+    for (uint64_t snd_i = 0U; snd_i < NUM_ITERATIONS; ++snd_i)
+    {
+        BLOCK* block = NULL;
+        uint32_t retry = 0U;
+        while ((block = broadcast_ring_claim(&ring)) == NULL)
+        {
+            backoff(&retry);
+        }
+
+        fill_block(block, snd_i);
+
+        broadcast_ring_publish(&ring);
+    }
+}
+
+void broadcast_consumer(STAGE stage)
+{
+    uint64_t rcv_i = 0U;
+    uint32_t retry = 0U;
+
+    while (rcv_i < NUM_ITERATIONS)
+    {
+        uint64_t available = sequence_barrier_available(&stage_barriers[stage]);
+        if (available == rcv_i)
+        {
+            backoff(&retry);
+            continue;
+        }
+
+        // Обрабатываем все доступные блоки и публикуем прогресс одной записью.
+        for (; rcv_i < available; ++rcv_i)
+        {
+            process_block(broadcast_ring_entry(&ring, rcv_i), rcv_i, stage);
+        }
+
+        sequence_set(&stage_sequences[stage], rcv_i);
+        retry = 0U;
+    }
+}
+
+// Все читатели зависят только от писателя; писатель ждёт самого медленного из них.
+void setup_fan_out()
+{
+    broadcast_ring_init(&ring, QUEUE_SIZE, sizeof(BLOCK));
+
+    const SEQUENCE* cursor[] = {&ring.cursor};
+    for (size_t stage = 0U; stage < NUM_STAGES; ++stage)
+    {
+        sequence_init(&stage_sequences[stage]);
+        sequence_barrier_init(&stage_barriers[stage], cursor, 1U);
+        broadcast_ring_add_gating(&ring, &stage_sequences[stage]);
+    }
+}
+
+// Ромб: writer и checksummer читают параллельно, replicator обрабатывает блок
+// только после них обоих; писатель ждёт только replicator.
+void setup_diamond()
+{
+    broadcast_ring_init(&ring, QUEUE_SIZE, sizeof(BLOCK));
+
+    for (size_t stage = 0U; stage < NUM_STAGES; ++stage)
+    {
+        sequence_init(&stage_sequences[stage]);
+    }
+
+    const SEQUENCE* cursor[] = {&ring.cursor};
+    sequence_barrier_init(&stage_barriers[STAGE_WRITER],      cursor, 1U);
+    sequence_barrier_init(&stage_barriers[STAGE_CHECKSUMMER], cursor, 1U);
+
+    const SEQUENCE* upstream[] = {&stage_sequences[STAGE_WRITER], &stage_sequences[STAGE_CHECKSUMMER]};
+    sequence_barrier_init(&stage_barriers[STAGE_REPLICATOR], upstream, 2U);
+
+    broadcast_ring_add_gating(&ring, &stage_sequences[STAGE_REPLICATOR]);
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS (1U + NUM_STAGES)
+
+typedef struct {
+    size_t thread_i;
+    void (*producer)();
+    void (*consumer)(STAGE stage);
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->thread_i == 0U)
+    {
+        args->producer();
+    }
+    else
+    {
+        args->consumer((STAGE) (args->thread_i - 1U));
+    }
+
+    return NULL;
+}
+
+// Запускает писателя и всех читателей и возвращает время выполнения в секундах.
+double run_threads(void (*producer)(), void (*consumer)(STAGE stage))
+{
+    THREAD_ARGS args[NUM_THREADS];
+    pthread_t tids[NUM_THREADS];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].producer = producer;
+        args[i].consumer = consumer;
+
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&tids[i], &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+int main()
+{
+    printf("%-28s %14s %12s\n", "Topology", "Blocks/s", "MiB/s");
+
+    for (size_t stage = 0U; stage < NUM_STAGES; ++stage)
+    {
+        BLOCK_RING_init(&copy_rings[stage]);
+    }
+
+    double seconds = run_threads(copy_producer, copy_consumer);
+    printf("%-28s %14.0f %12.1f\n", "spsc per consumer (copy)",
+        NUM_ITERATIONS / seconds, NUM_ITERATIONS * sizeof(BLOCK) / seconds / (1024.0 * 1024.0));
+
+    setup_fan_out();
+    seconds = run_threads(broadcast_producer, broadcast_consumer);
+    printf("%-28s %14.0f %12.1f\n", "broadcast fan-out",
+        NUM_ITERATIONS / seconds, NUM_ITERATIONS * sizeof(BLOCK) / seconds / (1024.0 * 1024.0));
+    broadcast_ring_free(&ring);
+
+    setup_diamond();
+    seconds = run_threads(broadcast_producer, broadcast_consumer);
+    printf("%-28s %14.0f %12.1f\n", "broadcast diamond",
+        NUM_ITERATIONS / seconds, NUM_ITERATIONS * sizeof(BLOCK) / seconds / (1024.0 * 1024.0));
+    broadcast_ring_free(&ring);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_BROADCAST_RING
+#define MSUSEM_BROADCAST_RING
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <stdatomic.h>
+
+//-----------------------------------
+// Широковещательный кольцевой буфер
+//-----------------------------------
+// Очередь с одним писателем и несколькими читателями, каждый из которых видит каждый элемент
+// (в стиле LMAX Disruptor). Элемент записывается в буфер один раз и читается на месте всеми читателями.
+//
+// Состояние выражается счётчиками (последовательностями) SEQUENCE:
+// - курсор писателя - количество опубликованных элементов;
+// - последовательность читателя - количество элементов, которые он обработал.
+// Читатель ждёт на барьере SEQUENCE_BARRIER, который собирает минимум по последовательностям,
+// от которых зависит читатель: курсору писателя или последовательностям предшествующих стадий.
+// Писатель ждёт на "замыкающих" последовательностях (gating sequences) - последовательностях
+// читателей последних стадий, так что он не обгоняет самого медленного из них.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+#define BROADCAST_MAX_DEPENDENCIES 8U
+
+// Каждая последовательность занимает отдельную кеш-линию.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t value;
+} SEQUENCE;
+
+typedef struct {
+    const SEQUENCE* deps[BROADCAST_MAX_DEPENDENCIES];
+    uint32_t num_deps;
+} SEQUENCE_BARRIER;
+
+typedef struct {
+    uint8_t* entries;
+    uint32_t size;
+    uint32_t entry_size;
+
+    // Замыкающие последовательности.
+    const SEQUENCE* gating[BROADCAST_MAX_DEPENDENCIES];
+    uint32_t num_gating;
+
+    // Поля писателя.
+    _Alignas(CACHE_LINE_SIZE) uint64_t next;
+    uint64_t cached_gating;
+
+    SEQUENCE cursor;
+} BROADCAST_RING;
+
+void sequence_init(SEQUENCE* sequence)
+{
+    atomic_init(&sequence->value, 0U);
+}
+
+uint64_t sequence_get(const SEQUENCE* sequence)
+{
+    return atomic_load_explicit(&sequence->value, memory_order_acquire);
+}
+
+void sequence_set(SEQUENCE* sequence, uint64_t value)
+{
+    atomic_store_explicit(&sequence->value, value, memory_order_release);
+}
+
+uint64_t sequence_min(const SEQUENCE* const* sequences, uint32_t num_sequences)
+{
+    uint64_t min = UINT64_MAX;
+    for (uint32_t i = 0U; i < num_sequences; ++i)
+    {
+        uint64_t value = sequence_get(sequences[i]);
+        if (value < min)
+        {
+            min = value;
+        }
+    }
+
+    return min;
+}
+
+//------------------
+// Буфер и писатель
+//------------------
+
+void broadcast_ring_init(BROADCAST_RING* ring, uint32_t size, uint32_t entry_size)
+{
+    if (size == 0 || ((size - 1) & size) != 0)
+    {
+        printf("broadcast_ring_init: size (%u) is expected to be power of two\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    // Выравниваем элементы по кеш-линии, чтобы соседние элементы не делили линию.
+    entry_size = (entry_size + CACHE_LINE_SIZE - 1U) & ~(CACHE_LINE_SIZE - 1U);
+
+    ring->entries = (uint8_t*) aligned_alloc(CACHE_LINE_SIZE, (size_t) size * entry_size);
+    if (ring->entries == NULL)
+    {
+        printf("broadcast_ring_init: size (%u) is too big\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    ring->size = size;
+    ring->entry_size = entry_size;
+    ring->num_gating = 0U;
+    ring->next = 0U;
+    // Первый же вызов broadcast_ring_claim() читает замыкающие последовательности
+    // и проверяет, что они зарегистрированы.
+    ring->cached_gating = 0U - (uint64_t) size;
+    sequence_init(&ring->cursor);
+}
+
+void broadcast_ring_free(BROADCAST_RING* ring)
+{
+    free(ring->entries);
+}
+
+// Регистрирует последовательность читателя последней стадии.
+// Вызывается до запуска писателя; писатель требует хотя бы одну замыкающую последовательность.
+void broadcast_ring_add_gating(BROADCAST_RING* ring, const SEQUENCE* sequence)
+{
+    if (ring->num_gating == BROADCAST_MAX_DEPENDENCIES)
+    {
+        printf("broadcast_ring_add_gating: too many gating sequences\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ring->gating[ring->num_gating++] = sequence;
+}
+
+void* broadcast_ring_entry(const BROADCAST_RING* ring, uint64_t seq)
+{
+    return ring->entries + (size_t) (seq & (ring->size - 1U)) * ring->entry_size;
+}
+
+// Возвращает указатель на следующий элемент для записи или NULL,
+// если самый медленный читатель ещё не освободил его.
+void* broadcast_ring_claim(BROADCAST_RING* ring)
+{
+    uint64_t next = ring->next;
+
+    if (next - ring->cached_gating == ring->size)
+    {
+        // Минимум по пустому набору равен UINT64_MAX: без замыкающих последовательностей
+        // писатель перезаписывал бы непрочитанные элементы.
+        if (ring->num_gating == 0U)
+        {
+            printf("broadcast_ring_claim: no gating sequences registered\n");
+            exit(EXIT_FAILURE);
+        }
+
+        ring->cached_gating = sequence_min(ring->gating, ring->num_gating);
+
+        if (next - ring->cached_gating == ring->size)
+        {
+            return NULL;
+        }
+    }
+
+    return broadcast_ring_entry(ring, next);
+}
+
+// Публикует элемент, полученный из broadcast_ring_claim().
+void broadcast_ring_publish(BROADCAST_RING* ring)
+{
+    ring->next += 1U;
+    sequence_set(&ring->cursor, ring->next);
+}
+
+//-----------------
+// Барьер читателя
+//-----------------
+
+void sequence_barrier_init(SEQUENCE_BARRIER* barrier, const SEQUENCE* const* deps, uint32_t num_deps)
+{
+    if (num_deps == 0U || num_deps > BROADCAST_MAX_DEPENDENCIES)
+    {
+        printf("sequence_barrier_init: invalid number of dependencies (%u)\n", num_deps);
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0U; i < num_deps; ++i)
+    {
+        barrier->deps[i] = deps[i];
+    }
+
+    barrier->num_deps = num_deps;
+}
+
+// Количество элементов, доступных читателю за барьером.
+// Читатель обрабатывает элементы [своя последовательность, результат) пакетом
+// и затем публикует свою последовательность одной записью.
+uint64_t sequence_barrier_available(const SEQUENCE_BARRIER* barrier)
+{
+    return sequence_min(barrier->deps, barrier->num_deps);
+}
+
+#endif // MSUSEM_BROADCAST_RING
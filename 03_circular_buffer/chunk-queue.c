@@ -0,0 +1,277 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+// Ёмкость ограниченной очереди и размер блока неограниченной очереди (в элементах).
+#define QUEUE_SIZE 1024U
+#define CHUNK_SIZE 1024U
+
+// Писатель выдаёт пачки, многократно превышающие ёмкость ограниченной очереди,
+// и между пачками ждёт, пока читатель не разберёт предыдущую.
+#define BURST_SIZE (64U * QUEUE_SIZE)
+#define NUM_BURSTS 1000U
+
+#define ENABLE_PADDING  1
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "circular-buffer.h"
+#include "chunk-queue.h"
+
+QUEUE bounded_queue;
+CHUNK_QUEUE unbounded_queue;
+
+typedef struct {
+    void (*push)(uint64_t elem);
+    bool (*pop)(uint64_t* elem);
+
+    // Количество прочитанных элементов, обновляется в конце каждой пачки.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t consumed;
+
+    // Время, проведённое писателем внутри пачек.
+    uint64_t producer_ns;
+    // Количество malloc() после прогрева.
+    uint64_t warm_allocs;
+} BENCH;
+
+// Ожидание при пустой или полной очереди.
+void backoff(uint32_t* retry)
+{
+    (*retry)++;
+
+    if (ENABLE_BACKOFF && *retry == NUM_RETRIES)
+    {
+        *retry = 0U;
+        sched_yield();
+    }
+}
+
+uint64_t time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------
+// Операции над очередями
+//------------------------
+
+// Ограниченная очередь: при заполнении писатель ждёт читателя.
+void bounded_push(uint64_t elem)
+{
+    uint32_t retry = 0U;
+    while (!queue_enqueue(&bounded_queue, elem))
+    {
+        backoff(&retry);
+    }
+}
+
+bool bounded_pop(uint64_t* elem)
+{
+    return queue_dequeue(&bounded_queue, elem);
+}
+
+// Неограниченная очередь: запись не отказывает.
+void unbounded_push(uint64_t elem)
+{
+    chunk_queue_enqueue(&unbounded_queue, elem);
+}
+
+bool unbounded_pop(uint64_t* elem)
+{
+    return chunk_queue_dequeue(&unbounded_queue, elem);
+}
+
+//---------------------
+// Писатель и читатель
+//---------------------
+
+void producer(BENCH* bench)
+{
+    uint64_t snd_i = 0U;
+
+    for (uint32_t burst = 0U; burst < NUM_BURSTS; ++burst)
+    {
+        uint64_t start = time_ns();
+
+        for (uint32_t i = 0U; i < BURST_SIZE; ++i, ++snd_i)
+        {
+            bench->push(snd_i);
+        }
+
+        bench->producer_ns += time_ns() - start;
+
+        // Первые две пачки прогревают кеш блоков: последний блок пачки
+        // остаётся текущим у читателя, пока не начнётся следующая.
+        if (burst == 1U)
+        {
+            bench->warm_allocs = unbounded_queue.num_allocs;
+        }
+
+        // Пауза между пачками.
+        uint32_t retry = 0U;
+        while (atomic_load_explicit(&bench->consumed, memory_order_acquire) != snd_i)
+        {
+            backoff(&retry);
+        }
+    }
+
+    bench->warm_allocs = unbounded_queue.num_allocs - bench->warm_allocs;
+}
+
+void consumer(BENCH* bench)
+{
+    for (uint64_t rcv_i = 0U; rcv_i < (uint64_t) NUM_BURSTS * BURST_SIZE; ++rcv_i)
+    {
+        uint64_t snd_i = 0U;
+        uint32_t retry = 0U;
+        while (!bench->pop(&snd_i))
+        {
+            backoff(&retry);
+        }
+
+        // Compare result:
+        if (snd_i != rcv_i)
+        {
+            printf("Invalid queue element: expected %lu, got %lu\n", rcv_i, snd_i);
+            exit(EXIT_FAILURE);
+        }
+
+        if ((rcv_i + 1U) % BURST_SIZE == 0U)
+        {
+            atomic_store_explicit(&bench->consumed, rcv_i + 1U, memory_order_release);
+        }
+    }
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS 2U
+
+void* thread_producer(void* bench)
+{
+    producer((BENCH*) bench);
+    return NULL;
+}
+
+void* thread_consumer(void* bench)
+{
+    consumer((BENCH*) bench);
+    return NULL;
+}
+
+// Запускает пару писатель-читатель и возвращает время выполнения в секундах.
+double run_threads(BENCH* bench)
+{
+    void* (*funcs[NUM_THREADS])(void*) = {thread_producer, thread_consumer};
+    pthread_t tids[NUM_THREADS];
+
+    uint64_t start = time_ns();
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&tids[i], &thread_attributes, funcs[i], bench);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return 1e-9 * (time_ns() - start);
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+void run_bench(const char* name, void (*push)(uint64_t), bool (*pop)(uint64_t*))
+{
+    BENCH bench = {.push = push, .pop = pop, .producer_ns = 0U, .warm_allocs = 0U};
+    atomic_init(&bench.consumed, 0U);
+
+    uint64_t num_elems = (uint64_t) NUM_BURSTS * BURST_SIZE;
+    double seconds = run_threads(&bench);
+
+    printf("%-10s %14.0f %18.2f %10lu %14lu\n", name,
+        num_elems / seconds, (double) bench.producer_ns / num_elems,
+        (push == unbounded_push)? unbounded_queue.num_allocs : 0U,
+        (push == unbounded_push)? bench.warm_allocs : 0U);
+}
+
+int main()
+{
+    printf("Burst size: %u elements, bounded capacity: %u elements, chunk: %u elements\n",
+        BURST_SIZE, QUEUE_SIZE, CHUNK_SIZE);
+    printf("%-10s %14s %18s %10s %14s\n", "Queue", "Elems/s", "Producer ns/elem", "Mallocs", "Warm mallocs");
+
+    queue_init(&bounded_queue, QUEUE_SIZE);
+    chunk_queue_init(&unbounded_queue);
+
+    run_bench("bounded", bounded_push, bounded_pop);
+    run_bench("unbounded", unbounded_push, unbounded_pop);
+
+    queue_free(&bounded_queue);
+    chunk_queue_free(&unbounded_queue);
+
+    return EXIT_SUCCESS;
+}
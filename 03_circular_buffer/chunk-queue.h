@@ -0,0 +1,170 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_CHUNK_QUEUE
+#define MSUSEM_CHUNK_QUEUE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <stdatomic.h>
+
+//----------------------------------
+// Неограниченная очередь из блоков
+//----------------------------------
+// Очередь с одним писателем и одним читателем (SPSC) без ограничения ёмкости:
+// элементы хранятся в связном списке блоков по CHUNK_SIZE слотов, и запись никогда не отказывает.
+//
+// Прочитанные блоки не освобождаются, а остаются в начале списка и служат кешем свободных блоков:
+//     first -> ... -> head_chunk -> ... -> tail_chunk
+// Блоки от first до head_chunk (не включая) прочитаны и принадлежат писателю.
+// Писатель берёт блок из кеша и подвешивает его в конец списка, а malloc() вызывается
+// только когда кеш пуст. В установившемся режиме очередь не выделяет память.
+// Кеш не сжимается: память, занятая в пике, удерживается до chunk_queue_free().
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+#ifndef CHUNK_SIZE
+#define CHUNK_SIZE 256U
+#endif
+
+_Static_assert(CHUNK_SIZE > 0 && (CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0,
+    "CHUNK_SIZE is expected to be power of two");
+
+typedef struct CHUNK {
+    _Atomic(struct CHUNK*) next;
+    uint64_t data[CHUNK_SIZE];
+} CHUNK;
+
+typedef struct {
+    // Поля читателя.
+    _Alignas(CACHE_LINE_SIZE) _Atomic(CHUNK*) head_chunk;
+    uint64_t head;
+    uint64_t cached_tail;
+
+    // Поля писателя.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;
+    CHUNK* tail_chunk;
+    CHUNK* first;
+    CHUNK* cached_head_chunk;
+
+    // Количество вызовов malloc() (для статистики).
+    uint64_t num_allocs;
+} CHUNK_QUEUE;
+
+CHUNK* chunk_queue_alloc(CHUNK_QUEUE* queue)
+{
+    // Пробуем взять блок из кеша, при необходимости обновив представление о позиции читателя.
+    if (queue->first == queue->cached_head_chunk)
+    {
+        queue->cached_head_chunk = atomic_load_explicit(&queue->head_chunk, memory_order_acquire);
+    }
+
+    CHUNK* chunk = NULL;
+    if (queue->first != queue->cached_head_chunk)
+    {
+        chunk = queue->first;
+        queue->first = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+    }
+    else
+    {
+        chunk = (CHUNK*) aligned_alloc(CACHE_LINE_SIZE, sizeof(CHUNK));
+        if (chunk == NULL)
+        {
+            printf("chunk_queue_alloc: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        queue->num_allocs += 1U;
+    }
+
+    atomic_store_explicit(&chunk->next, NULL, memory_order_relaxed);
+    return chunk;
+}
+
+void chunk_queue_init(CHUNK_QUEUE* queue)
+{
+    queue->first = NULL;
+    queue->cached_head_chunk = NULL;
+    queue->num_allocs = 0U;
+    atomic_init(&queue->head_chunk, NULL);
+
+    CHUNK* chunk = chunk_queue_alloc(queue);
+
+    queue->first = chunk;
+    queue->cached_head_chunk = chunk;
+    queue->tail_chunk = chunk;
+    atomic_store_explicit(&queue->head_chunk, chunk, memory_order_relaxed);
+
+    queue->head = 0U;
+    queue->cached_tail = 0U;
+    atomic_init(&queue->tail, 0U);
+}
+
+void chunk_queue_free(CHUNK_QUEUE* queue)
+{
+    CHUNK* chunk = queue->first;
+    while (chunk != NULL)
+    {
+        CHUNK* next = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+        free(chunk);
+        chunk = next;
+    }
+}
+
+//-----------------------
+// Операции над очередью
+//-----------------------
+
+void chunk_queue_enqueue(CHUNK_QUEUE* queue, uint64_t elem)
+{
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t index = tail & (CHUNK_SIZE - 1U);
+
+    // Текущий блок заполнен: подвешиваем следующий.
+    // Ссылка публикуется вместе с элементом последующей записью tail.
+    if (index == 0U && tail != 0U)
+    {
+        CHUNK* chunk = chunk_queue_alloc(queue);
+        atomic_store_explicit(&queue->tail_chunk->next, chunk, memory_order_relaxed);
+        queue->tail_chunk = chunk;
+    }
+
+    queue->tail_chunk->data[index] = elem;
+
+    atomic_store_explicit(&queue->tail, tail + 1U, memory_order_release);
+}
+
+bool chunk_queue_dequeue(CHUNK_QUEUE* queue, uint64_t* elem)
+{
+    uint64_t head = queue->head;
+
+    if (queue->cached_tail == head)
+    {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+        if (queue->cached_tail == head)
+        {
+            return false;
+        }
+    }
+
+    uint32_t index = head & (CHUNK_SIZE - 1U);
+    CHUNK* chunk = atomic_load_explicit(&queue->head_chunk, memory_order_relaxed);
+
+    // Текущий блок прочитан: переходим к следующему и возвращаем прочитанный писателю.
+    if (index == 0U && head != 0U)
+    {
+        chunk = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+        atomic_store_explicit(&queue->head_chunk, chunk, memory_order_release);
+    }
+
+    *elem = chunk->data[index];
+    queue->head = head + 1U;
+
+    return true;
+}
+
+#endif // MSUSEM_CHUNK_QUEUE
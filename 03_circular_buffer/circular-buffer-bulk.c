@@ -0,0 +1,222 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define QUEUE_SIZE     1024U
+#define NUM_ITERATIONS 100000000ULL
+
+// Размеры пакетов: 1, 2, 4, ..., MAX_BATCH_SIZE.
+#define MAX_BATCH_SIZE 256U
+
+#define ENABLE_PADDING  1
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "circular-buffer.h"
+
+//---------------------------------------
+// Пакетное применение кольцевой очереди
+//---------------------------------------
+
+void thread_producer(QUEUE* queue, uint32_t batch_size)
+{
+    uint64_t batch[MAX_BATCH_SIZE];
+
+    for (uint64_t snd_i = 0U; snd_i < NUM_ITERATIONS; snd_i += batch_size)
+    {
+        // Последний пакет может оказаться неполным.
+        uint32_t n = (NUM_ITERATIONS - snd_i < batch_size)? NUM_ITERATIONS - snd_i : batch_size;
+        for (uint32_t i = 0U; i < n; ++i)
+        {
+            batch[i] = snd_i + i;
+        }
+
+        uint32_t retry = 0U;
+        while (queue_enqueue_bulk(queue, batch, n) == 0U)
+        {
+            retry++;
+
+            if (ENABLE_BACKOFF && retry == NUM_RETRIES)
+            {
+                retry = 0U;
+                sched_yield();
+            }
+        }
+    }
+}
+
+void thread_consumer(QUEUE* queue, uint32_t batch_size)
+{
+    uint64_t batch[MAX_BATCH_SIZE];
+
+    uint64_t rcv_i = 0U;
+    while (rcv_i < NUM_ITERATIONS)
+    {
+        uint32_t n = 0U;
+        uint32_t retry = 0U;
+        while ((n = queue_dequeue_burst(queue, batch, batch_size)) == 0U)
+        {
+            retry++;
+
+            if (ENABLE_BACKOFF && retry == NUM_RETRIES)
+            {
+                retry = 0U;
+                sched_yield();
+            }
+        }
+
+        // Compare result:
+        for (uint32_t i = 0U; i < n; ++i, ++rcv_i)
+        {
+            if (batch[i] != rcv_i)
+            {
+                printf("Invalid queue element: expected %lu, got %lu\n", rcv_i, batch[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS 2U
+
+typedef struct {
+    size_t thread_i;
+    QUEUE* queue;
+    uint32_t batch_size;
+} THREAD_ARGS;
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->thread_i == 0U)
+    {
+        thread_producer(args->queue, args->batch_size);
+    }
+    else
+    {
+        thread_consumer(args->queue, args->batch_size);
+    }
+
+    return NULL;
+}
+
+// Запускает пару писатель-читатель и дожидается её завершения.
+void run_threads(QUEUE* queue, uint32_t batch_size)
+{
+    // Инициализируем параметры потоков.
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].queue = queue;
+        args[i].batch_size = batch_size;
+    }
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        size_t hart_i = i % NUM_HARDWARE_THREADS;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+int main()
+{
+    printf("%10s %16s\n", "Batch", "Ops/s");
+
+    for (uint32_t batch_size = 1U; batch_size <= MAX_BATCH_SIZE; batch_size *= 2U)
+    {
+        QUEUE queue;
+        queue_init(&queue, QUEUE_SIZE);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        run_threads(&queue, batch_size);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        printf("%10u %16.0f\n", batch_size, NUM_ITERATIONS / elapsed);
+
+        queue_free(&queue);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,796 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+// Все варианты, которые circular-buffer.c выбирает через #define, здесь перебираются во время исполнения.
+// Режимы:
+// - throughput: поток элементов от писателя к читателю, пропускная способность;
+// - pingpong:   маркер с временем отправки ходит по двум очередям туда и обратно, время обмена (RTT).
+// Количество итераций можно передать вторым аргументом командной строки.
+
+#define NUM_ITERATIONS 10000000ULL
+#define NUM_ROUNDS     1000000ULL
+
+// Размер очередей в режиме pingpong: в полёте всегда один элемент.
+#define PINGPONG_QUEUE_SIZE 64U
+
+const uint32_t QUEUE_SIZES[] = {64U, 1024U, 16384U};
+
+#define NUM_QUEUE_SIZES (sizeof(QUEUE_SIZES) / sizeof(QUEUE_SIZES[0]))
+
+#define CACHE_LINE_SIZE 256
+
+// Количество итераций с "pause" перед sched_yield() или фьютексом.
+#define NUM_RETRIES 10U
+
+#include "wait-strategy.h"
+
+//-------------------------------------------------
+// Кольцевой буфер с раскладкой времени исполнения
+//-------------------------------------------------
+// Поля cached_head, cached_tail, head и tail лежат в отдельном блоке с шагом stride:
+// sizeof(uint32_t) воспроизводит QUEUE без ENABLE_PADDING, CACHE_LINE_SIZE - с ним.
+
+typedef struct {
+    uint64_t* data;
+    uint32_t size;
+
+    uint32_t* cached_head;
+    uint32_t* cached_tail;
+    _Atomic uint32_t* head;
+    _Atomic uint32_t* tail;
+
+    void* fields;
+} MATRIX_QUEUE;
+
+void matrix_queue_init(MATRIX_QUEUE* queue, uint32_t size, bool padding)
+{
+    size_t stride = padding? CACHE_LINE_SIZE : sizeof(uint32_t);
+
+    queue->data = (uint64_t*) calloc(size, sizeof(uint64_t));
+    queue->fields = aligned_alloc(CACHE_LINE_SIZE, (4U * stride + CACHE_LINE_SIZE - 1U) & ~(CACHE_LINE_SIZE - 1U));
+    if (queue->data == NULL || queue->fields == NULL)
+    {
+        printf("matrix_queue_init: size (%u) is too big\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    uint8_t* fields = (uint8_t*) queue->fields;
+    queue->size = size;
+    queue->cached_head = (uint32_t*) (fields + 0U * stride);
+    queue->cached_tail = (uint32_t*) (fields + 1U * stride);
+    queue->head = (_Atomic uint32_t*) (fields + 2U * stride);
+    queue->tail = (_Atomic uint32_t*) (fields + 3U * stride);
+
+    *queue->cached_head = 0U;
+    *queue->cached_tail = 0U;
+    atomic_init(queue->head, 0U);
+    atomic_init(queue->tail, 0U);
+}
+
+void matrix_queue_free(MATRIX_QUEUE* queue)
+{
+    free(queue->fields);
+    free(queue->data);
+}
+
+// Совпадает с queue_enqueue()/queue_enqueue_simple() из circular-buffer.h.
+bool matrix_enqueue(MATRIX_QUEUE* queue, uint64_t elem, bool cached)
+{
+    uint32_t tail = atomic_load_explicit(queue->tail, memory_order_relaxed);
+
+    if (!cached)
+    {   // Без кеширования поле cached_head не используется: к его линии кеша не обращаемся.
+        uint32_t head = atomic_load_explicit(queue->head, memory_order_acquire);
+
+        if (tail - head == queue->size)
+        {
+            return false;
+        }
+    }
+    else if (tail - *queue->cached_head == queue->size)
+    {
+        *queue->cached_head = atomic_load_explicit(queue->head, memory_order_acquire);
+
+        if (tail - *queue->cached_head == queue->size)
+        {
+            return false;
+        }
+    }
+
+    queue->data[tail & (queue->size - 1U)] = elem;
+    atomic_store_explicit(queue->tail, tail + 1U, memory_order_release);
+
+    return true;
+}
+
+// Совпадает с queue_dequeue()/queue_dequeue_simple() из circular-buffer.h.
+bool matrix_dequeue(MATRIX_QUEUE* queue, uint64_t* elem, bool cached)
+{
+    uint32_t head = atomic_load_explicit(queue->head, memory_order_relaxed);
+
+    if (!cached)
+    {   // Без кеширования поле cached_tail не используется: к его линии кеша не обращаемся.
+        uint32_t tail = atomic_load_explicit(queue->tail, memory_order_acquire);
+
+        if (tail == head)
+        {
+            return false;
+        }
+    }
+    else if (*queue->cached_tail == head)
+    {
+        *queue->cached_tail = atomic_load_explicit(queue->tail, memory_order_acquire);
+
+        if (*queue->cached_tail == head)
+        {
+            return false;
+        }
+    }
+
+    *elem = queue->data[head & (queue->size - 1U)];
+    atomic_store_explicit(queue->head, head + 1U, memory_order_release);
+
+    return true;
+}
+
+bool matrix_not_empty(void* arg)
+{
+    MATRIX_QUEUE* queue = (MATRIX_QUEUE*) arg;
+    return atomic_load_explicit(queue->tail, memory_order_acquire) !=
+           atomic_load_explicit(queue->head, memory_order_relaxed);
+}
+
+bool matrix_not_full(void* arg)
+{
+    MATRIX_QUEUE* queue = (MATRIX_QUEUE*) arg;
+    return atomic_load_explicit(queue->tail, memory_order_relaxed) -
+           atomic_load_explicit(queue->head, memory_order_acquire) != queue->size;
+}
+
+//------------------------------
+// Применение кольцевой очереди
+//------------------------------
+
+// Очередь вместе с условиями ожидания на ней.
+typedef struct {
+    MATRIX_QUEUE queue;
+    EVENTCOUNT not_empty;
+    EVENTCOUNT not_full;
+} CHANNEL;
+
+typedef struct {
+    bool cached;
+    WAIT_STRATEGY ws;
+    uint64_t num_iterations;
+
+    // В режиме pingpong второй поток возвращает элементы по каналу reply.
+    bool pingpong;
+    CHANNEL request;
+    CHANNEL reply;
+
+    // Времена обмена в тактах TSC.
+    uint64_t* rtt;
+} BENCH;
+
+void channel_send(BENCH* bench, CHANNEL* ch, uint64_t elem)
+{
+    while (!matrix_enqueue(&ch->queue, elem, bench->cached))
+    {
+        wait_for(&bench->ws, &ch->not_full, matrix_not_full, &ch->queue);
+    }
+
+    wait_notify(&bench->ws, &ch->not_empty);
+}
+
+uint64_t channel_recv(BENCH* bench, CHANNEL* ch)
+{
+    uint64_t elem = 0U;
+    while (!matrix_dequeue(&ch->queue, &elem, bench->cached))
+    {
+        wait_for(&bench->ws, &ch->not_empty, matrix_not_empty, &ch->queue);
+    }
+
+    wait_notify(&bench->ws, &ch->not_full);
+
+    return elem;
+}
+
+void thread_producer(BENCH* bench)
+{
+    for (uint64_t snd_i = 0U; snd_i < bench->num_iterations; ++snd_i)
+    {
+        channel_send(bench, &bench->request, snd_i);
+    }
+}
+
+void thread_consumer(BENCH* bench)
+{
+    for (uint64_t rcv_i = 0U; rcv_i < bench->num_iterations; ++rcv_i)
+    {
+        uint64_t snd_i = channel_recv(bench, &bench->request);
+
+        // Compare result:
+        if (snd_i != rcv_i)
+        {
+            printf("Invalid queue element: expected %lu, got %lu\n", rcv_i, snd_i);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Отправляет маркер со временем отправки и ждёт его возвращения.
+void thread_pinger(BENCH* bench)
+{
+    for (uint64_t round = 0U; round < bench->num_iterations; ++round)
+    {
+        uint64_t sent = __rdtsc();
+        channel_send(bench, &bench->request, sent);
+
+        uint64_t token = channel_recv(bench, &bench->reply);
+        bench->rtt[round] = __rdtsc() - sent;
+
+        // Compare result:
+        if (token != sent)
+        {
+            printf("Invalid token: expected %lu, got %lu\n", sent, token);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void thread_ponger(BENCH* bench)
+{
+    for (uint64_t round = 0U; round < bench->num_iterations; ++round)
+    {
+        channel_send(bench, &bench->reply, channel_recv(bench, &bench->request));
+    }
+}
+
+//----------------------
+// Топология процессора
+//----------------------
+// Пары аппаратных потоков подбираются по sysfs относительно первого доступного процессора.
+
+typedef enum {
+    PAIR_SMT,
+    PAIR_SAME_LLC,
+    PAIR_CROSS_LLC,
+    PAIR_CROSS_SOCKET,
+    PAIR_SAME_CPU,
+    NUM_PAIR_KINDS
+} PAIR_KIND;
+
+const char* PAIR_NAMES[] = {"smt", "same-llc", "cross-llc", "cross-socket", "same-cpu"};
+
+typedef struct {
+    PAIR_KIND kind;
+    int cpus[2];
+} CPU_PAIR;
+
+// Считывает файл sysfs со списком процессоров вида "0-3,8-11".
+bool read_cpu_list(const char* path, cpu_set_t* set)
+{
+    CPU_ZERO(set);
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        int sep = fgetc(file);
+        if (sep == '-')
+        {
+            if (fscanf(file, "%d", &last) != 1)
+            {
+                break;
+            }
+
+            sep = fgetc(file);
+        }
+
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+        {
+            CPU_SET(cpu, set);
+        }
+
+        if (sep != ',')
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+int read_cpu_int(int cpu, const char* name)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+    FILE* file = fopen(path, "r");
+    int value = -1;
+    if (file != NULL)
+    {
+        if (fscanf(file, "%d", &value) != 1)
+        {
+            value = -1;
+        }
+
+        fclose(file);
+    }
+
+    return value;
+}
+
+// Множество процессоров, разделяющих с cpu кеш последнего уровня.
+void read_llc_cpus(int cpu, cpu_set_t* set)
+{
+    CPU_ZERO(set);
+    CPU_SET(cpu, set);
+
+    int max_level = 0;
+    for (int index = 0; ; ++index)
+    {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+
+        FILE* file = fopen(path, "r");
+        if (file == NULL)
+        {
+            break;
+        }
+
+        int level = 0;
+        if (fscanf(file, "%d", &level) != 1)
+        {
+            level = 0;
+        }
+        fclose(file);
+
+        cpu_set_t shared;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        if (level > max_level && read_cpu_list(path, &shared))
+        {
+            *set = shared;
+            max_level = level;
+        }
+    }
+}
+
+size_t find_cpu_pairs(CPU_PAIR* pairs)
+{
+    cpu_set_t online;
+    if (sched_getaffinity(0, sizeof(online), &online) == -1)
+    {
+        fprintf(stderr, "Unable to call sched_getaffinity\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int base = -1;
+    for (int cpu = 0; cpu < CPU_SETSIZE && base == -1; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &online))
+        {
+            base = cpu;
+        }
+    }
+
+    char path[128];
+    cpu_set_t siblings, llc;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", base);
+    read_cpu_list(path, &siblings);
+    read_llc_cpus(base, &llc);
+    int package = read_cpu_int(base, "physical_package_id");
+
+    // Для каждого вида пары берём первый подходящий процессор.
+    int partner[NUM_PAIR_KINDS];
+    for (size_t kind = 0U; kind < NUM_PAIR_KINDS; ++kind)
+    {
+        partner[kind] = -1;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (cpu == base || !CPU_ISSET(cpu, &online))
+        {
+            continue;
+        }
+
+        PAIR_KIND kind =
+            CPU_ISSET(cpu, &siblings)                     ? PAIR_SMT :
+            CPU_ISSET(cpu, &llc)                          ? PAIR_SAME_LLC :
+            read_cpu_int(cpu, "physical_package_id") == package ? PAIR_CROSS_LLC :
+                                                            PAIR_CROSS_SOCKET;
+        if (partner[kind] == -1)
+        {
+            partner[kind] = cpu;
+        }
+    }
+
+    size_t num_pairs = 0U;
+    for (size_t kind = 0U; kind < PAIR_SAME_CPU; ++kind)
+    {
+        if (partner[kind] != -1)
+        {
+            pairs[num_pairs++] = (CPU_PAIR) {.kind = kind, .cpus = {base, partner[kind]}};
+        }
+    }
+
+    // Единственный доступный процессор: потоки делят его по времени.
+    if (num_pairs == 0U)
+    {
+        pairs[num_pairs++] = (CPU_PAIR) {.kind = PAIR_SAME_CPU, .cpus = {base, base}};
+    }
+
+    return num_pairs;
+}
+
+//-----------------------------
+// Счётчики производительности
+//-----------------------------
+
+// Открывает счётчик промахов кеша для текущего процесса и создаваемых им потоков.
+// Возвращает -1, если perf_event_open() недоступен.
+int cache_misses_open()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS 2U
+
+typedef struct {
+    size_t thread_i;
+    BENCH* bench;
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->thread_i == 0U)
+    {
+        (args->bench->pingpong? thread_pinger : thread_producer)(args->bench);
+    }
+    else
+    {
+        (args->bench->pingpong? thread_ponger : thread_consumer)(args->bench);
+    }
+
+    return NULL;
+}
+
+void run_threads(BENCH* bench, const CPU_PAIR* pair)
+{
+    THREAD_ARGS args[NUM_THREADS];
+    pthread_t tids[NUM_THREADS];
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].bench = bench;
+
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем потоку процессор из выбранной пары.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(pair->cpus[i], &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&tids[i], &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+uint64_t time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+const char* WAIT_NAMES[] = {"spin", "yield", "futex"};
+
+void channel_init(CHANNEL* ch, uint32_t size, bool padding)
+{
+    matrix_queue_init(&ch->queue, size, padding);
+    eventcount_init(&ch->not_empty);
+    eventcount_init(&ch->not_full);
+}
+
+// Потоки на одном аппаратном потоке при ожидании в цикле сменяют друг друга
+// только по истечении кванта планировщика: замер длился бы часами и не
+// показывал бы ничего, кроме длины кванта.
+bool skip_measurement(const BENCH* bench, const CPU_PAIR* pair)
+{
+    return pair->kind == PAIR_SAME_CPU && bench->ws.kind == WAIT_SPIN;
+}
+
+void run_throughput(BENCH* bench, bool padding, uint32_t size, const CPU_PAIR* pair)
+{
+    if (skip_measurement(bench, pair))
+    {
+        printf("%-7s %-6s %-5s %6u %-12s %3d %3d %14s %10s %10s\n",
+            padding? "padded" : "packed", bench->cached? "cached" : "simple", WAIT_NAMES[bench->ws.kind],
+            size, PAIR_NAMES[pair->kind], pair->cpus[0], pair->cpus[1], "n/a", "n/a", "n/a");
+        return;
+    }
+
+    channel_init(&bench->request, size, padding);
+
+    // Счётчик открывается заново, чтобы наследоваться только потоками этого замера.
+    int perf_fd = cache_misses_open();
+    if (perf_fd != -1)
+    {
+        ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t start_ns = time_ns();
+    uint64_t start_tsc = __rdtsc();
+
+    run_threads(bench, pair);
+
+    uint64_t cycles = __rdtsc() - start_tsc;
+    uint64_t elapsed = time_ns() - start_ns;
+
+    // Считанное значение включает события всех завершившихся дочерних потоков.
+    uint64_t misses = 0U;
+    if (perf_fd != -1)
+    {
+        ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf_fd, &misses, sizeof(misses)) != sizeof(misses))
+        {
+            misses = 0U;
+        }
+
+        close(perf_fd);
+    }
+
+    printf("%-7s %-6s %-5s %6u %-12s %3d %3d %14.0f %10.1f ",
+        padding? "padded" : "packed", bench->cached? "cached" : "simple", WAIT_NAMES[bench->ws.kind],
+        size, PAIR_NAMES[pair->kind], pair->cpus[0], pair->cpus[1],
+        1e9 * bench->num_iterations / elapsed, (double) cycles / bench->num_iterations);
+
+    if (perf_fd != -1)
+    {
+        printf("%10.3f\n", (double) misses / bench->num_iterations);
+    }
+    else
+    {
+        printf("%10s\n", "n/a");
+    }
+
+    matrix_queue_free(&bench->request.queue);
+}
+
+//----------------------------
+// Калибровка счётчика тактов
+//----------------------------
+
+// Длительность такта TSC в наносекундах, измеренная по CLOCK_MONOTONIC.
+double tsc_calibrate()
+{
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = 100000000};
+
+    uint64_t start_ns = time_ns();
+    uint64_t start_tsc = __rdtsc();
+
+    nanosleep(&interval, NULL);
+
+    uint64_t cycles = __rdtsc() - start_tsc;
+    uint64_t elapsed = time_ns() - start_ns;
+
+    return (double) elapsed / cycles;
+}
+
+// Минимальная стоимость пары последовательных чтений источника времени.
+void timer_overheads(double ns_per_cycle)
+{
+    uint64_t min_tsc = UINT64_MAX;
+    uint64_t min_clock = UINT64_MAX;
+
+    for (uint32_t i = 0U; i < 10000U; ++i)
+    {
+        uint64_t tsc = __rdtsc();
+        tsc = __rdtsc() - tsc;
+        min_tsc = (tsc < min_tsc)? tsc : min_tsc;
+
+        uint64_t clock = time_ns();
+        clock = time_ns() - clock;
+        min_clock = (clock < min_clock)? clock : min_clock;
+    }
+
+    printf("TSC: %.3f GHz, rdtsc overhead %.1f ns, clock_gettime overhead %lu ns\n",
+        1.0 / ns_per_cycle, min_tsc * ns_per_cycle, min_clock);
+}
+
+int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+void run_pingpong(BENCH* bench, bool padding, const CPU_PAIR* pair, double ns_per_cycle)
+{
+    if (skip_measurement(bench, pair))
+    {
+        printf("%-7s %-6s %-5s %-12s %3d %3d %10s %10s %10s %10s\n",
+            padding? "padded" : "packed", bench->cached? "cached" : "simple", WAIT_NAMES[bench->ws.kind],
+            PAIR_NAMES[pair->kind], pair->cpus[0], pair->cpus[1], "n/a", "n/a", "n/a", "n/a");
+        return;
+    }
+
+    channel_init(&bench->request, PINGPONG_QUEUE_SIZE, padding);
+    channel_init(&bench->reply, PINGPONG_QUEUE_SIZE, padding);
+
+    run_threads(bench, pair);
+
+    uint64_t n = bench->num_iterations;
+    qsort(bench->rtt, n, sizeof(uint64_t), compare_u64);
+
+    printf("%-7s %-6s %-5s %-12s %3d %3d %10.0f %10.0f %10.0f %10.0f\n",
+        padding? "padded" : "packed", bench->cached? "cached" : "simple", WAIT_NAMES[bench->ws.kind],
+        PAIR_NAMES[pair->kind], pair->cpus[0], pair->cpus[1],
+        bench->rtt[0]               * ns_per_cycle,
+        bench->rtt[n / 2U]          * ns_per_cycle,
+        bench->rtt[n * 99U / 100U]  * ns_per_cycle,
+        bench->rtt[n * 999U / 1000U] * ns_per_cycle);
+
+    matrix_queue_free(&bench->reply.queue);
+    matrix_queue_free(&bench->request.queue);
+}
+
+int main(int argc, char** argv)
+{
+    BENCH bench;
+    bench.pingpong = (argc > 1 && strcmp(argv[1], "pingpong") == 0);
+    bench.num_iterations = (argc > 2)? strtoull(argv[2], NULL, 10) : bench.pingpong? NUM_ROUNDS : NUM_ITERATIONS;
+    if ((argc > 1 && !bench.pingpong && strcmp(argv[1], "throughput") != 0) || bench.num_iterations == 0U)
+    {
+        fprintf(stderr, "Usage: %s [throughput|pingpong] [num_iterations]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    CPU_PAIR pairs[NUM_PAIR_KINDS];
+    size_t num_pairs = find_cpu_pairs(pairs);
+
+    if (bench.pingpong)
+    {
+        bench.rtt = (uint64_t*) calloc(bench.num_iterations, sizeof(uint64_t));
+        if (bench.rtt == NULL)
+        {
+            fprintf(stderr, "Unable to allocate RTT samples\n");
+            exit(EXIT_FAILURE);
+        }
+
+        double ns_per_cycle = tsc_calibrate();
+        timer_overheads(ns_per_cycle);
+
+        printf("%-7s %-6s %-5s %-12s %3s %3s %10s %10s %10s %10s\n",
+            "Layout", "Index", "Wait", "Pair", "P", "C", "RTT min ns", "p50 ns", "p99 ns", "p99.9 ns");
+
+        for (size_t pair_i = 0U; pair_i < num_pairs; ++pair_i)
+        {
+            for (int padding = 0; padding <= 1; ++padding)
+            {
+                for (int cached = 0; cached <= 1; ++cached)
+                {
+                    for (WAIT_KIND kind = WAIT_SPIN; kind <= WAIT_FUTEX; ++kind)
+                    {
+                        bench.cached = cached;
+                        bench.ws = (WAIT_STRATEGY) {.kind = kind, .num_spins = NUM_RETRIES};
+
+                        run_pingpong(&bench, padding, &pairs[pair_i], ns_per_cycle);
+                    }
+                }
+            }
+        }
+
+        free(bench.rtt);
+        return EXIT_SUCCESS;
+    }
+
+    printf("%-7s %-6s %-5s %6s %-12s %3s %3s %14s %10s %10s\n",
+        "Layout", "Index", "Wait", "Size", "Pair", "P", "C", "Ops/s", "Cycles/op", "Misses/op");
+
+    for (size_t pair_i = 0U; pair_i < num_pairs; ++pair_i)
+    {
+        for (size_t size_i = 0U; size_i < NUM_QUEUE_SIZES; ++size_i)
+        {
+            for (int padding = 0; padding <= 1; ++padding)
+            {
+                for (int cached = 0; cached <= 1; ++cached)
+                {
+                    for (WAIT_KIND kind = WAIT_SPIN; kind <= WAIT_FUTEX; ++kind)
+                    {
+                        bench.cached = cached;
+                        bench.ws = (WAIT_STRATEGY) {.kind = kind, .num_spins = NUM_RETRIES};
+
+                        run_throughput(&bench, padding, QUEUE_SIZES[size_i], &pairs[pair_i]);
+                    }
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -19,6 +19,7 @@
 #define NUM_ITERATIONS 100000000ULL
 
 #define ENABLE_PADDING 0
+#define CACHE_LINE_SIZE 256
 
 #define ENABLE_SIMPLE  1
 
@@ -27,141 +28,7 @@
 
 #define NUM_HARDWARE_THREADS 2U
 
-//---------------------------
-// Lock-free кольцевой буфер
-//---------------------------
-
-#define CACHE_LINE_SIZE 256
-
-typedef struct {
-    uint64_t* data;
-    uint32_t size;
-
-    uint32_t cached_head;
-#if ENABLE_PADDING == 1
-    uint8_t pad0[CACHE_LINE_SIZE];
-#endif
-    uint32_t cached_tail;
-#if ENABLE_PADDING == 1
-    uint8_t pad1[CACHE_LINE_SIZE];
-#endif
-    _Atomic uint32_t head;
-#if ENABLE_PADDING == 1
-    uint8_t pad2[CACHE_LINE_SIZE];
-#endif
-    _Atomic uint32_t tail;
-} QUEUE;
-
-void queue_init(QUEUE* queue, uint32_t size)
-{
-    if (size == 0 || ((size - 1) & size) != 0)
-    {
-        printf("queue_init: size (%u) is expected to be power of two\n", size);
-        exit(EXIT_FAILURE);
-    }
-
-    queue->data = (uint64_t*) calloc(size, sizeof(uint64_t));
-    if (queue->data == NULL)
-    {
-        printf("queue_init: size (%u) is too big\n", size);
-        exit(EXIT_FAILURE);
-    }
-
-    queue->size = size;
-    queue->cached_head = 0U;
-    queue->cached_tail = 0U;
-    queue->head = 0U;
-    queue->tail = 0U;
-}
-
-bool queue_enqueue(QUEUE* queue, uint64_t elem)
-{
-    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
-
-    if (tail - queue->cached_head == queue->size)
-    {
-        uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
-
-        queue->cached_head = head;
-
-        if (tail - head == queue->size)
-        {
-            return false;
-        }
-    }
-
-    queue->data[tail & (queue->size - 1)] = elem;
-    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
-
-    return true;
-}
-
-bool queue_dequeue(QUEUE* queue, uint64_t* elem)
-{
-    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
-
-    if (queue->cached_tail == head)
-    {
-        uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
-        queue->cached_tail = tail;
-
-        if (tail == head)
-        {
-            return false;
-        }
-    }
-
-    *elem = queue->data[head & (queue->size - 1)];
-    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
-
-    return true;
-}
-
-bool queue_enqueue_simple(QUEUE* queue, uint64_t elem)
-{
-    // [1] Извлекаем голову кольцевой очереди (синхронизация с [4]).
-    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
-
-    // Извлекаем хвост кольцевой очереди.
-    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
-
-    if (tail - head == queue->size)
-    {   // Очередь полна.
-        // Добавление элемента в полную очередь невозможно.
-        return false;
-    }
-
-    // Добавляем элемент в очередь.
-    queue->data[tail & (queue->size - 1U)] = elem;
-
-    // [2] Уведомляем читателя о появлении нового элемента в очереди (см. [3]).
-    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
-
-    // Добавление элемента в очередь прошло успешно.
-    return true;
-}
-
-bool queue_dequeue_simple(QUEUE* queue, uint64_t* elem)
-{
-    // Считываем голову кольцевой очереди
-    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
-
-    // [3] Считываем хвост кольцевой очереди (см. [4]).
-    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
-    if (tail == head)
-    {   // Кольцевая очередь пуста.
-        return false;
-    }
-
-    // Вычитываем элемент из очереди.
-    *elem = queue->data[head & (queue->size - 1U)];
-
-    // [4] Уведомляем писателя о появлении нового свободного места в очереди (см. [1]).
-    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
-
-    // Извлечение элемента из очереди прошло успешно.
-    return true;
-}
+#include "circular-buffer.h"
 
 //------------------------------
 // Применение кольцевой очереди
@@ -185,7 +52,7 @@ void thread_producer(QUEUE* queue)
             if (ENABLE_BACKOFF && retry == NUM_RETRIES)
             {
                 retry = 0U;
-                pthread_yield();
+                sched_yield();
             }
         }
         while (!success);
@@ -212,7 +79,7 @@ void thread_consumer(QUEUE* queue)
             if (ENABLE_BACKOFF && retry == NUM_RETRIES)
             {
                 retry = 0U;
-                pthread_yield();
+                sched_yield();
             }
         }
         while (!success);
@@ -0,0 +1,233 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_CIRCULAR_BUFFER
+#define MSUSEM_CIRCULAR_BUFFER
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <stdatomic.h>
+
+//---------------------------
+// Lock-free кольцевой буфер
+//---------------------------
+// Очередь с одним писателем и одним читателем (SPSC).
+// Параметры ENABLE_PADDING и CACHE_LINE_SIZE можно переопределить до подключения заголовка.
+
+#ifndef ENABLE_PADDING
+#define ENABLE_PADDING 0
+#endif
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+typedef struct {
+    uint64_t* data;
+    uint32_t size;
+
+    uint32_t cached_head;
+#if ENABLE_PADDING == 1
+    uint8_t pad0[CACHE_LINE_SIZE];
+#endif
+    uint32_t cached_tail;
+#if ENABLE_PADDING == 1
+    uint8_t pad1[CACHE_LINE_SIZE];
+#endif
+    _Atomic uint32_t head;
+#if ENABLE_PADDING == 1
+    uint8_t pad2[CACHE_LINE_SIZE];
+#endif
+    _Atomic uint32_t tail;
+} QUEUE;
+
+void queue_init(QUEUE* queue, uint32_t size)
+{
+    if (size == 0 || ((size - 1) & size) != 0)
+    {
+        printf("queue_init: size (%u) is expected to be power of two\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    queue->data = (uint64_t*) calloc(size, sizeof(uint64_t));
+    if (queue->data == NULL)
+    {
+        printf("queue_init: size (%u) is too big\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    queue->size = size;
+    queue->cached_head = 0U;
+    queue->cached_tail = 0U;
+    queue->head = 0U;
+    queue->tail = 0U;
+}
+
+void queue_free(QUEUE* queue)
+{
+    free(queue->data);
+}
+
+bool queue_enqueue(QUEUE* queue, uint64_t elem)
+{
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if (tail - queue->cached_head == queue->size)
+    {
+        uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+        queue->cached_head = head;
+
+        if (tail - head == queue->size)
+        {
+            return false;
+        }
+    }
+
+    queue->data[tail & (queue->size - 1)] = elem;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+bool queue_dequeue(QUEUE* queue, uint64_t* elem)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    if (queue->cached_tail == head)
+    {
+        uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        queue->cached_tail = tail;
+
+        if (tail == head)
+        {
+            return false;
+        }
+    }
+
+    *elem = queue->data[head & (queue->size - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+bool queue_enqueue_simple(QUEUE* queue, uint64_t elem)
+{
+    // [1] Извлекаем голову кольцевой очереди (синхронизация с [4]).
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    // Извлекаем хвост кольцевой очереди.
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if (tail - head == queue->size)
+    {   // Очередь полна.
+        // Добавление элемента в полную очередь невозможно.
+        return false;
+    }
+
+    // Добавляем элемент в очередь.
+    queue->data[tail & (queue->size - 1U)] = elem;
+
+    // [2] Уведомляем читателя о появлении нового элемента в очереди (см. [3]).
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+    // Добавление элемента в очередь прошло успешно.
+    return true;
+}
+
+bool queue_dequeue_simple(QUEUE* queue, uint64_t* elem)
+{
+    // Считываем голову кольцевой очереди
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    // [3] Считываем хвост кольцевой очереди (см. [4]).
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (tail == head)
+    {   // Кольцевая очередь пуста.
+        return false;
+    }
+
+    // Вычитываем элемент из очереди.
+    *elem = queue->data[head & (queue->size - 1U)];
+
+    // [4] Уведомляем писателя о появлении нового свободного места в очереди (см. [1]).
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    // Извлечение элемента из очереди прошло успешно.
+    return true;
+}
+
+//----------------------------------
+// Пакетные операции над очередью
+//----------------------------------
+// Пакет элементов занимает непрерывный (с учётом переноса через конец буфера) отрезок слотов.
+// Свободное место проверяется по кешированному индексу, копирование выполняется memcpy,
+// а публикация всего пакета - одной release-записью индекса.
+
+// Добавляет в очередь либо все n элементов, либо ни одного.
+// Возвращает количество добавленных элементов (n или 0).
+uint32_t queue_enqueue_bulk(QUEUE* queue, const uint64_t* elems, uint32_t n)
+{
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    if (queue->size - (tail - queue->cached_head) < n)
+    {
+        // Кешированное значение устарело: перечитываем голову очереди.
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+        if (queue->size - (tail - queue->cached_head) < n)
+        {
+            return 0U;
+        }
+    }
+
+    // Копируем пакет с переносом через конец буфера.
+    uint32_t index = tail & (queue->size - 1U);
+    uint32_t first = (n < queue->size - index)? n : queue->size - index;
+
+    memcpy(&queue->data[index], elems, first * sizeof(uint64_t));
+    memcpy(&queue->data[0], elems + first, (n - first) * sizeof(uint64_t));
+
+    // Публикуем весь пакет разом.
+    atomic_store_explicit(&queue->tail, tail + n, memory_order_release);
+
+    return n;
+}
+
+// Извлекает из очереди от 0 до max элементов.
+// Возвращает количество извлечённых элементов.
+uint32_t queue_dequeue_burst(QUEUE* queue, uint64_t* elems, uint32_t max)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    uint32_t available = queue->cached_tail - head;
+    if (available < max)
+    {
+        // Кешированное значение может быть устаревшим: перечитываем хвост очереди.
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        available = queue->cached_tail - head;
+
+        if (available == 0U)
+        {
+            return 0U;
+        }
+    }
+
+    uint32_t n = (available < max)? available : max;
+
+    // Копируем пакет с переносом через конец буфера.
+    uint32_t index = head & (queue->size - 1U);
+    uint32_t first = (n < queue->size - index)? n : queue->size - index;
+
+    memcpy(elems, &queue->data[index], first * sizeof(uint64_t));
+    memcpy(elems + first, &queue->data[0], (n - first) * sizeof(uint64_t));
+
+    // Освобождаем слоты разом.
+    atomic_store_explicit(&queue->head, head + n, memory_order_release);
+
+    return n;
+}
+
+#endif // MSUSEM_CIRCULAR_BUFFER
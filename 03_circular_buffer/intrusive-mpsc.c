@@ -0,0 +1,420 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+// Количество сообщений от каждого писателя.
+#define NUM_MESSAGES 1000000U
+
+// Каждый писатель переиспользует POOL_SIZE сообщений по кругу.
+#define POOL_SIZE 1024U
+
+// Наибольшее количество сообщений, обрабатываемых читателем за один проход.
+#define BATCH_SIZE 64U
+
+// Перебираемые количества писателей: 1, 2, 4, ..., MAX_PRODUCERS.
+#define MAX_PRODUCERS 8U
+
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#include "intrusive-mpsc.h"
+
+typedef struct {
+    // Узел очереди - первое поле сообщения.
+    MPSC_NODE node;
+    uint32_t producer_i;
+    uint64_t seq;
+} MESSAGE;
+
+//===============================
+// Очередь на мьютексе и condvar
+//===============================
+// Интрузивный список под мьютексом: читатель забирает весь список за одну блокировку.
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+
+    MPSC_NODE* head;
+    MPSC_NODE* tail;
+
+    // Читатель ждёт на not_empty.
+    bool waiting;
+} LOCKED_LIST;
+
+void locked_list_init(LOCKED_LIST* list)
+{
+    pthread_mutex_init(&list->mutex, NULL);
+    pthread_cond_init(&list->not_empty, NULL);
+
+    list->head = NULL;
+    list->tail = NULL;
+    list->waiting = false;
+}
+
+void locked_list_free(LOCKED_LIST* list)
+{
+    pthread_cond_destroy(&list->not_empty);
+    pthread_mutex_destroy(&list->mutex);
+}
+
+void locked_list_post(LOCKED_LIST* list, MPSC_NODE* node)
+{
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+    pthread_mutex_lock(&list->mutex);
+
+    if (list->tail == NULL)
+    {
+        list->head = node;
+    }
+    else
+    {
+        atomic_store_explicit(&list->tail->next, node, memory_order_relaxed);
+    }
+    list->tail = node;
+
+    if (list->waiting)
+    {
+        pthread_cond_signal(&list->not_empty);
+    }
+
+    pthread_mutex_unlock(&list->mutex);
+}
+
+// Ждёт непустого списка и забирает его целиком.
+// Записывает в slept, засыпал ли читатель.
+MPSC_NODE* locked_list_take(LOCKED_LIST* list, bool* slept)
+{
+    pthread_mutex_lock(&list->mutex);
+
+    *slept = false;
+    while (list->head == NULL)
+    {
+        list->waiting = true;
+        pthread_cond_wait(&list->not_empty, &list->mutex);
+        list->waiting = false;
+        *slept = true;
+    }
+
+    MPSC_NODE* head = list->head;
+    list->head = NULL;
+    list->tail = NULL;
+
+    pthread_mutex_unlock(&list->mutex);
+
+    return head;
+}
+
+//=================================
+// Сравниваемые реализации очереди
+//=================================
+
+typedef enum {
+    KIND_MPSC_FUTEX,
+    KIND_MPSC_EVENTFD,
+    KIND_LOCKED
+} QUEUE_KIND;
+
+const char* KIND_NAMES[] = {"futex", "eventfd", "mutex"};
+
+typedef struct {
+    MESSAGE pool[POOL_SIZE];
+
+    // Количество сообщений писателя, обработанных читателем.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t consumed;
+} PRODUCER;
+
+typedef struct {
+    QUEUE_KIND kind;
+    INTRUSIVE_MPSC mpsc;
+    LOCKED_LIST locked;
+
+    size_t num_producers;
+    PRODUCER producers[MAX_PRODUCERS];
+
+    // Поля читателя.
+    uint64_t expected[MAX_PRODUCERS];
+    uint64_t num_sleeps;
+} BENCH;
+
+typedef struct {
+    BENCH* bench;
+    size_t thread_i;
+} THREAD_ARGS;
+
+// Ожидание при исчерпании сообщений писателя.
+void backoff(uint32_t* retry)
+{
+    (*retry)++;
+
+    if (ENABLE_BACKOFF && *retry == NUM_RETRIES)
+    {
+        *retry = 0U;
+        sched_yield();
+    }
+}
+
+void* thread_producer(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+    BENCH* bench = args->bench;
+    PRODUCER* producer = &bench->producers[args->thread_i];
+
+    for (uint64_t snd_i = 0U; snd_i < NUM_MESSAGES; ++snd_i)
+    {
+        // Ждём, пока читатель не обработает сообщение, занимавшее этот слот.
+        uint32_t retry = 0U;
+        while (snd_i - atomic_load_explicit(&producer->consumed, memory_order_acquire) >= POOL_SIZE)
+        {
+            backoff(&retry);
+        }
+
+        MESSAGE* msg = &producer->pool[snd_i % POOL_SIZE];
+        msg->producer_i = args->thread_i;
+        msg->seq = snd_i;
+
+        if (bench->kind == KIND_LOCKED)
+        {
+            locked_list_post(&bench->locked, &msg->node);
+        }
+        else
+        {
+            intrusive_mpsc_post(&bench->mpsc, &msg->node);
+        }
+    }
+
+    return NULL;
+}
+
+void handle_message(MPSC_NODE* node, void* arg)
+{
+    BENCH* bench = (BENCH*) arg;
+    MESSAGE* msg = (MESSAGE*) node;
+
+    // Compare result:
+    // Сообщения одного писателя приходят в порядке отправки.
+    if (msg->producer_i >= bench->num_producers || msg->seq != bench->expected[msg->producer_i])
+    {
+        printf("Invalid message from producer %u: expected %lu, got %lu\n",
+            msg->producer_i, bench->expected[msg->producer_i], msg->seq);
+        exit(EXIT_FAILURE);
+    }
+
+    bench->expected[msg->producer_i]++;
+}
+
+// Обрабатывает очередную пачку сообщений и возвращает её размер.
+uint32_t consume_batch(BENCH* bench)
+{
+    if (bench->kind == KIND_LOCKED)
+    {
+        bool slept = false;
+        MPSC_NODE* node = locked_list_take(&bench->locked, &slept);
+        bench->num_sleeps += slept;
+
+        uint32_t num_nodes = 0U;
+        while (node != NULL)
+        {
+            // Следующий узел читается до обработки: после неё писатель может переиспользовать узел.
+            MPSC_NODE* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            handle_message(node, bench);
+            node = next;
+            num_nodes++;
+        }
+
+        return num_nodes;
+    }
+
+    uint32_t num_nodes = intrusive_mpsc_drain(&bench->mpsc, BATCH_SIZE, handle_message, bench);
+    if (num_nodes == 0U)
+    {
+        bench->num_sleeps += intrusive_mpsc_wait(&bench->mpsc);
+    }
+
+    return num_nodes;
+}
+
+void* thread_consumer(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+    BENCH* bench = args->bench;
+
+    uint64_t num_total = bench->num_producers * NUM_MESSAGES;
+    for (uint64_t rcv_i = 0U; rcv_i < num_total;)
+    {
+        uint32_t num_nodes = consume_batch(bench);
+        if (num_nodes == 0U)
+        {
+            continue;
+        }
+
+        rcv_i += num_nodes;
+
+        // Возвращаем писателям обработанные сообщения одной записью на пачку.
+        for (size_t i = 0U; i < bench->num_producers; ++i)
+        {
+            atomic_store_explicit(&bench->producers[i].consumed, bench->expected[i], memory_order_release);
+        }
+    }
+
+    return NULL;
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+// Аппаратные потоки, на которых процессу разрешено исполняться.
+int allowed_harts[CPU_SETSIZE];
+size_t num_allowed_harts = 0U;
+
+void find_allowed_harts()
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        fprintf(stderr, "Unable to call sched_getaffinity\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            allowed_harts[num_allowed_harts++] = cpu;
+        }
+    }
+}
+
+// Поток закрепляется за hart_i-м разрешённым аппаратным потоком (по кругу).
+void start_thread(pthread_t* tid, void* (*func)(void*), void* arg, size_t hart_i)
+{
+    // Инициализируем аттрибуты потока.
+    pthread_attr_t thread_attributes;
+    int ret = pthread_attr_init(&thread_attributes);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_init\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Назначаем аппаратный поток для потока POSIX.
+    cpu_set_t assigned_harts;
+    CPU_ZERO(&assigned_harts);
+    CPU_SET(allowed_harts[hart_i % num_allowed_harts], &assigned_harts);
+
+    // Устанавливаем аффинность потока.
+    ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Создаём поток POSIX.
+    ret = pthread_create(tid, &thread_attributes, func, arg);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to create thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Удаляем объект с аттрибутами потока.
+    pthread_attr_destroy(&thread_attributes);
+}
+
+void join_thread(pthread_t tid)
+{
+    int ret = pthread_join(tid, NULL);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to join thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+// Слишком велик для стека.
+BENCH bench;
+
+void run_bench(QUEUE_KIND kind, size_t num_producers)
+{
+    bench.kind = kind;
+    bench.num_producers = num_producers;
+    bench.num_sleeps = 0U;
+    intrusive_mpsc_init(&bench.mpsc, (kind == KIND_MPSC_EVENTFD)? MPSC_WAKE_EVENTFD : MPSC_WAKE_FUTEX);
+    locked_list_init(&bench.locked);
+
+    for (size_t i = 0U; i < num_producers; ++i)
+    {
+        atomic_init(&bench.producers[i].consumed, 0U);
+        bench.expected[i] = 0U;
+    }
+
+    THREAD_ARGS consumer = {.bench = &bench, .thread_i = 0U};
+    THREAD_ARGS producers[MAX_PRODUCERS];
+    pthread_t consumer_tid;
+    pthread_t producer_tids[MAX_PRODUCERS];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    start_thread(&consumer_tid, thread_consumer, &consumer, 0U);
+    for (size_t i = 0U; i < num_producers; ++i)
+    {
+        producers[i] = (THREAD_ARGS) {.bench = &bench, .thread_i = i};
+        start_thread(&producer_tids[i], thread_producer, &producers[i], i + 1U);
+    }
+
+    for (size_t i = 0U; i < num_producers; ++i)
+    {
+        join_thread(producer_tids[i]);
+    }
+    join_thread(consumer_tid);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    printf("%-8s %4zu %14.0f %12lu\n",
+        KIND_NAMES[kind], num_producers, num_producers * NUM_MESSAGES / elapsed, bench.num_sleeps);
+
+    locked_list_free(&bench.locked);
+    intrusive_mpsc_free(&bench.mpsc);
+}
+
+int main()
+{
+    find_allowed_harts();
+
+    printf("%-8s %4s %14s %12s\n", "Queue", "P", "Msgs/s", "Sleeps");
+
+    for (size_t num_producers = 1U; num_producers <= MAX_PRODUCERS; num_producers *= 2U)
+    {
+        run_bench(KIND_MPSC_FUTEX,   num_producers);
+        run_bench(KIND_MPSC_EVENTFD, num_producers);
+        run_bench(KIND_LOCKED,       num_producers);
+    }
+
+    return EXIT_SUCCESS;
+}
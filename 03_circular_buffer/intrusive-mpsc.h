@@ -0,0 +1,257 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_INTRUSIVE_MPSC
+#define MSUSEM_INTRUSIVE_MPSC
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <stdatomic.h>
+
+#include "wait-strategy.h"
+
+//--------------------------
+// Интрузивная очередь MPSC
+//--------------------------
+// Очередь Вьюкова с несколькими писателями и одним читателем.
+// Узел MPSC_NODE встраивается в структуру сообщения, поэтому очередь не выделяет память.
+// Запись - один atomic_exchange() и одна запись указателя: писатели не ждут (wait-free).
+//
+// Читатель не lock-free: если писатель вытеснен между обменом tail и записью next,
+// читатель не увидит ни этот узел, ни последующие, пока писатель не продолжит работу.
+//
+// Пробуждение читателя:
+// - MPSC_WAKE_FUTEX:   eventcount на фьютексе;
+// - MPSC_WAKE_EVENTFD: eventfd (дескриптор можно встроить в цикл реактора).
+// Системный вызов со стороны писателя выполняется, только если читатель заснул.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+typedef struct MPSC_NODE {
+    _Atomic(struct MPSC_NODE*) next;
+} MPSC_NODE;
+
+typedef enum {
+    MPSC_WAKE_FUTEX,
+    MPSC_WAKE_EVENTFD
+} MPSC_WAKE_KIND;
+
+typedef struct {
+    // Последний добавленный узел (поле писателей).
+    _Alignas(CACHE_LINE_SIZE) _Atomic(MPSC_NODE*) tail;
+
+    // Самый старый узел (поле читателя).
+    _Alignas(CACHE_LINE_SIZE) MPSC_NODE* head;
+    MPSC_NODE stub;
+
+    // Пробуждение читателя.
+    _Alignas(CACHE_LINE_SIZE) MPSC_WAKE_KIND wake;
+    EVENTCOUNT ec;
+    _Atomic uint32_t sleeping;
+    int efd;
+} INTRUSIVE_MPSC;
+
+void intrusive_mpsc_init(INTRUSIVE_MPSC* queue, MPSC_WAKE_KIND wake)
+{
+    atomic_init(&queue->stub.next, NULL);
+    atomic_init(&queue->tail, &queue->stub);
+    queue->head = &queue->stub;
+
+    queue->wake = wake;
+    eventcount_init(&queue->ec);
+    atomic_init(&queue->sleeping, 0U);
+    queue->efd = -1;
+
+    if (wake == MPSC_WAKE_EVENTFD)
+    {
+        queue->efd = eventfd(0U, EFD_CLOEXEC);
+        if (queue->efd == -1)
+        {
+            fprintf(stderr, "intrusive_mpsc_init: unable to create eventfd\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void intrusive_mpsc_free(INTRUSIVE_MPSC* queue)
+{
+    if (queue->efd != -1)
+    {
+        close(queue->efd);
+    }
+}
+
+//--------------------
+// Операции писателей
+//--------------------
+
+void intrusive_mpsc_push(INTRUSIVE_MPSC* queue, MPSC_NODE* node)
+{
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+    // Точка линеаризации: узел становится последним.
+    MPSC_NODE* prev = atomic_exchange_explicit(&queue->tail, node, memory_order_acq_rel);
+
+    // Связываем предыдущий узел с новым: с этого момента читатель видит узел.
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+// Будит читателя, если он заснул.
+void intrusive_mpsc_notify(INTRUSIVE_MPSC* queue)
+{
+    if (queue->wake == MPSC_WAKE_FUTEX)
+    {
+        eventcount_notify(&queue->ec);
+        return;
+    }
+
+    // Запись узла упорядочена с проверкой флага (см. intrusive_mpsc_wait()).
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&queue->sleeping, memory_order_relaxed) != 0U)
+    {
+        uint64_t value = 1U;
+        if (write(queue->efd, &value, sizeof(value)) != sizeof(value))
+        {
+            fprintf(stderr, "intrusive_mpsc_notify: unable to write eventfd\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void intrusive_mpsc_post(INTRUSIVE_MPSC* queue, MPSC_NODE* node)
+{
+    intrusive_mpsc_push(queue, node);
+    intrusive_mpsc_notify(queue);
+}
+
+//-------------------
+// Операции читателя
+//-------------------
+
+// Возвращает самый старый узел или NULL, если очередь пуста
+// (или писатель не завершил добавление узла).
+MPSC_NODE* intrusive_mpsc_pop(INTRUSIVE_MPSC* queue)
+{
+    MPSC_NODE* head = queue->head;
+    MPSC_NODE* next = atomic_load_explicit(&head->next, memory_order_acquire);
+
+    // Пропускаем заглушку.
+    if (head == &queue->stub)
+    {
+        if (next == NULL)
+        {
+            return NULL;
+        }
+
+        queue->head = next;
+        head = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next != NULL)
+    {
+        queue->head = next;
+        return head;
+    }
+
+    // head - последний видимый узел. Если он не последний добавленный,
+    // писатель находится между обменом и связыванием.
+    if (head != atomic_load_explicit(&queue->tail, memory_order_acquire))
+    {
+        return NULL;
+    }
+
+    // Чтобы вернуть последний узел, возвращаем за него заглушку.
+    intrusive_mpsc_push(queue, &queue->stub);
+
+    next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (next != NULL)
+    {
+        queue->head = next;
+        return head;
+    }
+
+    return NULL;
+}
+
+// Извлекает до max_nodes узлов, передавая каждый в handler.
+// Возвращает количество обработанных узлов.
+uint32_t intrusive_mpsc_drain(INTRUSIVE_MPSC* queue, uint32_t max_nodes,
+    void (*handler)(MPSC_NODE* node, void* arg), void* arg)
+{
+    uint32_t num_nodes = 0U;
+    for (; num_nodes < max_nodes; ++num_nodes)
+    {
+        MPSC_NODE* node = intrusive_mpsc_pop(queue);
+        if (node == NULL)
+        {
+            break;
+        }
+
+        handler(node, arg);
+    }
+
+    return num_nodes;
+}
+
+// Очередь не содержит видимых читателю узлов.
+bool intrusive_mpsc_empty(INTRUSIVE_MPSC* queue)
+{
+    return queue->head == &queue->stub &&
+           atomic_load_explicit(&queue->stub.next, memory_order_acquire) == NULL;
+}
+
+// Засыпает, пока очередь пуста.
+// Возвращает true, если читатель действительно засыпал.
+bool intrusive_mpsc_wait(INTRUSIVE_MPSC* queue)
+{
+    bool slept = false;
+
+    while (intrusive_mpsc_empty(queue))
+    {
+        if (queue->wake == MPSC_WAKE_FUTEX)
+        {
+            uint32_t key = eventcount_prepare(&queue->ec);
+            if (!intrusive_mpsc_empty(queue))
+            {
+                eventcount_cancel(&queue->ec);
+                break;
+            }
+
+            eventcount_wait(&queue->ec, key);
+        }
+        else
+        {
+            // Флаг упорядочен с последующей проверкой очереди (см. intrusive_mpsc_notify()).
+            atomic_store_explicit(&queue->sleeping, 1U, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            if (!intrusive_mpsc_empty(queue))
+            {
+                atomic_store_explicit(&queue->sleeping, 0U, memory_order_relaxed);
+                break;
+            }
+
+            // Счётчик eventfd мог остаться от прошлых уведомлений: лишнее пробуждение безвредно.
+            uint64_t value = 0U;
+            if (read(queue->efd, &value, sizeof(value)) != sizeof(value))
+            {
+                fprintf(stderr, "intrusive_mpsc_wait: unable to read eventfd\n");
+                exit(EXIT_FAILURE);
+            }
+
+            atomic_store_explicit(&queue->sleeping, 0U, memory_order_relaxed);
+        }
+
+        slept = true;
+    }
+
+    return slept;
+}
+
+#endif // MSUSEM_INTRUSIVE_MPSC
@@ -0,0 +1,359 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define RING_SIZE   (1U << 16U)
+#define NUM_RECORDS 10000000ULL
+
+// Длины записей равномерно распределены на отрезке [1, MAX_RECORD_LEN].
+#define MAX_RECORD_LEN 2048U
+
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "mirror-ring.h"
+
+//-------------------
+// Содержимое потока
+//-------------------
+// Поток байт состоит из записей: 4 байта длины, затем данные, каждый байт которых
+// равен младшему байту номера записи. Читатель разбирает поток как протокол.
+
+#define RECORD_HEADER_SIZE ((uint32_t) sizeof(uint32_t))
+
+typedef enum {
+    // Записи разбираются на месте благодаря второму отображению.
+    MODE_MIRRORED,
+    // Обычное кольцо: обращения режутся на границе буфера, запись на стыке
+    // копируется во временный буфер перед разбором.
+    MODE_SPLIT
+} MODE;
+
+const char* MODE_NAMES[] = {"mirrored", "split"};
+
+typedef struct {
+    MIRROR_RING ring;
+    MODE mode;
+
+    // Количество байт, скопированных читателем для разбора записей на стыке.
+    uint64_t copied_bytes;
+} BENCH;
+
+uint32_t record_len(uint64_t* state)
+{
+    // Линейный конгруэнтный генератор.
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return 1U + (uint32_t) ((*state >> 33U) % MAX_RECORD_LEN);
+}
+
+void backoff(uint32_t* retry)
+{
+    (*retry)++;
+
+    if (ENABLE_BACKOFF && *retry == NUM_RETRIES)
+    {
+        *retry = 0U;
+        sched_yield();
+    }
+}
+
+//-----------------------------
+// Обращения к обычному кольцу
+//-----------------------------
+// Используется только первая копия отображения, как в буфере без зеркала.
+
+void split_copy_in(MIRROR_RING* ring, uint8_t* dst, const void* src, uint32_t len)
+{
+    uint32_t offset = dst - ring->data;
+    uint32_t first = (len < ring->size - offset)? len : ring->size - offset;
+
+    memcpy(ring->data + offset, src, first);
+    memcpy(ring->data, (const uint8_t*) src + first, len - first);
+}
+
+void split_fill(MIRROR_RING* ring, uint8_t* dst, uint8_t value, uint32_t len)
+{
+    uint32_t offset = dst - ring->data;
+    uint32_t first = (len < ring->size - offset)? len : ring->size - offset;
+
+    memset(ring->data + offset, value, first);
+    memset(ring->data, value, len - first);
+}
+
+void split_copy_out(MIRROR_RING* ring, void* dst, const uint8_t* src, uint32_t len)
+{
+    uint32_t offset = src - ring->data;
+    uint32_t first = (len < ring->size - offset)? len : ring->size - offset;
+
+    memcpy(dst, ring->data + offset, first);
+    memcpy((uint8_t*) dst + first, ring->data, len - first);
+}
+
+//------------------------------
+// Применение кольцевого буфера
+//------------------------------
+
+void thread_producer(BENCH* bench)
+{
+    MIRROR_RING* ring = &bench->ring;
+    uint64_t state = 0U;
+
+    for (uint64_t snd_i = 0U; snd_i < NUM_RECORDS; ++snd_i)
+    {
+        uint32_t len = record_len(&state);
+
+        uint8_t* dst = NULL;
+        uint32_t free_len = 0U;
+        uint32_t retry = 0U;
+        while (dst = mirror_ring_write_begin(ring, &free_len), free_len < RECORD_HEADER_SIZE + len)
+        {
+            backoff(&retry);
+        }
+
+        if (bench->mode == MODE_MIRRORED)
+        {
+            memcpy(dst, &len, RECORD_HEADER_SIZE);
+            memset(dst + RECORD_HEADER_SIZE, (uint8_t) snd_i, len);
+        }
+        else
+        {
+            split_copy_in(ring, dst, &len, RECORD_HEADER_SIZE);
+
+            uint32_t offset = (dst - ring->data + RECORD_HEADER_SIZE) & (ring->size - 1U);
+            split_fill(ring, ring->data + offset, (uint8_t) snd_i, len);
+        }
+
+        mirror_ring_write_commit(ring, RECORD_HEADER_SIZE + len);
+    }
+}
+
+void thread_consumer(BENCH* bench)
+{
+    MIRROR_RING* ring = &bench->ring;
+    uint64_t state = 0U;
+
+    uint8_t* linear = (uint8_t*) malloc(MAX_RECORD_LEN);
+    if (linear == NULL)
+    {
+        printf("Unable to allocate linearization buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_RECORDS; ++rcv_i)
+    {
+        uint32_t expected_len = record_len(&state);
+
+        // Ждём запись целиком: заголовок, затем данные.
+        const uint8_t* src = NULL;
+        uint32_t used_len = 0U;
+        uint32_t len = 0U;
+        uint32_t retry = 0U;
+        while (true)
+        {
+            src = mirror_ring_read_begin(ring, &used_len);
+
+            if (used_len >= RECORD_HEADER_SIZE)
+            {
+                if (bench->mode == MODE_MIRRORED)
+                {
+                    memcpy(&len, src, RECORD_HEADER_SIZE);
+                }
+                else
+                {
+                    split_copy_out(ring, &len, src, RECORD_HEADER_SIZE);
+                }
+
+                // Compare result:
+                // Такая запись никогда не поместится в буфер линеаризации: ожидание не завершится.
+                if (len > MAX_RECORD_LEN)
+                {
+                    printf("Invalid record header: record %lu, length %u exceeds %u\n", rcv_i, len, MAX_RECORD_LEN);
+                    exit(EXIT_FAILURE);
+                }
+
+                if (used_len >= RECORD_HEADER_SIZE + len)
+                {
+                    break;
+                }
+            }
+
+            backoff(&retry);
+        }
+
+        // Compare result:
+        if (len != expected_len)
+        {
+            printf("Invalid record length: record %lu, expected %u, got %u\n", rcv_i, expected_len, len);
+            exit(EXIT_FAILURE);
+        }
+
+        const uint8_t* record = NULL;
+        if (bench->mode == MODE_MIRRORED)
+        {
+            record = src + RECORD_HEADER_SIZE;
+        }
+        else
+        {
+            uint32_t offset = (src - ring->data + RECORD_HEADER_SIZE) & (ring->size - 1U);
+            record = ring->data + offset;
+
+            // Запись на стыке линеаризуется копированием.
+            if (offset + len > ring->size)
+            {
+                split_copy_out(ring, linear, record, len);
+                bench->copied_bytes += len;
+                record = linear;
+            }
+        }
+
+        for (uint32_t i = 0U; i < len; ++i)
+        {
+            if (record[i] != (uint8_t) rcv_i)
+            {
+                printf("Invalid record content: record %lu, byte %u\n", rcv_i, i);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        mirror_ring_read_commit(ring, RECORD_HEADER_SIZE + len);
+    }
+
+    free(linear);
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS 2U
+
+typedef struct {
+    size_t thread_i;
+    BENCH* bench;
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->thread_i == 0U)
+    {
+        thread_producer(args->bench);
+    }
+    else
+    {
+        thread_consumer(args->bench);
+    }
+
+    return NULL;
+}
+
+// Запускает пару писатель-читатель и возвращает время выполнения в секундах.
+double run_threads(BENCH* bench)
+{
+    THREAD_ARGS args[NUM_THREADS];
+    pthread_t tids[NUM_THREADS];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].bench = bench;
+
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&tids[i], &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+int main()
+{
+    printf("%-10s %14s %12s %10s\n", "Mode", "Records/s", "MiB/s", "Copied %");
+
+    for (MODE mode = MODE_MIRRORED; mode <= MODE_SPLIT; ++mode)
+    {
+        BENCH bench = {.mode = mode, .copied_bytes = 0U};
+        mirror_ring_init(&bench.ring, RING_SIZE);
+
+        double elapsed = run_threads(&bench);
+
+        // Средняя длина записи - (MAX_RECORD_LEN + 1) / 2.
+        double bytes = NUM_RECORDS * (MAX_RECORD_LEN + 1U) / 2.0;
+        printf("%-10s %14.0f %12.1f %10.2f\n", MODE_NAMES[mode],
+            NUM_RECORDS / elapsed, bytes / elapsed / (1U << 20U), 100.0 * bench.copied_bytes / bytes);
+
+        mirror_ring_free(&bench.ring);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_MIRROR_RING
+#define MSUSEM_MIRROR_RING
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <stdatomic.h>
+
+//------------------------------
+// Зеркально отображённый буфер
+//------------------------------
+// Байтовый кольцевой буфер SPSC, память которого (memfd) отображена в адресное пространство
+// дважды подряд: байт data[i] и байт data[i + size] - одна и та же физическая память.
+// Поэтому любое окно длиной до size байт, начинающееся в [data, data + size),
+// непрерывно в виртуальной памяти, и его можно целиком передать в read()/write()/send()
+// или разборщику протокола без разбиения на два iovec и без memmove().
+//
+// Порядок работы писателя:
+//     uint8_t* dst = mirror_ring_write_begin(ring, &len); ... записываем до len байт ...; mirror_ring_write_commit(ring, n);
+// Порядок работы читателя:
+//     const uint8_t* src = mirror_ring_read_begin(ring, &len); ... читаем до len байт ...; mirror_ring_read_commit(ring, n);
+//
+// Размер буфера - степень двойки, кратная размеру страницы.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+
+    // Количество прочитанных и записанных байт.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;
+} MIRROR_RING;
+
+void mirror_ring_init(MIRROR_RING* ring, uint32_t size)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (size == 0 || ((size - 1) & size) != 0 || size % page_size != 0 || size > (1U << 30))
+    {
+        printf("mirror_ring_init: size (%u) is expected to be power of two and multiple of page size\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = memfd_create("mirror-ring", MFD_CLOEXEC);
+    if (fd == -1 || ftruncate(fd, size) == -1)
+    {
+        fprintf(stderr, "mirror_ring_init: unable to create memfd: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Резервируем непрерывный диапазон адресов под две копии.
+    uint8_t* base = (uint8_t*) mmap(NULL, 2U * (size_t) size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        fprintf(stderr, "mirror_ring_init: unable to reserve address range: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Отображаем memfd поверх обеих половин диапазона.
+    for (size_t copy = 0U; copy < 2U; ++copy)
+    {
+        void* mapping = mmap(base + copy * size, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            fprintf(stderr, "mirror_ring_init: unable to map memfd: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Отображения удерживают memfd: дескриптор больше не нужен.
+    close(fd);
+
+    ring->data = base;
+    ring->size = size;
+    atomic_init(&ring->head, 0U);
+    atomic_init(&ring->tail, 0U);
+}
+
+void mirror_ring_free(MIRROR_RING* ring)
+{
+    munmap(ring->data, 2U * (size_t) ring->size);
+}
+
+//-------------------
+// Операции писателя
+//-------------------
+
+// Возвращает начало непрерывной свободной области и записывает её длину в len.
+// Позиция читателя перечитывается при каждом вызове: это одна загрузка на системный вызов.
+uint8_t* mirror_ring_write_begin(MIRROR_RING* ring, uint32_t* len)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    *len = ring->size - (tail - head);
+    return ring->data + (tail & (ring->size - 1U));
+}
+
+// Публикует len байт, записанных в область из mirror_ring_write_begin().
+void mirror_ring_write_commit(MIRROR_RING* ring, uint32_t len)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+// Копирует в буфер столько байт из buf, сколько помещается. Возвращает их количество.
+uint32_t mirror_ring_write(MIRROR_RING* ring, const void* buf, uint32_t len)
+{
+    uint32_t free_len = 0U;
+    uint8_t* dst = mirror_ring_write_begin(ring, &free_len);
+
+    len = (len < free_len)? len : free_len;
+    memcpy(dst, buf, len);
+    mirror_ring_write_commit(ring, len);
+
+    return len;
+}
+
+//-------------------
+// Операции читателя
+//-------------------
+
+// Возвращает начало непрерывной области с данными и записывает её длину в len.
+const uint8_t* mirror_ring_read_begin(MIRROR_RING* ring, uint32_t* len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    *len = tail - head;
+    return ring->data + (head & (ring->size - 1U));
+}
+
+// Освобождает len байт в начале области из mirror_ring_read_begin().
+void mirror_ring_read_commit(MIRROR_RING* ring, uint32_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+// Копирует в buf до len байт. Возвращает их количество.
+uint32_t mirror_ring_read(MIRROR_RING* ring, void* buf, uint32_t len)
+{
+    uint32_t used_len = 0U;
+    const uint8_t* src = mirror_ring_read_begin(ring, &used_len);
+
+    len = (len < used_len)? len : used_len;
+    memcpy(buf, src, len);
+    mirror_ring_read_commit(ring, len);
+
+    return len;
+}
+
+bool mirror_ring_empty(MIRROR_RING* ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) ==
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+#endif // MSUSEM_MIRROR_RING
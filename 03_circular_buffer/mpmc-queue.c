@@ -0,0 +1,476 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define QUEUE_SIZE 1024U
+
+// Длительность одного замера.
+#define DURATION_MS 1000U
+
+// Перебираемые количества писателей и читателей: 1, 2, 4, ..., MAX_THREADS.
+#define MAX_THREADS 4U
+
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#include "mpmc-queue.h"
+
+//===============================
+// Очередь на мьютексе и condvar
+//===============================
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    uint64_t* data;
+    uint32_t size;
+    uint32_t head;
+    uint32_t tail;
+
+    // Писатели завершили работу: читатели не должны засыпать на пустой очереди.
+    bool closed;
+} LOCKED_QUEUE;
+
+void locked_queue_init(LOCKED_QUEUE* queue, uint32_t size)
+{
+    queue->data = (uint64_t*) calloc(size, sizeof(uint64_t));
+    if (queue->data == NULL)
+    {
+        printf("locked_queue_init: size (%u) is too big\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+
+    queue->size = size;
+    queue->head = 0U;
+    queue->tail = 0U;
+    queue->closed = false;
+}
+
+void locked_queue_free(LOCKED_QUEUE* queue)
+{
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->data);
+}
+
+void locked_enqueue(LOCKED_QUEUE* queue, uint64_t elem)
+{
+    pthread_mutex_lock(&queue->mutex);
+
+    while (queue->tail - queue->head == queue->size)
+    {
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    }
+
+    queue->data[queue->tail % queue->size] = elem;
+    queue->tail++;
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// Возвращает false, если очередь закрыта и пуста.
+bool locked_dequeue(LOCKED_QUEUE* queue, uint64_t* elem)
+{
+    pthread_mutex_lock(&queue->mutex);
+
+    while (queue->tail == queue->head && !queue->closed)
+    {
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    }
+
+    bool success = queue->tail != queue->head;
+    if (success)
+    {
+        *elem = queue->data[queue->head % queue->size];
+        queue->head++;
+
+        pthread_cond_signal(&queue->not_full);
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return success;
+}
+
+void locked_queue_close(LOCKED_QUEUE* queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+//=================================
+// Сравниваемые реализации очереди
+//=================================
+
+typedef enum {
+    KIND_MPMC,
+    KIND_MPSC,
+    KIND_SPMC,
+    KIND_LOCKED
+} QUEUE_KIND;
+
+const char* KIND_NAMES[] = {"mpmc", "mpsc", "spmc", "mutex"};
+
+typedef struct {
+    QUEUE_KIND kind;
+    MPMC_QUEUE mpmc;
+    LOCKED_QUEUE locked;
+
+    // Писатели должны завершить работу.
+    _Atomic bool stop;
+    // Писатели завершили работу.
+    _Atomic bool done;
+} BENCH;
+
+bool bench_enqueue(BENCH* bench, uint64_t elem)
+{
+    switch (bench->kind)
+    {
+        case KIND_SPMC:
+            return spmc_enqueue(&bench->mpmc, elem);
+        case KIND_LOCKED:
+            locked_enqueue(&bench->locked, elem);
+            return true;
+        default:
+            return mpmc_enqueue(&bench->mpmc, elem);
+    }
+}
+
+bool bench_dequeue(BENCH* bench, uint64_t* elem)
+{
+    switch (bench->kind)
+    {
+        case KIND_MPSC:
+            return mpsc_dequeue(&bench->mpmc, elem);
+        case KIND_LOCKED:
+            return locked_dequeue(&bench->locked, elem);
+        default:
+            return mpmc_dequeue(&bench->mpmc, elem);
+    }
+}
+
+//--------------------
+// Применение очереди
+//--------------------
+// Элемент кодирует номер писателя (старшие биты) и его порядковый номер.
+// Порядок элементов одного писателя сохраняется очередью, что и проверяет каждый читатель.
+
+#define PRODUCER_SHIFT 40U
+#define SEQUENCE_MASK  ((1ULL << PRODUCER_SHIFT) - 1U)
+
+typedef struct {
+    BENCH* bench;
+    size_t thread_i;
+    uint64_t num_ops;
+} THREAD_ARGS;
+
+void* thread_producer(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+    BENCH* bench = args->bench;
+
+    uint64_t snd_i = 0U;
+    while (!atomic_load_explicit(&bench->stop, memory_order_relaxed))
+    {
+        uint64_t elem = (args->thread_i << PRODUCER_SHIFT) | snd_i;
+
+        uint32_t retry = 0U;
+        while (!bench_enqueue(bench, elem))
+        {
+            retry++;
+
+            if (ENABLE_BACKOFF && retry == NUM_RETRIES)
+            {
+                retry = 0U;
+                sched_yield();
+            }
+        }
+
+        snd_i++;
+    }
+
+    args->num_ops = snd_i;
+    return NULL;
+}
+
+void* thread_consumer(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+    BENCH* bench = args->bench;
+
+    // Следующий ожидаемый порядковый номер от каждого из писателей.
+    uint64_t expected[MAX_THREADS] = {0U};
+
+    uint64_t rcv_i = 0U;
+    while (true)
+    {
+        uint64_t elem = 0U;
+
+        bool success = false;
+        uint32_t retry = 0U;
+        while (!(success = bench_dequeue(bench, &elem)))
+        {
+            // Очередь пуста: завершаемся, если писатели уже закончили работу.
+            // NOTE: проверяем флаг до повторной попытки, чтобы не потерять последние элементы.
+            if (atomic_load_explicit(&bench->done, memory_order_acquire))
+            {
+                success = bench_dequeue(bench, &elem);
+                break;
+            }
+
+            retry++;
+
+            if (ENABLE_BACKOFF && retry == NUM_RETRIES)
+            {
+                retry = 0U;
+                sched_yield();
+            }
+        }
+
+        if (!success)
+        {
+            break;
+        }
+
+        // Compare result:
+        uint64_t producer_i = elem >> PRODUCER_SHIFT;
+        uint64_t snd_i      = elem &  SEQUENCE_MASK;
+        if (producer_i >= MAX_THREADS || snd_i < expected[producer_i])
+        {
+            printf("Invalid queue element: producer %lu, sequence %lu\n", producer_i, snd_i);
+            exit(EXIT_FAILURE);
+        }
+
+        expected[producer_i] = snd_i + 1U;
+        rcv_i++;
+    }
+
+    args->num_ops = rcv_i;
+    return NULL;
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+// Аппаратные потоки, на которых процессу разрешено исполняться.
+int allowed_harts[CPU_SETSIZE];
+size_t num_allowed_harts = 0U;
+
+void find_allowed_harts()
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        fprintf(stderr, "Unable to call sched_getaffinity\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            allowed_harts[num_allowed_harts++] = cpu;
+        }
+    }
+}
+
+// Поток закрепляется за hart_i-м разрешённым аппаратным потоком (по кругу).
+void start_thread(pthread_t* tid, void* (*func)(void*), void* arg, size_t hart_i)
+{
+    // Инициализируем аттрибуты потока.
+    pthread_attr_t thread_attributes;
+    int ret = pthread_attr_init(&thread_attributes);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_init\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Назначаем аппаратный поток для потока POSIX.
+    cpu_set_t assigned_harts;
+    CPU_ZERO(&assigned_harts);
+    CPU_SET(allowed_harts[hart_i % num_allowed_harts], &assigned_harts);
+
+    // Устанавливаем аффинность потока.
+    ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Создаём поток POSIX.
+    ret = pthread_create(tid, &thread_attributes, func, arg);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to create thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Удаляем объект с аттрибутами потока.
+    pthread_attr_destroy(&thread_attributes);
+}
+
+void join_thread(pthread_t tid)
+{
+    int ret = pthread_join(tid, NULL);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to join thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Индекс справедливости Джайна: 1.0 - все потоки выполнили поровну операций, 1/n - работал один.
+double jain_fairness(const THREAD_ARGS* args, size_t num_threads)
+{
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        sum    += (double) args[i].num_ops;
+        sum_sq += (double) args[i].num_ops * (double) args[i].num_ops;
+    }
+
+    return (sum_sq == 0.0)? 1.0 : sum * sum / (num_threads * sum_sq);
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+void run_bench(QUEUE_KIND kind, size_t num_producers, size_t num_consumers)
+{
+    BENCH bench;
+    bench.kind = kind;
+    mpmc_queue_init(&bench.mpmc, QUEUE_SIZE);
+    locked_queue_init(&bench.locked, QUEUE_SIZE);
+    atomic_init(&bench.stop, false);
+    atomic_init(&bench.done, false);
+
+    THREAD_ARGS producers[MAX_THREADS];
+    THREAD_ARGS consumers[MAX_THREADS];
+    pthread_t producer_tids[MAX_THREADS];
+    pthread_t consumer_tids[MAX_THREADS];
+
+    // Запуск потоков: писатели и читатели чередуются по аппаратным потокам.
+    for (size_t i = 0U; i < num_consumers; ++i)
+    {
+        consumers[i] = (THREAD_ARGS) {.bench = &bench, .thread_i = i, .num_ops = 0U};
+        start_thread(&consumer_tids[i], thread_consumer, &consumers[i], 2U * i + 1U);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0U; i < num_producers; ++i)
+    {
+        producers[i] = (THREAD_ARGS) {.bench = &bench, .thread_i = i, .num_ops = 0U};
+        start_thread(&producer_tids[i], thread_producer, &producers[i], 2U * i);
+    }
+
+    struct timespec duration = {
+        .tv_sec  = DURATION_MS / 1000U,
+        .tv_nsec = (DURATION_MS % 1000U) * 1000000U
+    };
+    nanosleep(&duration, NULL);
+
+    // Останавливаем писателей, затем даём читателям опустошить очередь.
+    atomic_store_explicit(&bench.stop, true, memory_order_relaxed);
+    for (size_t i = 0U; i < num_producers; ++i)
+    {
+        join_thread(producer_tids[i]);
+    }
+
+    atomic_store_explicit(&bench.done, true, memory_order_release);
+    locked_queue_close(&bench.locked);
+    for (size_t i = 0U; i < num_consumers; ++i)
+    {
+        join_thread(consumer_tids[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Сверяем количество отправленных и полученных элементов.
+    uint64_t num_sent = 0U;
+    uint64_t num_received = 0U;
+    for (size_t i = 0U; i < num_producers; ++i)
+    {
+        num_sent += producers[i].num_ops;
+    }
+    for (size_t i = 0U; i < num_consumers; ++i)
+    {
+        num_received += consumers[i].num_ops;
+    }
+
+    if (num_sent != num_received)
+    {
+        printf("Lost queue elements: sent %lu, received %lu\n", num_sent, num_received);
+        exit(EXIT_FAILURE);
+    }
+
+    double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    printf("%-6s %4zu %4zu %14.0f %10.3f %10.3f\n",
+        KIND_NAMES[kind], num_producers, num_consumers, num_received / elapsed,
+        jain_fairness(producers, num_producers), jain_fairness(consumers, num_consumers));
+
+    locked_queue_free(&bench.locked);
+    mpmc_queue_free(&bench.mpmc);
+}
+
+int main()
+{
+    find_allowed_harts();
+
+    printf("%-6s %4s %4s %14s %10s %10s\n", "Queue", "P", "C", "Ops/s", "Fair(P)", "Fair(C)");
+
+    for (size_t num_producers = 1U; num_producers <= MAX_THREADS; num_producers *= 2U)
+    {
+        for (size_t num_consumers = 1U; num_consumers <= MAX_THREADS; num_consumers *= 2U)
+        {
+            run_bench(KIND_MPMC, num_producers, num_consumers);
+
+            // Специализации применимы только при единственном читателе или писателе.
+            if (num_consumers == 1U)
+            {
+                run_bench(KIND_MPSC, num_producers, num_consumers);
+            }
+            if (num_producers == 1U)
+            {
+                run_bench(KIND_SPMC, num_producers, num_consumers);
+            }
+
+            run_bench(KIND_LOCKED, num_producers, num_consumers);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
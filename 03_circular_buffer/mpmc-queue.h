@@ -0,0 +1,193 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_MPMC_QUEUE
+#define MSUSEM_MPMC_QUEUE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <stdatomic.h>
+
+//------------------------------------------
+// Очередь с множеством писателей/читателей
+//------------------------------------------
+// Ограниченная очередь Вьюкова (MPMC).
+// Каждый слот хранит порядковый номер (sequence), по которому поток определяет его состояние:
+// - sequence == pos     - слот свободен и ждёт писателя с позицией pos;
+// - sequence == pos + 1 - слот заполнен и ждёт читателя с позицией pos;
+// - иначе               - слот занят другим кругом очереди.
+// Писатели конкурируют только за tail, читатели - только за head.
+// Слоты выровнены по кеш-линии, чтобы соседние операции не делили одну линию.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t sequence;
+    uint64_t data;
+} MPMC_SLOT;
+
+typedef struct {
+    MPMC_SLOT* slots;
+    uint32_t size;
+
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;
+} MPMC_QUEUE;
+
+void mpmc_queue_init(MPMC_QUEUE* queue, uint32_t size)
+{
+    if (size == 0 || ((size - 1) & size) != 0)
+    {
+        printf("mpmc_queue_init: size (%u) is expected to be power of two\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    queue->slots = (MPMC_SLOT*) aligned_alloc(CACHE_LINE_SIZE, size * sizeof(MPMC_SLOT));
+    if (queue->slots == NULL)
+    {
+        printf("mpmc_queue_init: size (%u) is too big\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0U; i < size; ++i)
+    {
+        atomic_init(&queue->slots[i].sequence, i);
+        queue->slots[i].data = 0U;
+    }
+
+    queue->size = size;
+    atomic_init(&queue->tail, 0U);
+    atomic_init(&queue->head, 0U);
+}
+
+void mpmc_queue_free(MPMC_QUEUE* queue)
+{
+    free(queue->slots);
+}
+
+bool mpmc_enqueue(MPMC_QUEUE* queue, uint64_t elem)
+{
+    MPMC_SLOT* slot;
+    uint32_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    while (true)
+    {
+        slot = &queue->slots[pos & (queue->size - 1U)];
+
+        // [1] Синхронизируемся с освобождением слота читателем (см. [4]).
+        uint32_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int32_t diff = (int32_t) (seq - pos);
+
+        if (diff == 0)
+        {   // Слот свободен: пытаемся занять позицию pos.
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1U,
+                    memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {   // Слот ещё не освобождён читателем с прошлого круга: очередь полна.
+            return false;
+        }
+        else
+        {   // Позицию pos уже занял другой писатель.
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->data = elem;
+
+    // [2] Публикуем элемент для читателя (см. [3]).
+    atomic_store_explicit(&slot->sequence, pos + 1U, memory_order_release);
+
+    return true;
+}
+
+bool mpmc_dequeue(MPMC_QUEUE* queue, uint64_t* elem)
+{
+    MPMC_SLOT* slot;
+    uint32_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+    while (true)
+    {
+        slot = &queue->slots[pos & (queue->size - 1U)];
+
+        // [3] Синхронизируемся с публикацией элемента писателем (см. [2]).
+        uint32_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int32_t diff = (int32_t) (seq - (pos + 1U));
+
+        if (diff == 0)
+        {   // Слот заполнен: пытаемся занять позицию pos.
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1U,
+                    memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {   // Писатель ещё не заполнил слот: очередь пуста.
+            return false;
+        }
+        else
+        {   // Позицию pos уже занял другой читатель.
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+
+    *elem = slot->data;
+
+    // [4] Освобождаем слот для писателя следующего круга (см. [1]).
+    atomic_store_explicit(&slot->sequence, pos + queue->size, memory_order_release);
+
+    return true;
+}
+
+//---------------------------
+// Специализации MPSC и SPMC
+//---------------------------
+// Единственный читатель (MPSC) или писатель (SPMC) не конкурирует за свой индекс,
+// поэтому обходится без CAS. Парная сторона использует обычные mpmc_enqueue()/mpmc_dequeue().
+
+// Извлечение элемента единственным читателем.
+bool mpsc_dequeue(MPMC_QUEUE* queue, uint64_t* elem)
+{
+    uint32_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    MPMC_SLOT* slot = &queue->slots[pos & (queue->size - 1U)];
+
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos + 1U)
+    {   // Очередь пуста.
+        return false;
+    }
+
+    *elem = slot->data;
+
+    atomic_store_explicit(&queue->head, pos + 1U, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, pos + queue->size, memory_order_release);
+
+    return true;
+}
+
+// Добавление элемента единственным писателем.
+bool spmc_enqueue(MPMC_QUEUE* queue, uint64_t elem)
+{
+    uint32_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    MPMC_SLOT* slot = &queue->slots[pos & (queue->size - 1U)];
+
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != pos)
+    {   // Очередь полна.
+        return false;
+    }
+
+    slot->data = elem;
+
+    atomic_store_explicit(&queue->tail, pos + 1U, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, pos + 1U, memory_order_release);
+
+    return true;
+}
+
+#endif // MSUSEM_MPMC_QUEUE
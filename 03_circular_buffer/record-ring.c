@@ -0,0 +1,236 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define RING_SIZE   (1U << 16U)
+#define NUM_RECORDS 10000000ULL
+
+// Длины записей равномерно распределены на отрезке [1, MAX_RECORD_LEN].
+#define MAX_RECORD_LEN 2048U
+
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "record-ring.h"
+
+//--------------------
+// Содержимое записей
+//--------------------
+// Писатель и читатель независимо порождают одну и ту же последовательность длин,
+// а каждый байт записи равен младшему байту её номера.
+
+uint32_t record_len(uint64_t* state)
+{
+    // Линейный конгруэнтный генератор.
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return 1U + (uint32_t) ((*state >> 33U) % MAX_RECORD_LEN);
+}
+
+//------------------------------
+// Применение кольцевого буфера
+//------------------------------
+
+void thread_producer(RECORD_RING* ring)
+{
+    uint64_t state = 0U;
+
+    for (uint64_t snd_i = 0U; snd_i < NUM_RECORDS; ++snd_i)
+    {
+        uint32_t len = record_len(&state);
+
+        uint8_t* record = NULL;
+        uint32_t retry = 0U;
+        while ((record = record_ring_reserve(ring, len)) == NULL)
+        {
+            retry++;
+
+            if (ENABLE_BACKOFF && retry == NUM_RETRIES)
+            {
+                retry = 0U;
+                sched_yield();
+            }
+        }
+
+        // Заполняем запись на месте.
+        memset(record, (uint8_t) snd_i, len);
+
+        record_ring_commit(ring, len);
+    }
+}
+
+void thread_consumer(RECORD_RING* ring)
+{
+    uint64_t state = 0U;
+
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_RECORDS; ++rcv_i)
+    {
+        uint32_t expected_len = record_len(&state);
+
+        const uint8_t* record = NULL;
+        uint32_t len = 0U;
+        uint32_t retry = 0U;
+        while ((record = record_ring_peek(ring, &len)) == NULL)
+        {
+            retry++;
+
+            if (ENABLE_BACKOFF && retry == NUM_RETRIES)
+            {
+                retry = 0U;
+                sched_yield();
+            }
+        }
+
+        // Compare result:
+        if (len != expected_len)
+        {
+            printf("Invalid record length: record %lu, expected %u, got %u\n", rcv_i, expected_len, len);
+            exit(EXIT_FAILURE);
+        }
+
+        for (uint32_t i = 0U; i < len; ++i)
+        {
+            if (record[i] != (uint8_t) rcv_i)
+            {
+                printf("Invalid record content: record %lu, byte %u\n", rcv_i, i);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        record_ring_release(ring);
+    }
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+typedef struct {
+    size_t thread_i;
+    RECORD_RING* ring;
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->thread_i == 0U)
+    {
+        thread_producer(args->ring);
+    }
+    else
+    {
+        thread_consumer(args->ring);
+    }
+
+    return NULL;
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+#define NUM_THREADS 2U
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+int main()
+{
+    RECORD_RING ring;
+    record_ring_init(&ring, RING_SIZE);
+
+    // Инициализируем параметры потоков.
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].ring = &ring;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        size_t hart_i = i % NUM_HARDWARE_THREADS;
+        CPU_SET(hart_i, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Средняя длина записи - (MAX_RECORD_LEN + 1) / 2.
+    double elapsed = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+    double bytes = NUM_RECORDS * (MAX_RECORD_LEN + 1U) / 2.0;
+    printf("Records/s: %.0f\n", NUM_RECORDS / elapsed);
+    printf("Bandwidth: %.1f MiB/s\n", bytes / elapsed / (1U << 20U));
+
+    record_ring_free(&ring);
+
+    return EXIT_SUCCESS;
+}
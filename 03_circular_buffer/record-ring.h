@@ -0,0 +1,210 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_RECORD_RING
+#define MSUSEM_RECORD_RING
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <stdatomic.h>
+
+//------------------------------------------
+// Кольцевой буфер записей переменной длины
+//------------------------------------------
+// Байтовое кольцо с одним писателем и одним читателем (SPSC).
+// Каждая запись предваряется заголовком с длиной и выравнивается на RECORD_ALIGNMENT байт.
+// Запись никогда не разрезается концом буфера: если она не помещается в остаток буфера,
+// писатель ставит в остаток маркер RECORD_PADDING, и запись начинается с начала буфера.
+//
+// Писатель:                             Читатель:
+//     ptr = record_ring_reserve(len)        ptr = record_ring_peek(&len)
+//     ... запись на месте по ptr ...        ... чтение на месте по ptr ...
+//     record_ring_commit(len)               record_ring_release()
+//
+// Данные копируются ровно один раз - самим писателем в буфер, память на запись не выделяется.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+// Заголовок записи занимает RECORD_ALIGNMENT байт, чтобы данные записи были выровнены.
+#define RECORD_ALIGNMENT   8U
+#define RECORD_HEADER_SIZE RECORD_ALIGNMENT
+
+// Длина в заголовке, означающая пропуск остатка буфера.
+#define RECORD_PADDING UINT32_MAX
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+
+    // Состояние писателя:
+    _Alignas(CACHE_LINE_SIZE) uint32_t cached_head;
+    // Позиция заголовка зарезервированной записи.
+    uint32_t reserved_pos;
+    uint32_t reserved_len;
+
+    // Состояние читателя:
+    _Alignas(CACHE_LINE_SIZE) uint32_t cached_tail;
+    // Позиция заголовка прочитанной записи.
+    uint32_t peeked_pos;
+    uint32_t peeked_len;
+
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;
+} RECORD_RING;
+
+// Полный размер записи с заголовком и выравниванием.
+uint32_t record_ring_footprint(uint32_t len)
+{
+    return RECORD_HEADER_SIZE + ((len + RECORD_ALIGNMENT - 1U) & ~(RECORD_ALIGNMENT - 1U));
+}
+
+void record_ring_init(RECORD_RING* ring, uint32_t size)
+{
+    if (size < RECORD_ALIGNMENT || ((size - 1) & size) != 0)
+    {
+        printf("record_ring_init: size (%u) is expected to be power of two\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    ring->data = (uint8_t*) aligned_alloc(CACHE_LINE_SIZE, size);
+    if (ring->data == NULL)
+    {
+        printf("record_ring_init: size (%u) is too big\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    ring->size = size;
+    ring->cached_head  = 0U;
+    ring->reserved_pos = 0U;
+    ring->reserved_len = 0U;
+    ring->cached_tail  = 0U;
+    ring->peeked_pos   = 0U;
+    ring->peeked_len   = 0U;
+    atomic_init(&ring->head, 0U);
+    atomic_init(&ring->tail, 0U);
+}
+
+void record_ring_free(RECORD_RING* ring)
+{
+    free(ring->data);
+}
+
+// Наибольшая длина записи, которая гарантированно помещается в пустой буфер
+// (с учётом маркера пропуска перед ней).
+uint32_t record_ring_max_len(const RECORD_RING* ring)
+{
+    return ring->size / 2U - RECORD_HEADER_SIZE;
+}
+
+//-------------------
+// Операции писателя
+//-------------------
+
+// Резервирует место под запись длины len.
+// Возвращает указатель на данные записи или NULL, если места недостаточно.
+void* record_ring_reserve(RECORD_RING* ring, uint32_t len)
+{
+    if (len > record_ring_max_len(ring))
+    {
+        printf("record_ring_reserve: record length (%u) exceeds ring capacity\n", len);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t tail  = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t index = tail & (ring->size - 1U);
+
+    // Если запись не помещается в остаток буфера, остаток отводится под маркер пропуска.
+    uint32_t footprint = record_ring_footprint(len);
+    uint32_t skip = (ring->size - index < footprint)? ring->size - index : 0U;
+
+    if (ring->size - (tail - ring->cached_head) < skip + footprint)
+    {
+        // Кешированное значение устарело: перечитываем голову кольца.
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if (ring->size - (tail - ring->cached_head) < skip + footprint)
+        {
+            return NULL;
+        }
+    }
+
+    if (skip != 0U)
+    {
+        // Маркер станет виден читателю вместе с записью при commit().
+        *(uint32_t*) &ring->data[index] = RECORD_PADDING;
+        index = 0U;
+    }
+
+    ring->reserved_pos = tail + skip;
+    ring->reserved_len = len;
+
+    return &ring->data[index + RECORD_HEADER_SIZE];
+}
+
+// Публикует зарезервированную запись.
+// Длина len может быть меньше зарезервированной (например, если read() вернул меньше байт).
+void record_ring_commit(RECORD_RING* ring, uint32_t len)
+{
+    if (len > ring->reserved_len)
+    {
+        printf("record_ring_commit: committed length (%u) exceeds reserved (%u)\n",
+            len, ring->reserved_len);
+        exit(EXIT_FAILURE);
+    }
+
+    *(uint32_t*) &ring->data[ring->reserved_pos & (ring->size - 1U)] = len;
+
+    // Публикуем заголовок, данные и маркер пропуска одной release-записью.
+    atomic_store_explicit(&ring->tail, ring->reserved_pos + record_ring_footprint(len),
+        memory_order_release);
+}
+
+//-------------------
+// Операции читателя
+//-------------------
+
+// Возвращает указатель на данные очередной записи и её длину в len
+// или NULL, если кольцо пусто.
+const void* record_ring_peek(RECORD_RING* ring, uint32_t* len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (ring->cached_tail == head)
+    {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+        if (ring->cached_tail == head)
+        {
+            return NULL;
+        }
+    }
+
+    uint32_t index  = head & (ring->size - 1U);
+    uint32_t header = *(const uint32_t*) &ring->data[index];
+
+    if (header == RECORD_PADDING)
+    {
+        // За маркером пропуска всегда следует запись из того же commit().
+        head += ring->size - index;
+        index = 0U;
+        header = *(const uint32_t*) &ring->data[0];
+    }
+
+    ring->peeked_pos = head;
+    ring->peeked_len = header;
+
+    *len = header;
+    return &ring->data[index + RECORD_HEADER_SIZE];
+}
+
+// Освобождает место, занятое записью из последнего record_ring_peek().
+void record_ring_release(RECORD_RING* ring)
+{
+    atomic_store_explicit(&ring->head, ring->peeked_pos + record_ring_footprint(ring->peeked_len),
+        memory_order_release);
+}
+
+#endif // MSUSEM_RECORD_RING
@@ -0,0 +1,265 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+// Журнал по умолчанию создаётся в текущем каталоге: путь к новому файлу можно передать аргументом.
+#define LOG_PATH "ring-log.bin"
+
+#define LOG_FILE_SIZE   (64ULL << 20U)
+#define LOG_BUFFER_SIZE (1U << 20U)
+
+// Размер одной записи журнала метаданных.
+#define RECORD_SIZE 128U
+
+// Длительность одного замера.
+#define DURATION_MS 1000U
+
+// Перебираемые количества писателей: 1, 2, 4, ..., MAX_WRITERS.
+#define MAX_WRITERS 32U
+
+// Количество сохраняемых замеров задержки на писателя.
+#define MAX_SAMPLES (1U << 16U)
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "ring-log.h"
+
+typedef struct {
+    RING_LOG* log;
+    _Atomic bool* stop;
+    size_t thread_i;
+
+    uint64_t num_commits;
+    uint64_t* latency;
+} THREAD_ARGS;
+
+uint64_t time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+//------------------
+// Писатели журнала
+//------------------
+
+void* thread_writer(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    uint8_t record[RECORD_SIZE];
+    memset(record, (uint8_t) args->thread_i, RECORD_SIZE);
+
+    uint64_t prev_lsn = 0U;
+    while (!atomic_load_explicit(args->stop, memory_order_relaxed))
+    {
+        memcpy(record, &args->num_commits, sizeof(args->num_commits));
+
+        uint64_t start = time_ns();
+        uint64_t lsn = ring_log_commit(args->log, record, RECORD_SIZE);
+        uint64_t latency = time_ns() - start;
+
+        // Compare result:
+        // Записи одного писателя получают возрастающие LSN.
+        if (lsn <= prev_lsn)
+        {
+            printf("Invalid commit: writer %zu, LSN %lu after %lu\n", args->thread_i, lsn, prev_lsn);
+            exit(EXIT_FAILURE);
+        }
+        prev_lsn = lsn;
+
+        if (args->num_commits < MAX_SAMPLES)
+        {
+            args->latency[args->num_commits] = latency;
+        }
+        args->num_commits++;
+    }
+
+    return NULL;
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+void start_thread(pthread_t* tid, void* (*func)(void*), void* arg, size_t hart_i)
+{
+    // Инициализируем аттрибуты потока.
+    pthread_attr_t thread_attributes;
+    int ret = pthread_attr_init(&thread_attributes);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_init\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Назначаем аппаратный поток для потока POSIX.
+    cpu_set_t assigned_harts;
+    CPU_ZERO(&assigned_harts);
+    CPU_SET(hart_i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+    // Устанавливаем аффинность потока.
+    ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Создаём поток POSIX.
+    ret = pthread_create(tid, &thread_attributes, func, arg);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to create thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Удаляем объект с аттрибутами потока.
+    pthread_attr_destroy(&thread_attributes);
+}
+
+void join_thread(pthread_t tid)
+{
+    int ret = pthread_join(tid, NULL);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to join thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+// Замеры задержки всех писателей.
+uint64_t latency[MAX_WRITERS * MAX_SAMPLES];
+
+// Возвращает LSN конца журнала после замера.
+uint64_t run_bench(const char* path, size_t num_writers, uint64_t start_lsn)
+{
+    RING_LOG log;
+    ring_log_open(&log, path, LOG_FILE_SIZE, LOG_BUFFER_SIZE);
+
+    // Compare result:
+    // Журнал открыт повторно: восстановленный конец совпадает с концом предыдущего замера.
+    if (log.appended_lsn != start_lsn)
+    {
+        printf("Invalid recovery: LSN %lu, expected %lu\n", log.appended_lsn, start_lsn);
+        exit(EXIT_FAILURE);
+    }
+
+    _Atomic bool stop;
+    atomic_init(&stop, false);
+
+    THREAD_ARGS writers[MAX_WRITERS];
+    pthread_t tids[MAX_WRITERS];
+
+    uint64_t start = time_ns();
+
+    for (size_t i = 0U; i < num_writers; ++i)
+    {
+        writers[i] = (THREAD_ARGS) {
+            .log = &log,
+            .stop = &stop,
+            .thread_i = i,
+            .num_commits = 0U,
+            .latency = &latency[i * MAX_SAMPLES]
+        };
+        start_thread(&tids[i], thread_writer, &writers[i], i);
+    }
+
+    struct timespec duration = {
+        .tv_sec  = DURATION_MS / 1000U,
+        .tv_nsec = (DURATION_MS % 1000U) * 1000000U
+    };
+    nanosleep(&duration, NULL);
+
+    atomic_store_explicit(&stop, true, memory_order_relaxed);
+    for (size_t i = 0U; i < num_writers; ++i)
+    {
+        join_thread(tids[i]);
+    }
+
+    double elapsed = 1e-9 * (time_ns() - start);
+    uint64_t num_groups = log.num_groups;
+
+    ring_log_close(&log);
+
+    uint64_t end_lsn = log.appended_lsn;
+
+    // Собираем замеры задержки в один массив.
+    uint64_t num_commits = 0U;
+    uint64_t num_samples = 0U;
+    for (size_t i = 0U; i < num_writers; ++i)
+    {
+        uint64_t writer_samples = (writers[i].num_commits < MAX_SAMPLES)? writers[i].num_commits : MAX_SAMPLES;
+        memmove(&latency[num_samples], writers[i].latency, writer_samples * sizeof(uint64_t));
+
+        num_commits += writers[i].num_commits;
+        num_samples += writer_samples;
+    }
+
+    qsort(latency, num_samples, sizeof(uint64_t), compare_u64);
+
+    printf("%4zu %12.0f %12.0f %14.1f %10.1f %10.1f\n",
+        num_writers, num_commits / elapsed, num_groups / elapsed,
+        (num_groups == 0U)? 0.0 : (double) num_commits / num_groups,
+        (num_samples == 0U)? 0.0 : latency[num_samples / 2U] / 1e3,
+        (num_samples == 0U)? 0.0 : latency[num_samples * 99U / 100U] / 1e3);
+
+    return end_lsn;
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = (argc > 1)? argv[1] : LOG_PATH;
+
+    // Журнал создаётся программой заново: существующий файл не перезаписывается и не удаляется.
+    // Первый замер заполняет пустой файл нулями, следующие - открывают его повторно.
+    int fd = open(path, O_CREAT|O_EXCL|O_WRONLY|O_CLOEXEC, 0600);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Unable to create '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    printf("Log file: %s, record size: %u bytes\n", path, RECORD_SIZE);
+    printf("%4s %12s %12s %14s %10s %10s\n", "W", "Commits/s", "Fsyncs/s", "Commits/group", "p50 us", "p99 us");
+
+    uint64_t lsn = 0U;
+    for (size_t num_writers = 1U; num_writers <= MAX_WRITERS; num_writers *= 2U)
+    {
+        lsn = run_bench(path, num_writers, lsn);
+    }
+
+    // Удаляем только созданный программой файл.
+    unlink(path);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,495 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_RING_LOG
+#define MSUSEM_RING_LOG
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+//-----------------------------------------
+// Устойчивый журнал с групповой фиксацией
+//-----------------------------------------
+// Журнал только на дописывание поверх предварительно выделенного файла, используемого по кругу.
+// LSN (log sequence number) - смещение байта в бесконечном логическом журнале;
+// в файле он хранится по смещению LSN % file_size.
+//
+// Несколько писателей дописывают записи в кольцевой буфер в памяти (под мьютексом - только копирование).
+// Выделенный поток-сбрасыватель забирает всё накопленное с прошлого сброса и записывает
+// одной группой: pwrite() (по одному на каждый стык буфера или файла) и один fdatasync().
+// Пока идёт fdatasync(), писатели накапливают следующую группу,
+// поэтому под нагрузкой одна синхронизация фиксирует записи многих писателей.
+//
+// Запись считается устойчивой, когда durable_lsn достиг LSN её конца.
+// Файл хранит последние file_size - buffer_size байт журнала: более старые записи перезаписываются,
+// поэтому контрольная точка приложения должна отставать от конца журнала не более чем на эту величину.
+//
+// Заголовок записи содержит её LSN и CRC32C: при повторном открытии файла
+// конец журнала восстанавливается по его содержимому (см. "Восстановление").
+
+// Заголовок записи.
+typedef struct {
+    // LSN начала записи: отличает записи текущего круга от остатков предыдущего.
+    uint64_t lsn;
+    // Длина данных.
+    uint32_t len;
+    // CRC32C длины, данных и LSN: отличает целую запись от недописанной.
+    uint32_t crc;
+} RING_LOG_HEADER;
+
+#define RING_LOG_HEADER_SIZE 16U
+
+// Записи начинаются с LSN, кратных RING_LOG_ALIGN.
+#define RING_LOG_ALIGN 8U
+
+_Static_assert(
+    sizeof(RING_LOG_HEADER) == RING_LOG_HEADER_SIZE,
+    "Invalid RING_LOG_HEADER size\n");
+
+typedef struct {
+    int fd;
+    uint64_t file_size;
+
+    uint8_t* buffer;
+    uint32_t buffer_size;
+
+    pthread_mutex_t mutex;
+    // Сбрасыватель ждёт новых записей.
+    pthread_cond_t flush_needed;
+    // Писатели ждут устойчивости своих записей или освобождения буфера.
+    pthread_cond_t durable;
+
+    // Конец последней дописанной записи.
+    uint64_t appended_lsn;
+    // Все байты до durable_lsn записаны на носитель.
+    uint64_t durable_lsn;
+    // Количество выполненных групп (fdatasync).
+    uint64_t num_groups;
+
+    bool closed;
+    pthread_t flusher;
+} RING_LOG;
+
+//--------
+// CRC32C
+//--------
+// Табличная реализация (полином Кастаньоли). Соглашение о вызове совпадает с crc32() из zlib:
+// crc32c(crc32c(0, A), B) == crc32c(0, A||B).
+// Реализация из 04_async_io/checksum.h не используется: она зависит от 04_async_io/common.h
+// и выбирает SSE4.2 во время исполнения, а заголовки 03_circular_buffer самодостаточны.
+
+#define RING_LOG_CRC32C_POLY 0x82F63B78U
+
+uint32_t ring_log_crc32c_table[256];
+pthread_once_t ring_log_crc32c_once = PTHREAD_ONCE_INIT;
+
+void ring_log_crc32c_init()
+{
+    for (uint32_t byte = 0U; byte < 256U; ++byte)
+    {
+        uint32_t crc = byte;
+        for (unsigned bit = 0U; bit < 8U; ++bit)
+        {
+            crc = (crc & 1U)? (crc >> 1U) ^ RING_LOG_CRC32C_POLY : (crc >> 1U);
+        }
+
+        ring_log_crc32c_table[byte] = crc;
+    }
+}
+
+uint32_t ring_log_crc32c(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+
+    crc = ~crc;
+    for (size_t i = 0U; i < len; ++i)
+    {
+        crc = ring_log_crc32c_table[(crc ^ bytes[i]) & 0xFFU] ^ (crc >> 8U);
+    }
+
+    return ~crc;
+}
+
+// Место, занимаемое записью в журнале.
+uint64_t ring_log_footprint(uint32_t len)
+{
+    return RING_LOG_HEADER_SIZE + ((len + RING_LOG_ALIGN - 1U) & ~(RING_LOG_ALIGN - 1U));
+}
+
+// CRC записи считается в два этапа: длина и данные - до захвата мьютекса,
+// LSN (известен только под мьютексом) - после.
+uint32_t ring_log_crc_data(uint32_t len, const void* data, size_t data_len)
+{
+    return ring_log_crc32c(ring_log_crc32c(0U, &len, sizeof(len)), data, data_len);
+}
+
+uint32_t ring_log_crc_finish(uint32_t crc, uint64_t lsn)
+{
+    return ring_log_crc32c(crc, &lsn, sizeof(lsn));
+}
+
+//--------------------
+// Поток-сбрасыватель
+//--------------------
+
+// Записывает байты журнала [start, end) из буфера в файл.
+void ring_log_write_range(RING_LOG* log, uint64_t start, uint64_t end)
+{
+    while (start != end)
+    {
+        // Кусок не пересекает ни стык буфера, ни стык файла.
+        uint64_t buffer_offset = start & (log->buffer_size - 1U);
+        uint64_t file_offset = start % log->file_size;
+
+        uint64_t len = end - start;
+        len = (len < log->buffer_size - buffer_offset)? len : log->buffer_size - buffer_offset;
+        len = (len < log->file_size - file_offset)? len : log->file_size - file_offset;
+
+        ssize_t written = pwrite(log->fd, log->buffer + buffer_offset, len, file_offset);
+        if (written <= 0)
+        {
+            fprintf(stderr, "ring_log: unable to write log file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        start += written;
+    }
+}
+
+void* ring_log_flusher(void* arg)
+{
+    RING_LOG* log = (RING_LOG*) arg;
+
+    pthread_mutex_lock(&log->mutex);
+
+    while (true)
+    {
+        while (log->appended_lsn == log->durable_lsn && !log->closed)
+        {
+            pthread_cond_wait(&log->flush_needed, &log->mutex);
+        }
+
+        if (log->appended_lsn == log->durable_lsn)
+        {
+            break;
+        }
+
+        // Забираем группу. Писатели не перезапишут её байты до продвижения durable_lsn.
+        uint64_t start = log->durable_lsn;
+        uint64_t end = log->appended_lsn;
+
+        pthread_mutex_unlock(&log->mutex);
+
+        ring_log_write_range(log, start, end);
+        if (fdatasync(log->fd) == -1)
+        {
+            fprintf(stderr, "ring_log: unable to fdatasync log file: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        pthread_mutex_lock(&log->mutex);
+
+        log->durable_lsn = end;
+        log->num_groups += 1U;
+        pthread_cond_broadcast(&log->durable);
+    }
+
+    pthread_mutex_unlock(&log->mutex);
+
+    return NULL;
+}
+
+//----------------
+// Восстановление
+//----------------
+// Конец журнала определяется по содержимому файла:
+// [1] Находим целую запись с наибольшим LSN конца. Она лежит в последней группе,
+//     которая могла быть записана не полностью: группа не длиннее буфера.
+// [2] Группы до неё устойчивы целиком. Находим границу записи не ближе buffer_size байт
+//     к концу найденной и идём от неё по цепочке записей до первой нецелой.
+// [3] За восстановленным концом могут остаться целые записи недописанной группы после "дыры".
+//     Следующие buffer_size байт файла стираются, чтобы они не попали в журнал при следующем восстановлении.
+
+// Копирует len байт журнала начиная с lsn из отображения файла (с учётом стыка).
+void ring_log_copy_out(const RING_LOG* log, const uint8_t* file, uint64_t lsn, void* data, uint32_t len)
+{
+    uint64_t offset = lsn % log->file_size;
+    uint64_t first = (len < log->file_size - offset)? len : log->file_size - offset;
+
+    memcpy(data, file + offset, first);
+    memcpy((uint8_t*) data + first, file, len - first);
+}
+
+// Проверяет, что по lsn лежит целая запись этого круга, и возвращает LSN её конца.
+bool ring_log_check_record(const RING_LOG* log, const uint8_t* file, uint64_t lsn, uint64_t* end)
+{
+    RING_LOG_HEADER header;
+    ring_log_copy_out(log, file, lsn, &header, RING_LOG_HEADER_SIZE);
+
+    if (header.lsn != lsn || header.len > log->buffer_size - RING_LOG_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    // Данные могут пересекать стык файла.
+    uint64_t offset = (lsn + RING_LOG_HEADER_SIZE) % log->file_size;
+    uint64_t first = (header.len < log->file_size - offset)? header.len : log->file_size - offset;
+
+    uint32_t crc = ring_log_crc_data(header.len, file + offset, first);
+    crc = ring_log_crc32c(crc, file, header.len - first);
+
+    if (ring_log_crc_finish(crc, lsn) != header.crc)
+    {
+        return false;
+    }
+
+    *end = lsn + ring_log_footprint(header.len);
+    return true;
+}
+
+uint64_t ring_log_recover(const RING_LOG* log)
+{
+    const uint8_t* file = mmap(NULL, log->file_size, PROT_READ, MAP_SHARED, log->fd, 0);
+    if (file == MAP_FAILED)
+    {
+        fprintf(stderr, "ring_log_open: unable to map log file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // [1] Ищем запись с наибольшим LSN конца.
+    uint64_t last_end = 0U;
+    for (uint64_t offset = 0U; offset < log->file_size; offset += RING_LOG_ALIGN)
+    {
+        RING_LOG_HEADER header;
+        ring_log_copy_out(log, file, offset, &header, RING_LOG_HEADER_SIZE);
+
+        uint64_t end;
+        if (header.lsn % log->file_size == offset &&
+            ring_log_check_record(log, file, header.lsn, &end) && end > last_end)
+        {
+            last_end = end;
+        }
+    }
+
+    // [2] Ищем границу записи в устойчивой части журнала.
+    uint64_t tail = 0U;
+    if (last_end > log->buffer_size)
+    {
+        uint64_t limit = (last_end - log->buffer_size) & ~((uint64_t) RING_LOG_ALIGN - 1U);
+
+        // Запись не длиннее буфера, поэтому граница находится не далее buffer_size байт.
+        bool found = false;
+        for (uint64_t back = 0U; back <= log->buffer_size && back <= limit && !found; back += RING_LOG_ALIGN)
+        {
+            uint64_t end;
+            tail = limit - back;
+            found = ring_log_check_record(log, file, tail, &end);
+        }
+
+        if (!found)
+        {
+            fprintf(stderr, "ring_log_open: log file is corrupted\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Идём по цепочке целых записей.
+    uint64_t end;
+    while (ring_log_check_record(log, file, tail, &end))
+    {
+        tail = end;
+    }
+
+    munmap((void*) file, log->file_size);
+
+    return tail;
+}
+
+//---------------------
+// Открытие и закрытие
+//---------------------
+
+// Создаёт журнал или открывает существующий, восстанавливая его конец.
+void ring_log_open(RING_LOG* log, const char* path, uint64_t file_size, uint32_t buffer_size)
+{
+    if (buffer_size < RING_LOG_HEADER_SIZE || ((buffer_size - 1) & buffer_size) != 0 || file_size < 2ULL * buffer_size)
+    {
+        printf("ring_log_open: buffer size (%u) is expected to be power of two not exceeding half of file size\n", buffer_size);
+        exit(EXIT_FAILURE);
+    }
+
+    if (file_size % RING_LOG_ALIGN != 0U)
+    {
+        printf("ring_log_open: file size (%lu) is expected to be multiple of %u\n", file_size, RING_LOG_ALIGN);
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_once(&ring_log_crc32c_once, ring_log_crc32c_init);
+
+    log->fd = open(path, O_CREAT|O_RDWR|O_CLOEXEC, 0600);
+    if (log->fd == -1)
+    {
+        fprintf(stderr, "ring_log_open: unable to open '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat file_stat;
+    if (fstat(log->fd, &file_stat) == -1)
+    {
+        fprintf(stderr, "ring_log_open: unable to stat '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (file_stat.st_size != 0 && (uint64_t) file_stat.st_size != file_size)
+    {
+        fprintf(stderr, "ring_log_open: '%s' has size %ld, expected %lu\n", path, file_stat.st_size, file_size);
+        exit(EXIT_FAILURE);
+    }
+
+    log->buffer = (uint8_t*) aligned_alloc(RING_LOG_HEADER_SIZE, buffer_size);
+    if (log->buffer == NULL)
+    {
+        printf("ring_log_open: buffer size (%u) is too big\n", buffer_size);
+        exit(EXIT_FAILURE);
+    }
+
+    log->file_size = file_size;
+    log->buffer_size = buffer_size;
+
+    // Нулевой буфер служит источником для заполнения файла нулями.
+    memset(log->buffer, 0, buffer_size);
+
+    uint64_t tail = 0U;
+    if (file_stat.st_size == 0)
+    {
+        // Новый файл заполняется нулями целиком. posix_fallocate() оставил бы экстенты
+        // в состоянии "не записан", и первые fdatasync() каждого круга дополнительно
+        // фиксировали бы их преобразование в метаданных ФС.
+        ring_log_write_range(log, 0U, file_size);
+    }
+    else
+    {
+        tail = ring_log_recover(log);
+
+        // [3] Стираем возможные остатки недописанной группы.
+        ring_log_write_range(log, tail, tail + buffer_size);
+    }
+
+    if (fdatasync(log->fd) == -1)
+    {
+        fprintf(stderr, "ring_log_open: unable to fdatasync log file: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&log->mutex, NULL);
+    pthread_cond_init(&log->flush_needed, NULL);
+    pthread_cond_init(&log->durable, NULL);
+
+    log->appended_lsn = tail;
+    log->durable_lsn = tail;
+    log->num_groups = 0U;
+    log->closed = false;
+
+    int ret = pthread_create(&log->flusher, NULL, ring_log_flusher, log);
+    if (ret != 0)
+    {
+        fprintf(stderr, "ring_log_open: unable to create flusher thread\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Сбрасывает оставшиеся записи и закрывает журнал.
+void ring_log_close(RING_LOG* log)
+{
+    pthread_mutex_lock(&log->mutex);
+    log->closed = true;
+    pthread_cond_signal(&log->flush_needed);
+    pthread_mutex_unlock(&log->mutex);
+
+    pthread_join(log->flusher, NULL);
+
+    pthread_cond_destroy(&log->durable);
+    pthread_cond_destroy(&log->flush_needed);
+    pthread_mutex_destroy(&log->mutex);
+
+    free(log->buffer);
+    close(log->fd);
+}
+
+//--------------------
+// Операции писателей
+//--------------------
+
+// Копирует len байт в буфер журнала начиная с lsn (с учётом стыка).
+void ring_log_copy_in(RING_LOG* log, uint64_t lsn, const void* data, uint32_t len)
+{
+    uint32_t offset = lsn & (log->buffer_size - 1U);
+    uint32_t first = (len < log->buffer_size - offset)? len : log->buffer_size - offset;
+
+    memcpy(log->buffer + offset, data, first);
+    memcpy(log->buffer, (const uint8_t*) data + first, len - first);
+}
+
+// Дописывает запись и возвращает LSN её конца - аргумент для ring_log_wait_durable().
+uint64_t ring_log_append(RING_LOG* log, const void* record, uint32_t len)
+{
+    if (len > log->buffer_size - RING_LOG_HEADER_SIZE)
+    {
+        printf("ring_log_append: record (%u bytes) is larger than buffer\n", len);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t footprint = ring_log_footprint(len);
+    uint32_t crc = ring_log_crc_data(len, record, len);
+
+    pthread_mutex_lock(&log->mutex);
+
+    // Ждём, пока сбрасыватель освободит место в буфере.
+    while (log->appended_lsn + footprint - log->durable_lsn > log->buffer_size)
+    {
+        pthread_cond_wait(&log->durable, &log->mutex);
+    }
+
+    uint64_t lsn = log->appended_lsn;
+    RING_LOG_HEADER header = {.lsn = lsn, .len = len, .crc = ring_log_crc_finish(crc, lsn)};
+    ring_log_copy_in(log, lsn, &header, RING_LOG_HEADER_SIZE);
+    ring_log_copy_in(log, lsn + RING_LOG_HEADER_SIZE, record, len);
+
+    log->appended_lsn = lsn + footprint;
+    pthread_cond_signal(&log->flush_needed);
+
+    pthread_mutex_unlock(&log->mutex);
+
+    return lsn + footprint;
+}
+
+// Ждёт, пока все записи до lsn не станут устойчивыми.
+void ring_log_wait_durable(RING_LOG* log, uint64_t lsn)
+{
+    pthread_mutex_lock(&log->mutex);
+
+    while (log->durable_lsn < lsn)
+    {
+        pthread_cond_wait(&log->durable, &log->mutex);
+    }
+
+    pthread_mutex_unlock(&log->mutex);
+}
+
+// Дописывает запись и ждёт её устойчивости.
+uint64_t ring_log_commit(RING_LOG* log, const void* record, uint32_t len)
+{
+    uint64_t lsn = ring_log_append(log, record, len);
+    ring_log_wait_durable(log, lsn);
+    return lsn;
+}
+
+#endif // MSUSEM_RING_LOG
@@ -0,0 +1,646 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <unistd.h>
+#include <sys/msg.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <sched.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+// Размеры сообщений.
+const uint32_t MSG_SIZES[] = {8U, 64U, 512U, 4096U, 16384U, 65536U};
+
+#define NUM_MSG_SIZES (sizeof(MSG_SIZES) / sizeof(MSG_SIZES[0]))
+#define MAX_MSG_SIZE  65536U
+
+// Объём данных для замера пропускной способности и ограничение на число сообщений.
+#define NUM_BYTES    (256ULL << 20U)
+#define MAX_MESSAGES 1000000ULL
+
+// Количество обменов для замера задержки.
+#define NUM_ROUNDS 10000U
+
+// Объём разделяемой памяти под одну межпроцессную очередь.
+#define SHM_QUEUE_BYTES (4U << 20U)
+#define SHM_QUEUE_SLOTS 1024U
+
+#define CACHE_LINE_SIZE 256
+
+#define NUM_RETRIES 10U
+
+// Время ожидания подключения другой стороны.
+#define SHM_ATTACH_TIMEOUT_NS 5000000000ULL
+
+#include "shm-queue.h"
+
+uint64_t time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//=========================
+// Каналы между процессами
+//=========================
+// Канал передаёт сообщения фиксированного размера в обе стороны между родителем (side 0)
+// и дочерним процессом (side 1), созданным через fork() после setup().
+
+typedef struct {
+    // Сторона канала: 0 - родитель, 1 - дочерний процесс.
+    int side;
+    uint32_t msg_size;
+
+    // pipe: fds[0] - родитель -> потомок, fds[1] - потомок -> родитель.
+    int fds[2][2];
+    // socketpair(AF_UNIX).
+    int sv[2];
+    // POSIX mq: mq[0] - родитель -> потомок, mq[1] - потомок -> родитель.
+    mqd_t mq[2];
+    char mq_names[2][32];
+    // SysV: тип сообщения равен 1 + номер стороны получателя.
+    int msqid;
+    // Межпроцессная очередь: shm[0] - родитель -> потомок, shm[1] - потомок -> родитель.
+    SHM_QUEUE shm[2];
+    // Имена сегментов shm_open(); пустые строки - сегменты memfd.
+    char shm_names[2][32];
+} CHANNEL;
+
+typedef struct {
+    const char* name;
+    // Возвращает false, если транспорт не поддерживает сообщения такого размера.
+    bool (*setup)(CHANNEL* ch);
+    // Вызывается каждой стороной после fork().
+    void (*attach)(CHANNEL* ch);
+    void (*send)(CHANNEL* ch, const void* msg);
+    void (*recv)(CHANNEL* ch, void* msg);
+    void (*teardown)(CHANNEL* ch);
+} TRANSPORT;
+
+void write_all(int fd, const void* buf, size_t len)
+{
+    while (len != 0U)
+    {
+        ssize_t ret = write(fd, buf, len);
+        if (ret == -1)
+        {
+            fprintf(stderr, "Unable to write: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        buf = (const uint8_t*) buf + ret;
+        len -= ret;
+    }
+}
+
+void read_all(int fd, void* buf, size_t len)
+{
+    while (len != 0U)
+    {
+        ssize_t ret = read(fd, buf, len);
+        if (ret <= 0)
+        {
+            fprintf(stderr, "Unable to read: %s\n", (ret == 0)? "unexpected EOF" : strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        buf = (uint8_t*) buf + ret;
+        len -= ret;
+    }
+}
+
+//------
+// pipe
+//------
+
+bool pipe_setup(CHANNEL* ch)
+{
+    if (pipe(ch->fds[0]) == -1 || pipe(ch->fds[1]) == -1)
+    {
+        fprintf(stderr, "Unable to create pipe\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return true;
+}
+
+void pipe_attach(CHANNEL* ch)
+{
+    // Закрываем неиспользуемые концы, чтобы смерть другой стороны давала EOF.
+    close(ch->fds[ch->side][0]);
+    close(ch->fds[1 - ch->side][1]);
+}
+
+void pipe_send(CHANNEL* ch, const void* msg)
+{
+    write_all(ch->fds[ch->side][1], msg, ch->msg_size);
+}
+
+void pipe_recv(CHANNEL* ch, void* msg)
+{
+    read_all(ch->fds[1 - ch->side][0], msg, ch->msg_size);
+}
+
+void pipe_teardown(CHANNEL* ch)
+{
+    close(ch->fds[0][1]);
+    close(ch->fds[1][0]);
+}
+
+//------------
+// socketpair
+//------------
+
+bool socket_setup(CHANNEL* ch)
+{
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, ch->sv) == -1)
+    {
+        fprintf(stderr, "Unable to create socketpair\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return true;
+}
+
+void socket_attach(CHANNEL* ch)
+{
+    close(ch->sv[1 - ch->side]);
+}
+
+void socket_send(CHANNEL* ch, const void* msg)
+{
+    write_all(ch->sv[ch->side], msg, ch->msg_size);
+}
+
+void socket_recv(CHANNEL* ch, void* msg)
+{
+    read_all(ch->sv[ch->side], msg, ch->msg_size);
+}
+
+void socket_teardown(CHANNEL* ch)
+{
+    close(ch->sv[0]);
+}
+
+//----------
+// POSIX mq
+//----------
+
+bool mq_setup(CHANNEL* ch)
+{
+    struct mq_attr attr = {.mq_maxmsg = 10, .mq_msgsize = ch->msg_size};
+
+    for (int i = 0; i < 2; ++i)
+    {
+        snprintf(ch->mq_names[i], sizeof(ch->mq_names[i]), "/shm-queue-bench-%d-%d", getpid(), i);
+
+        ch->mq[i] = mq_open(ch->mq_names[i], O_CREAT|O_EXCL|O_RDWR, 0600, &attr);
+        if (ch->mq[i] == (mqd_t) -1)
+        {
+            // Размер сообщения превышает /proc/sys/fs/mqueue/msgsize_max или mqueue недоступна.
+            if (i == 1)
+            {
+                mq_close(ch->mq[0]);
+                mq_unlink(ch->mq_names[0]);
+            }
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void mq_attach(CHANNEL* ch)
+{
+    (void) ch;
+}
+
+void mq_send_msg(CHANNEL* ch, const void* msg)
+{
+    if (mq_send(ch->mq[ch->side], msg, ch->msg_size, 0) == -1)
+    {
+        fprintf(stderr, "Unable to call mq_send: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void mq_recv_msg(CHANNEL* ch, void* msg)
+{
+    if (mq_receive(ch->mq[1 - ch->side], msg, ch->msg_size, NULL) != (ssize_t) ch->msg_size)
+    {
+        fprintf(stderr, "Unable to call mq_receive: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void mq_teardown(CHANNEL* ch)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        mq_close(ch->mq[i]);
+        mq_unlink(ch->mq_names[i]);
+    }
+}
+
+//----------
+// SysV msg
+//----------
+
+typedef struct {
+    long mtype;
+    uint8_t mtext[MAX_MSG_SIZE];
+} SYSV_MSG;
+
+bool sysv_setup(CHANNEL* ch)
+{
+    ch->msqid = msgget(IPC_PRIVATE, IPC_CREAT|0600);
+    if (ch->msqid == -1)
+    {
+        return false;
+    }
+
+    // Размер сообщения ограничен /proc/sys/kernel/msgmax: проверяем пробной отправкой.
+    static SYSV_MSG probe;
+    probe.mtype = 1;
+    if (msgsnd(ch->msqid, &probe, ch->msg_size, IPC_NOWAIT) == -1 ||
+        msgrcv(ch->msqid, &probe, ch->msg_size, 1, IPC_NOWAIT) == -1)
+    {
+        msgctl(ch->msqid, IPC_RMID, NULL);
+        return false;
+    }
+
+    return true;
+}
+
+void sysv_attach(CHANNEL* ch)
+{
+    (void) ch;
+}
+
+void sysv_send(CHANNEL* ch, const void* msg)
+{
+    static SYSV_MSG buf;
+    buf.mtype = 1 + (1 - ch->side);
+    memcpy(buf.mtext, msg, ch->msg_size);
+
+    if (msgsnd(ch->msqid, &buf, ch->msg_size, 0) == -1)
+    {
+        fprintf(stderr, "Unable to call msgsnd: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void sysv_recv(CHANNEL* ch, void* msg)
+{
+    static SYSV_MSG buf;
+    if (msgrcv(ch->msqid, &buf, ch->msg_size, 1 + ch->side, 0) != (ssize_t) ch->msg_size)
+    {
+        fprintf(stderr, "Unable to call msgrcv: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(msg, buf.mtext, ch->msg_size);
+}
+
+void sysv_teardown(CHANNEL* ch)
+{
+    msgctl(ch->msqid, IPC_RMID, NULL);
+}
+
+//-----------------------------
+// Межпроцессная очередь (shm)
+//-----------------------------
+
+bool shm_setup(CHANNEL* ch)
+{
+    // Число слотов - наибольшая степень двойки, при которой очередь укладывается в SHM_QUEUE_BYTES.
+    uint32_t slots = SHM_QUEUE_SLOTS;
+    while (slots > 2U && (uint64_t) slots * shm_queue_slot_size(ch->msg_size) > SHM_QUEUE_BYTES)
+    {
+        slots /= 2U;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        shm_queue_create(&ch->shm[i], (ch->shm_names[i][0] != '\0')? ch->shm_names[i] : NULL, slots, ch->msg_size);
+    }
+
+    return true;
+}
+
+// Сегменты с именами shm_open(): создатель и участник находят их по имени, а не по дескриптору.
+bool shm_named_setup(CHANNEL* ch)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        snprintf(ch->shm_names[i], sizeof(ch->shm_names[i]), "/shm-queue-bench-%d-%d", getpid(), i);
+    }
+
+    return shm_setup(ch);
+}
+
+// Занимает роли в обеих очередях и дожидается другой стороны.
+void shm_attach_roles(CHANNEL* ch)
+{
+    // Сторона side пишет в shm[side] и читает из shm[1 - side].
+    if (!shm_queue_attach(&ch->shm[ch->side], SHM_QUEUE_PRODUCER) ||
+        !shm_queue_attach(&ch->shm[1 - ch->side], SHM_QUEUE_CONSUMER))
+    {
+        fprintf(stderr, "Unable to attach to shared queue\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Завершаем рукопожатие: ждём, пока другая сторона займёт свои роли.
+    uint64_t deadline = time_ns() + SHM_ATTACH_TIMEOUT_NS;
+    while (!shm_queue_peer_alive(&ch->shm[0]) || !shm_queue_peer_alive(&ch->shm[1]))
+    {
+        if (time_ns() > deadline)
+        {
+            fprintf(stderr, "Shared queue peer did not attach\n");
+            exit(EXIT_FAILURE);
+        }
+
+        sched_yield();
+    }
+}
+
+void shm_attach(CHANNEL* ch)
+{
+    // Каждая сторона отображает сегменты заново, по своим адресам.
+    for (int i = 0; i < 2; ++i)
+    {
+        int fd = ch->shm[i].fd;
+        munmap(ch->shm[i].header, ch->shm[i].map_size);
+
+        if (!shm_queue_open(&ch->shm[i], fd))
+        {
+            fprintf(stderr, "Unable to open shared queue\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    shm_attach_roles(ch);
+}
+
+void shm_named_attach(CHANNEL* ch)
+{
+    // Унаследованные отображение и дескриптор не используются: сегмент открывается по имени.
+    for (int i = 0; i < 2; ++i)
+    {
+        munmap(ch->shm[i].header, ch->shm[i].map_size);
+        close(ch->shm[i].fd);
+
+        int fd = shm_open(ch->shm_names[i], O_RDWR, 0);
+        if (fd == -1)
+        {
+            fprintf(stderr, "Unable to call shm_open: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        if (!shm_queue_open(&ch->shm[i], fd))
+        {
+            fprintf(stderr, "Unable to open shared queue\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    shm_attach_roles(ch);
+}
+
+// Ожидание на очереди: периодически уступаем процессор и проверяем, что другая сторона жива.
+void shm_backoff(SHM_QUEUE* queue, uint32_t* retry)
+{
+    (*retry)++;
+
+    if (*retry % NUM_RETRIES == 0U)
+    {
+        sched_yield();
+    }
+
+    if (*retry % (1024U * NUM_RETRIES) == 0U && !shm_queue_peer_alive(queue))
+    {
+        fprintf(stderr, "Shared queue peer is gone\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void shm_send(CHANNEL* ch, const void* msg)
+{
+    uint32_t retry = 0U;
+    while (!shm_queue_enqueue(&ch->shm[ch->side], msg, ch->msg_size))
+    {
+        shm_backoff(&ch->shm[ch->side], &retry);
+    }
+}
+
+void shm_recv(CHANNEL* ch, void* msg)
+{
+    uint32_t len = 0U;
+    uint32_t retry = 0U;
+    while (!shm_queue_dequeue(&ch->shm[1 - ch->side], msg, &len))
+    {
+        shm_backoff(&ch->shm[1 - ch->side], &retry);
+    }
+}
+
+void shm_teardown(CHANNEL* ch)
+{
+    shm_queue_close(&ch->shm[0]);
+    shm_queue_close(&ch->shm[1]);
+}
+
+void shm_named_teardown(CHANNEL* ch)
+{
+    shm_teardown(ch);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        shm_unlink(ch->shm_names[i]);
+    }
+}
+
+const TRANSPORT TRANSPORTS[] = {
+    {"shm-queue",  shm_setup,       shm_attach,       shm_send,    shm_recv,    shm_teardown},
+    {"shm-open",   shm_named_setup, shm_named_attach, shm_send,    shm_recv,    shm_named_teardown},
+    {"pipe",       pipe_setup,      pipe_attach,      pipe_send,   pipe_recv,   pipe_teardown},
+    {"socketpair", socket_setup,    socket_attach,    socket_send, socket_recv, socket_teardown},
+    {"posix-mq",   mq_setup,        mq_attach,        mq_send_msg, mq_recv_msg, mq_teardown},
+    {"sysv-msg",   sysv_setup,      sysv_attach,      sysv_send,   sysv_recv,   sysv_teardown}
+};
+
+#define NUM_TRANSPORTS (sizeof(TRANSPORTS) / sizeof(TRANSPORTS[0]))
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+typedef struct {
+    uint64_t num_messages;
+
+    double msgs_per_sec;
+    double latency_p50_us;
+    double latency_p99_us;
+} RESULT;
+
+int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+// Дочерний процесс: принимает поток сообщений, подтверждает его и отражает сообщения обратно.
+void run_child(const TRANSPORT* transport, CHANNEL* ch, uint8_t* msg, uint64_t num_messages)
+{
+    for (uint64_t rcv_i = 0U; rcv_i < num_messages; ++rcv_i)
+    {
+        transport->recv(ch, msg);
+
+        // Compare result:
+        uint64_t snd_i;
+        memcpy(&snd_i, msg, sizeof(snd_i));
+        if (snd_i != rcv_i)
+        {
+            fprintf(stderr, "Invalid message: expected %lu, got %lu\n", rcv_i, snd_i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    transport->send(ch, msg);
+
+    for (uint32_t round = 0U; round < NUM_ROUNDS; ++round)
+    {
+        transport->recv(ch, msg);
+        transport->send(ch, msg);
+    }
+}
+
+// Родительский процесс: отправляет поток сообщений и измеряет время обменов.
+void run_parent(const TRANSPORT* transport, CHANNEL* ch, uint8_t* msg, RESULT* result)
+{
+    uint64_t start = time_ns();
+
+    for (uint64_t snd_i = 0U; snd_i < result->num_messages; ++snd_i)
+    {
+        memcpy(msg, &snd_i, sizeof(snd_i));
+        transport->send(ch, msg);
+    }
+
+    // Ждём подтверждения приёма всего потока.
+    transport->recv(ch, msg);
+
+    result->msgs_per_sec = 1e9 * result->num_messages / (time_ns() - start);
+
+    static uint64_t rtt[NUM_ROUNDS];
+    for (uint32_t round = 0U; round < NUM_ROUNDS; ++round)
+    {
+        uint64_t sent = time_ns();
+        transport->send(ch, msg);
+        transport->recv(ch, msg);
+        rtt[round] = time_ns() - sent;
+    }
+
+    // Задержка в одну сторону - половина времени обмена.
+    qsort(rtt, NUM_ROUNDS, sizeof(uint64_t), compare_u64);
+    result->latency_p50_us = rtt[NUM_ROUNDS / 2U] / 2e3;
+    result->latency_p99_us = rtt[NUM_ROUNDS * 99U / 100U] / 2e3;
+}
+
+bool run_bench(const TRANSPORT* transport, uint32_t msg_size, RESULT* result)
+{
+    CHANNEL ch;
+    memset(&ch, 0, sizeof(ch));
+    ch.msg_size = msg_size;
+
+    if (!transport->setup(&ch))
+    {
+        return false;
+    }
+
+    uint8_t* msg = (uint8_t*) calloc(1U, msg_size);
+    if (msg == NULL)
+    {
+        fprintf(stderr, "Unable to allocate message buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    result->num_messages = NUM_BYTES / msg_size;
+    if (result->num_messages > MAX_MESSAGES)
+    {
+        result->num_messages = MAX_MESSAGES;
+    }
+
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        fprintf(stderr, "Unable to fork\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0)
+    {
+        ch.side = 1;
+        transport->attach(&ch);
+        run_child(transport, &ch, msg, result->num_messages);
+        _exit(EXIT_SUCCESS);
+    }
+
+    ch.side = 0;
+    transport->attach(&ch);
+    run_parent(transport, &ch, msg, result);
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Child process of %s failed\n", transport->name);
+        exit(EXIT_FAILURE);
+    }
+
+    transport->teardown(&ch);
+    free(msg);
+
+    return true;
+}
+
+int main()
+{
+    printf("%-10s %8s %14s %12s %12s\n", "Transport", "Size", "Msgs/s", "Lat p50 us", "Lat p99 us");
+
+    for (size_t s = 0U; s < NUM_MSG_SIZES; ++s)
+    {
+        uint32_t msg_size = MSG_SIZES[s];
+        for (size_t t = 0U; t < NUM_TRANSPORTS; ++t)
+        {
+            RESULT result;
+            if (!run_bench(&TRANSPORTS[t], msg_size, &result))
+            {
+                printf("%-10s %8u %14s %12s %12s\n", TRANSPORTS[t].name, msg_size, "n/a", "n/a", "n/a");
+                continue;
+            }
+
+            printf("%-10s %8u %14.0f %12.2f %12.2f\n", TRANSPORTS[t].name, msg_size,
+                result.msgs_per_sec, result.latency_p50_us, result.latency_p99_us);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
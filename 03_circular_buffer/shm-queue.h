@@ -0,0 +1,327 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_SHM_QUEUE
+#define MSUSEM_SHM_QUEUE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdatomic.h>
+
+//---------------------------------
+// Межпроцессная кольцевая очередь
+//---------------------------------
+// Очередь с одним писателем и одним читателем (SPSC) в разделяемой памяти (memfd или shm_open).
+// Разделяемый сегмент начинается с заголовка SHM_QUEUE_HEADER, за которым по смещению data_offset
+// лежат слоты. Сегмент не содержит указателей, поэтому процессы могут отображать его по разным адресам.
+// Кешированные индексы и геометрия очереди хранятся в локальном для процесса описателе SHM_QUEUE:
+// геометрия проверяется один раз при открытии, и другой процесс не может изменить её позже.
+//
+// Порядок работы:
+// - создатель вызывает shm_queue_create(): сегмент инициализируется, последним публикуется magic;
+// - участники вызывают shm_queue_open() на дескрипторе сегмента и shm_queue_attach() со своей ролью;
+// - по завершении участник вызывает shm_queue_close(), освобождая роль.
+// Роль, занятая завершившимся процессом, может быть перехвачена: незавершённый им элемент
+// не был опубликован и будет перезаписан новым участником.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+#define SHM_QUEUE_MAGIC   0x51554555U
+#define SHM_QUEUE_VERSION 1U
+
+// Заголовок слота хранит длину сообщения и выравнивает данные.
+#define SHM_SLOT_HEADER_SIZE 8U
+
+typedef enum {
+    SHM_QUEUE_PRODUCER = 0,
+    SHM_QUEUE_CONSUMER = 1,
+    SHM_QUEUE_NONE     = 2
+} SHM_QUEUE_ROLE;
+
+typedef struct {
+    // Публикуется последним: ненулевое значение означает завершённую инициализацию.
+    _Atomic uint32_t magic;
+    uint32_t version;
+
+    // Количество слотов и размер слота (вместе с заголовком).
+    uint32_t size;
+    uint32_t slot_size;
+
+    // Смещение массива слотов от начала сегмента.
+    uint64_t data_offset;
+
+    // Идентификаторы процессов, занявших роли писателя и читателя (0 - роль свободна).
+    _Atomic pid_t owners[2];
+
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;
+} SHM_QUEUE_HEADER;
+
+typedef struct {
+    SHM_QUEUE_HEADER* header;
+    uint8_t* data;
+    size_t map_size;
+    int fd;
+
+    // Копия геометрии из заголовка, проверенная при открытии.
+    uint32_t size;
+    uint32_t slot_size;
+
+    SHM_QUEUE_ROLE role;
+    uint32_t cached_head;
+    uint32_t cached_tail;
+} SHM_QUEUE;
+
+// Размер слота с заголовком, кратный размеру заголовка.
+uint32_t shm_queue_slot_size(uint32_t msg_size)
+{
+    return SHM_SLOT_HEADER_SIZE + ((msg_size + SHM_SLOT_HEADER_SIZE - 1U) & ~(SHM_SLOT_HEADER_SIZE - 1U));
+}
+
+void shm_queue_map(SHM_QUEUE* queue, int fd, size_t map_size)
+{
+    void* mapping = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "shm_queue: unable to mmap shared segment\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue->header = (SHM_QUEUE_HEADER*) mapping;
+    queue->map_size = map_size;
+    queue->fd = fd;
+    queue->role = SHM_QUEUE_NONE;
+    queue->cached_head = 0U;
+    queue->cached_tail = 0U;
+    queue->data = NULL;
+    queue->size = 0U;
+    queue->slot_size = 0U;
+}
+
+// Создаёт и инициализирует очередь из size слотов для сообщений до msg_size байт.
+// При name == NULL сегмент создаётся через memfd_create() и передаётся другим процессам
+// наследованием или через SCM_RIGHTS, иначе - через shm_open(name).
+void shm_queue_create(SHM_QUEUE* queue, const char* name, uint32_t size, uint32_t msg_size)
+{
+    if (size == 0 || ((size - 1) & size) != 0)
+    {
+        printf("shm_queue_create: size (%u) is expected to be power of two\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    int fd = (name == NULL)?
+        memfd_create("shm-queue", MFD_CLOEXEC) :
+        shm_open(name, O_CREAT|O_EXCL|O_RDWR, 0600);
+    if (fd == -1)
+    {
+        fprintf(stderr, "shm_queue_create: unable to create shared segment: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t data_offset = (sizeof(SHM_QUEUE_HEADER) + CACHE_LINE_SIZE - 1U) & ~(CACHE_LINE_SIZE - 1ULL);
+    uint32_t slot_size = shm_queue_slot_size(msg_size);
+    size_t map_size = data_offset + (size_t) size * slot_size;
+
+    if (ftruncate(fd, map_size) == -1)
+    {
+        fprintf(stderr, "shm_queue_create: unable to resize shared segment: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    shm_queue_map(queue, fd, map_size);
+
+    SHM_QUEUE_HEADER* header = queue->header;
+    header->version = SHM_QUEUE_VERSION;
+    header->size = size;
+    header->slot_size = slot_size;
+    header->data_offset = data_offset;
+    atomic_init(&header->owners[SHM_QUEUE_PRODUCER], 0);
+    atomic_init(&header->owners[SHM_QUEUE_CONSUMER], 0);
+    atomic_init(&header->head, 0U);
+    atomic_init(&header->tail, 0U);
+
+    queue->data = (uint8_t*) header + data_offset;
+    queue->size = size;
+    queue->slot_size = slot_size;
+
+    // Публикуем инициализированный заголовок.
+    atomic_store_explicit(&header->magic, SHM_QUEUE_MAGIC, memory_order_release);
+}
+
+// Отображает существующий сегмент.
+// Возвращает false, если создатель ещё не завершил инициализацию.
+bool shm_queue_open(SHM_QUEUE* queue, int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(SHM_QUEUE_HEADER))
+    {
+        return false;
+    }
+
+    shm_queue_map(queue, fd, st.st_size);
+
+    SHM_QUEUE_HEADER* header = queue->header;
+    if (atomic_load_explicit(&header->magic, memory_order_acquire) != SHM_QUEUE_MAGIC)
+    {
+        munmap(header, queue->map_size);
+        return false;
+    }
+
+    // Копируем геометрию один раз: дальше используется только проверенная копия.
+    uint32_t version = header->version;
+    uint32_t size = header->size;
+    uint32_t slot_size = header->slot_size;
+    uint64_t data_offset = header->data_offset;
+
+    if (version != SHM_QUEUE_VERSION ||
+        size == 0U || ((size - 1U) & size) != 0U ||
+        slot_size < SHM_SLOT_HEADER_SIZE || slot_size % SHM_SLOT_HEADER_SIZE != 0U ||
+        data_offset < sizeof(SHM_QUEUE_HEADER) || data_offset % SHM_SLOT_HEADER_SIZE != 0U ||
+        data_offset > queue->map_size ||
+        (uint64_t) size * slot_size > queue->map_size - data_offset)
+    {
+        fprintf(stderr, "shm_queue_open: incompatible shared segment\n");
+        exit(EXIT_FAILURE);
+    }
+
+    queue->data = (uint8_t*) header + data_offset;
+    queue->size = size;
+    queue->slot_size = slot_size;
+    return true;
+}
+
+bool shm_queue_pid_alive(pid_t pid)
+{
+    return pid != 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+// Занимает роль писателя или читателя.
+// Возвращает false, если роль занята живым процессом.
+bool shm_queue_attach(SHM_QUEUE* queue, SHM_QUEUE_ROLE role)
+{
+    _Atomic pid_t* owner = &queue->header->owners[role];
+    pid_t self = getpid();
+
+    pid_t prev = 0;
+    while (!atomic_compare_exchange_strong_explicit(owner, &prev, self,
+                memory_order_acq_rel, memory_order_acquire))
+    {
+        if (shm_queue_pid_alive(prev))
+        {
+            return false;
+        }
+
+        // Роль занята завершившимся процессом: пытаемся её перехватить.
+    }
+
+    queue->role = role;
+    queue->cached_head = atomic_load_explicit(&queue->header->head, memory_order_acquire);
+    queue->cached_tail = atomic_load_explicit(&queue->header->tail, memory_order_acquire);
+
+    return true;
+}
+
+void shm_queue_detach(SHM_QUEUE* queue)
+{
+    if (queue->role != SHM_QUEUE_NONE)
+    {
+        atomic_store_explicit(&queue->header->owners[queue->role], 0, memory_order_release);
+        queue->role = SHM_QUEUE_NONE;
+    }
+}
+
+// Проверяет, что противоположная роль занята живым процессом.
+bool shm_queue_peer_alive(const SHM_QUEUE* queue)
+{
+    SHM_QUEUE_ROLE peer = (queue->role == SHM_QUEUE_PRODUCER)? SHM_QUEUE_CONSUMER : SHM_QUEUE_PRODUCER;
+    return shm_queue_pid_alive(atomic_load_explicit(&queue->header->owners[peer], memory_order_acquire));
+}
+
+void shm_queue_close(SHM_QUEUE* queue)
+{
+    shm_queue_detach(queue);
+    munmap(queue->header, queue->map_size);
+    close(queue->fd);
+}
+
+//-----------------------
+// Операции над очередью
+//-----------------------
+
+bool shm_queue_enqueue(SHM_QUEUE* queue, const void* msg, uint32_t len)
+{
+    SHM_QUEUE_HEADER* header = queue->header;
+
+    // Сообщение обязано помещаться в слот: false означает только переполнение очереди.
+    if (len > queue->slot_size - SHM_SLOT_HEADER_SIZE)
+    {
+        fprintf(stderr, "shm_queue_enqueue: message length %u exceeds slot capacity (%u)\n",
+            len, queue->slot_size - SHM_SLOT_HEADER_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t tail = atomic_load_explicit(&header->tail, memory_order_relaxed);
+
+    if (tail - queue->cached_head == queue->size)
+    {
+        queue->cached_head = atomic_load_explicit(&header->head, memory_order_acquire);
+
+        if (tail - queue->cached_head == queue->size)
+        {
+            return false;
+        }
+    }
+
+    uint8_t* slot = queue->data + (size_t) (tail & (queue->size - 1U)) * queue->slot_size;
+    *(uint32_t*) slot = len;
+    memcpy(slot + SHM_SLOT_HEADER_SIZE, msg, len);
+
+    atomic_store_explicit(&header->tail, tail + 1U, memory_order_release);
+
+    return true;
+}
+
+// Копирует сообщение в msg (не менее queue->slot_size - SHM_SLOT_HEADER_SIZE байт) и записывает его длину в len.
+bool shm_queue_dequeue(SHM_QUEUE* queue, void* msg, uint32_t* len)
+{
+    SHM_QUEUE_HEADER* header = queue->header;
+    uint32_t head = atomic_load_explicit(&header->head, memory_order_relaxed);
+
+    if (queue->cached_tail == head)
+    {
+        queue->cached_tail = atomic_load_explicit(&header->tail, memory_order_acquire);
+
+        if (queue->cached_tail == head)
+        {
+            return false;
+        }
+    }
+
+    const uint8_t* slot = queue->data + (size_t) (head & (queue->size - 1U)) * queue->slot_size;
+    *len = *(const uint32_t*) slot;
+
+    // Длина приходит из памяти другого процесса: не доверяем ей.
+    if (*len > queue->slot_size - SHM_SLOT_HEADER_SIZE)
+    {
+        fprintf(stderr, "shm_queue_dequeue: corrupted message length (%u)\n", *len);
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(msg, slot + SHM_SLOT_HEADER_SIZE, *len);
+
+    atomic_store_explicit(&header->head, head + 1U, memory_order_release);
+
+    return true;
+}
+
+#endif // MSUSEM_SHM_QUEUE
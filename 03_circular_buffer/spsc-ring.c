@@ -0,0 +1,324 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define QUEUE_SIZE     1024U
+#define NUM_ITERATIONS 100000000ULL
+
+// Крупные элементы: блоки по BLOCK_SIZE байт.
+#define BLOCK_SIZE           256U
+#define BLOCK_QUEUE_SIZE     64U
+#define NUM_BLOCK_ITERATIONS 10000000ULL
+
+#define ENABLE_PADDING  1
+#define CACHE_LINE_SIZE 256
+
+#define ENABLE_BACKOFF 1
+#define NUM_RETRIES    10U
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "circular-buffer.h"
+#include "spsc-ring.h"
+
+typedef struct {
+    uint64_t seq;
+    uint8_t payload[BLOCK_SIZE - sizeof(uint64_t)];
+} BLOCK;
+
+DEFINE_SPSC_RING(U64_RING, uint64_t, QUEUE_SIZE)
+DEFINE_SPSC_RING(BLOCK_RING, BLOCK, BLOCK_QUEUE_SIZE)
+
+// Кольца слишком велики для стека.
+QUEUE queue;
+U64_RING u64_ring;
+BLOCK_RING block_ring;
+
+// Ожидание при пустой или полной очереди.
+void backoff(uint32_t* retry)
+{
+    (*retry)++;
+
+    if (ENABLE_BACKOFF && *retry == NUM_RETRIES)
+    {
+        *retry = 0U;
+        sched_yield();
+    }
+}
+
+//---------------------------------------
+// Очередь с размером времени исполнения
+//---------------------------------------
+
+void runtime_producer()
+{
+    for (uint64_t snd_i = 0U; snd_i < NUM_ITERATIONS; ++snd_i)
+    {
+        uint32_t retry = 0U;
+        while (!queue_enqueue(&queue, snd_i))
+        {
+            backoff(&retry);
+        }
+    }
+}
+
+void runtime_consumer()
+{
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_ITERATIONS; ++rcv_i)
+    {
+        uint64_t snd_i = 0U;
+        uint32_t retry = 0U;
+        while (!queue_dequeue(&queue, &snd_i))
+        {
+            backoff(&retry);
+        }
+
+        // Compare result:
+        if (snd_i != rcv_i)
+        {
+            printf("Invalid queue element: expected %lu, got %lu\n", rcv_i, snd_i);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//---------------------------------------
+// Очередь с размером времени компиляции
+//---------------------------------------
+
+void static_producer()
+{
+    for (uint64_t snd_i = 0U; snd_i < NUM_ITERATIONS; ++snd_i)
+    {
+        uint32_t retry = 0U;
+        while (!U64_RING_push(&u64_ring, snd_i))
+        {
+            backoff(&retry);
+        }
+    }
+}
+
+void static_consumer()
+{
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_ITERATIONS; ++rcv_i)
+    {
+        uint64_t snd_i = 0U;
+        uint32_t retry = 0U;
+        while (!U64_RING_pop(&u64_ring, &snd_i))
+        {
+            backoff(&retry);
+        }
+
+        // Compare result:
+        if (snd_i != rcv_i)
+        {
+            printf("Invalid queue element: expected %lu, got %lu\n", rcv_i, snd_i);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//-------------------------------
+// Крупные элементы: копирование
+//-------------------------------
+
+void check_block(const BLOCK* block, uint64_t rcv_i)
+{
+    if (block->seq != rcv_i ||
+        block->payload[0] != (uint8_t) rcv_i ||
+        block->payload[sizeof(block->payload) - 1U] != (uint8_t) rcv_i)
+    {
+        printf("Invalid block: expected %lu, got %lu\n", rcv_i, block->seq);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void copy_producer()
+{
+    BLOCK block;
+
+    for (uint64_t snd_i = 0U; snd_i < NUM_BLOCK_ITERATIONS; ++snd_i)
+    {
+        block.seq = snd_i;
+        memset(block.payload, (uint8_t) snd_i, sizeof(block.payload));
+
+        uint32_t retry = 0U;
+        while (!BLOCK_RING_push(&block_ring, block))
+        {
+            backoff(&retry);
+        }
+    }
+}
+
+void copy_consumer()
+{
+    BLOCK block;
+
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_BLOCK_ITERATIONS; ++rcv_i)
+    {
+        uint32_t retry = 0U;
+        while (!BLOCK_RING_pop(&block_ring, &block))
+        {
+            backoff(&retry);
+        }
+
+        check_block(&block, rcv_i);
+    }
+}
+
+//----------------------------
+// Крупные элементы: на месте
+//----------------------------
+
+void inplace_producer()
+{
+    for (uint64_t snd_i = 0U; snd_i < NUM_BLOCK_ITERATIONS; ++snd_i)
+    {
+        BLOCK* block = NULL;
+        uint32_t retry = 0U;
+        while ((block = BLOCK_RING_begin_push(&block_ring)) == NULL)
+        {
+            backoff(&retry);
+        }
+
+        block->seq = snd_i;
+        memset(block->payload, (uint8_t) snd_i, sizeof(block->payload));
+
+        BLOCK_RING_end_push(&block_ring);
+    }
+}
+
+void inplace_consumer()
+{
+    for (uint64_t rcv_i = 0U; rcv_i < NUM_BLOCK_ITERATIONS; ++rcv_i)
+    {
+        const BLOCK* block = NULL;
+        uint32_t retry = 0U;
+        while ((block = BLOCK_RING_begin_pop(&block_ring)) == NULL)
+        {
+            backoff(&retry);
+        }
+
+        check_block(block, rcv_i);
+
+        BLOCK_RING_end_pop(&block_ring);
+    }
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS 2U
+
+typedef struct {
+    void (*func)();
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+    args->func();
+    return NULL;
+}
+
+// Запускает пару писатель-читатель и возвращает время выполнения в секундах.
+double run_threads(void (*producer)(), void (*consumer)())
+{
+    THREAD_ARGS args[NUM_THREADS] = {{producer}, {consumer}};
+    pthread_t tids[NUM_THREADS];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&tids[i], &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+int main()
+{
+    printf("%-24s %14s\n", "Queue", "Ops/s");
+
+    queue_init(&queue, QUEUE_SIZE);
+    printf("%-24s %14.0f\n", "runtime uint64_t", NUM_ITERATIONS / run_threads(runtime_producer, runtime_consumer));
+    queue_free(&queue);
+
+    U64_RING_init(&u64_ring);
+    printf("%-24s %14.0f\n", "static uint64_t", NUM_ITERATIONS / run_threads(static_producer, static_consumer));
+
+    BLOCK_RING_init(&block_ring);
+    printf("%-24s %14.0f\n", "static block (copy)", NUM_BLOCK_ITERATIONS / run_threads(copy_producer, copy_consumer));
+
+    BLOCK_RING_init(&block_ring);
+    printf("%-24s %14.0f\n", "static block (in place)", NUM_BLOCK_ITERATIONS / run_threads(inplace_producer, inplace_consumer));
+
+    return EXIT_SUCCESS;
+}
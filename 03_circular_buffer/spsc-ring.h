@@ -0,0 +1,129 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_SPSC_RING
+#define MSUSEM_SPSC_RING
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <stdatomic.h>
+
+//-------------------------------------
+// Типизированный кольцевой буфер SPSC
+//-------------------------------------
+// DEFINE_SPSC_RING(name, T, CAPACITY) порождает тип name и встраиваемые функции для очереди
+// элементов типа T с ёмкостью CAPACITY, известной на этапе компиляции:
+// маска индекса - константа, а буфер лежит внутри структуры без косвенного обращения.
+//
+// Копирующий интерфейс:
+//     name_push(ring, elem) / name_pop(ring, &elem)
+// Интерфейс работы на месте (для крупных элементов):
+//     T* slot = name_begin_push(ring); ... заполняем *slot ...; name_end_push(ring);
+//     const T* slot = name_begin_pop(ring); ... читаем *slot ...; name_end_pop(ring);
+//
+// Поля писателя (tail, cached_head) и читателя (head, cached_tail) разнесены по разным кеш-линиям.
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 256
+#endif
+
+#define DEFINE_SPSC_RING(name, T, CAPACITY)                                                        \
+                                                                                                   \
+_Static_assert((CAPACITY) > 0 && ((CAPACITY) & ((CAPACITY) - 1)) == 0,                             \
+    #name ": capacity is expected to be power of two");                                            \
+                                                                                                   \
+typedef struct {                                                                                   \
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;                                               \
+    uint32_t cached_tail;                                                                          \
+                                                                                                   \
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;                                               \
+    uint32_t cached_head;                                                                          \
+                                                                                                   \
+    _Alignas(CACHE_LINE_SIZE) T data[CAPACITY];                                                    \
+} name;                                                                                            \
+                                                                                                   \
+static inline void name##_init(name* ring)                                                         \
+{                                                                                                  \
+    atomic_init(&ring->head, 0U);                                                                  \
+    atomic_init(&ring->tail, 0U);                                                                  \
+    ring->cached_head = 0U;                                                                        \
+    ring->cached_tail = 0U;                                                                        \
+}                                                                                                  \
+                                                                                                   \
+/* Возвращает указатель на свободный слот или NULL, если очередь полна. */                         \
+static inline T* name##_begin_push(name* ring)                                                     \
+{                                                                                                  \
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);                       \
+                                                                                                   \
+    if (tail - ring->cached_head == (CAPACITY))                                                    \
+    {                                                                                              \
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);               \
+                                                                                                   \
+        if (tail - ring->cached_head == (CAPACITY))                                                \
+        {                                                                                          \
+            return NULL;                                                                           \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    return &ring->data[tail & ((CAPACITY) - 1U)];                                                  \
+}                                                                                                  \
+                                                                                                   \
+/* Публикует слот, полученный из begin_push(). */                                                  \
+static inline void name##_end_push(name* ring)                                                     \
+{                                                                                                  \
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);                       \
+    atomic_store_explicit(&ring->tail, tail + 1U, memory_order_release);                           \
+}                                                                                                  \
+                                                                                                   \
+/* Возвращает указатель на занятый слот или NULL, если очередь пуста. */                           \
+static inline const T* name##_begin_pop(name* ring)                                                \
+{                                                                                                  \
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);                       \
+                                                                                                   \
+    if (ring->cached_tail == head)                                                                 \
+    {                                                                                              \
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);               \
+                                                                                                   \
+        if (ring->cached_tail == head)                                                             \
+        {                                                                                          \
+            return NULL;                                                                           \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    return &ring->data[head & ((CAPACITY) - 1U)];                                                  \
+}                                                                                                  \
+                                                                                                   \
+/* Освобождает слот, полученный из begin_pop(). */                                                 \
+static inline void name##_end_pop(name* ring)                                                      \
+{                                                                                                  \
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);                       \
+    atomic_store_explicit(&ring->head, head + 1U, memory_order_release);                           \
+}                                                                                                  \
+                                                                                                   \
+static inline bool name##_push(name* ring, T elem)                                                 \
+{                                                                                                  \
+    T* slot = name##_begin_push(ring);                                                             \
+    if (slot == NULL)                                                                              \
+    {                                                                                              \
+        return false;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    *slot = elem;                                                                                  \
+    name##_end_push(ring);                                                                         \
+    return true;                                                                                   \
+}                                                                                                  \
+                                                                                                   \
+static inline bool name##_pop(name* ring, T* elem)                                                 \
+{                                                                                                  \
+    const T* slot = name##_begin_pop(ring);                                                        \
+    if (slot == NULL)                                                                              \
+    {                                                                                              \
+        return false;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    *elem = *slot;                                                                                 \
+    name##_end_pop(ring);                                                                          \
+    return true;                                                                                   \
+}
+
+#endif // MSUSEM_SPSC_RING
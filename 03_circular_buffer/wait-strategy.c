@@ -0,0 +1,308 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+
+// Feature test macro:
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+//============================
+// Параметры тестового стенда
+//============================
+
+#define QUEUE_SIZE     1024U
+#define NUM_ITERATIONS 10000000ULL
+
+// Пульсирующая нагрузка: NUM_BURSTS пачек по BURST_SIZE элементов с паузой BURST_INTERVAL_US.
+#define NUM_BURSTS        1000U
+#define BURST_SIZE        256U
+#define BURST_INTERVAL_US 1000U
+
+// Количество итераций с "pause" перед переходом к sched_yield() или фьютексу.
+#define NUM_SPINS 1000U
+
+#define ENABLE_PADDING  1
+#define CACHE_LINE_SIZE 256
+
+#define NUM_HARDWARE_THREADS 2U
+
+#include "circular-buffer.h"
+#include "wait-strategy.h"
+
+uint64_t time_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------
+// Применение кольцевой очереди
+//------------------------------
+
+typedef struct {
+    QUEUE queue;
+    WAIT_STRATEGY ws;
+
+    EVENTCOUNT not_empty;
+    EVENTCOUNT not_full;
+
+    // Режим пульсирующей нагрузки: элементы несут время отправки.
+    bool bursty;
+    uint64_t num_elems;
+
+    // Задержка пробуждения читателя для первого элемента каждой пачки.
+    uint64_t wake_latency[NUM_BURSTS];
+    // Процессорное время читателя.
+    uint64_t consumer_cpu_ns;
+} BENCH;
+
+bool queue_not_empty(void* arg)
+{
+    QUEUE* queue = (QUEUE*) arg;
+    return atomic_load_explicit(&queue->tail, memory_order_acquire) !=
+           atomic_load_explicit(&queue->head, memory_order_relaxed);
+}
+
+bool queue_not_full(void* arg)
+{
+    QUEUE* queue = (QUEUE*) arg;
+    return atomic_load_explicit(&queue->tail, memory_order_relaxed) -
+           atomic_load_explicit(&queue->head, memory_order_acquire) != queue->size;
+}
+
+void thread_producer(BENCH* bench)
+{
+    struct timespec interval = {
+        .tv_sec  = 0,
+        .tv_nsec = BURST_INTERVAL_US * 1000U
+    };
+
+    for (uint64_t snd_i = 0U; snd_i < bench->num_elems; ++snd_i)
+    {
+        uint64_t elem = snd_i;
+        if (bench->bursty)
+        {
+            if (snd_i % BURST_SIZE == 0U)
+            {
+                nanosleep(&interval, NULL);
+            }
+
+            elem = time_ns(CLOCK_MONOTONIC);
+        }
+
+        while (!queue_enqueue(&bench->queue, elem))
+        {
+            wait_for(&bench->ws, &bench->not_full, queue_not_full, &bench->queue);
+        }
+
+        wait_notify(&bench->ws, &bench->not_empty);
+    }
+}
+
+void thread_consumer(BENCH* bench)
+{
+    uint64_t cpu_start = time_ns(CLOCK_THREAD_CPUTIME_ID);
+
+    uint64_t prev = 0U;
+    for (uint64_t rcv_i = 0U; rcv_i < bench->num_elems; ++rcv_i)
+    {
+        uint64_t elem = 0U;
+        while (!queue_dequeue(&bench->queue, &elem))
+        {
+            wait_for(&bench->ws, &bench->not_empty, queue_not_empty, &bench->queue);
+        }
+
+        wait_notify(&bench->ws, &bench->not_full);
+
+        if (bench->bursty)
+        {
+            if (rcv_i % BURST_SIZE == 0U)
+            {
+                bench->wake_latency[rcv_i / BURST_SIZE] = time_ns(CLOCK_MONOTONIC) - elem;
+            }
+
+            // Compare result:
+            if (elem < prev)
+            {
+                printf("Invalid queue element: timestamp %lu after %lu\n", elem, prev);
+                exit(EXIT_FAILURE);
+            }
+
+            prev = elem;
+        }
+        else if (elem != rcv_i)
+        {
+            printf("Invalid queue element: expected %lu, got %lu\n", rcv_i, elem);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    bench->consumer_cpu_ns = time_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+}
+
+//-------------------------------
+// Совместное исполнение потоков
+//-------------------------------
+
+#define NUM_THREADS 2U
+
+typedef struct {
+    size_t thread_i;
+    BENCH* bench;
+} THREAD_ARGS;
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    if (args->thread_i == 0U)
+    {
+        thread_producer(args->bench);
+    }
+    else
+    {
+        thread_consumer(args->bench);
+    }
+
+    return NULL;
+}
+
+// Запускает пару писатель-читатель и возвращает время выполнения в наносекундах.
+uint64_t run_threads(BENCH* bench)
+{
+    THREAD_ARGS args[NUM_THREADS];
+    pthread_t tids[NUM_THREADS];
+
+    uint64_t start = time_ns(CLOCK_MONOTONIC);
+
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i = i;
+        args[i].bench = bench;
+
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+        CPU_SET(i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&tids[i], &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(tids[i], NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return time_ns(CLOCK_MONOTONIC) - start;
+}
+
+//--------------------------------
+// Инициализация тестового стенда
+//--------------------------------
+
+int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+void run_bench(BENCH* bench, WAIT_KIND kind, bool bursty)
+{
+    queue_init(&bench->queue, QUEUE_SIZE);
+    eventcount_init(&bench->not_empty);
+    eventcount_init(&bench->not_full);
+
+    bench->ws = (WAIT_STRATEGY) {.kind = kind, .num_spins = NUM_SPINS};
+    bench->bursty = bursty;
+    bench->num_elems = bursty? (uint64_t) NUM_BURSTS * BURST_SIZE : NUM_ITERATIONS;
+
+    uint64_t elapsed = run_threads(bench);
+
+    if (bursty)
+    {
+        qsort(bench->wake_latency, NUM_BURSTS, sizeof(uint64_t), compare_u64);
+        printf(" %10.1f %10.1f %10.1f %8.1f%%\n",
+            bench->wake_latency[NUM_BURSTS / 2U] / 1e3,
+            bench->wake_latency[NUM_BURSTS * 99U / 100U] / 1e3,
+            bench->wake_latency[NUM_BURSTS - 1U] / 1e3,
+            100.0 * bench->consumer_cpu_ns / elapsed);
+    }
+    else
+    {
+        printf("%14.0f", 1e9 * bench->num_elems / elapsed);
+    }
+
+    queue_free(&bench->queue);
+}
+
+int main()
+{
+    const char* names[] = {"spin", "yield", "futex"};
+
+    // Массив задержек слишком велик для стека.
+    BENCH* bench = (BENCH*) malloc(sizeof(BENCH));
+    if (bench == NULL)
+    {
+        fprintf(stderr, "Unable to allocate benchmark state\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-8s %14s %10s %10s %10s %9s\n",
+        "Strategy", "Ops/s", "Wake p50us", "Wake p99us", "Wake maxus", "Cons CPU");
+
+    for (WAIT_KIND kind = WAIT_SPIN; kind <= WAIT_FUTEX; ++kind)
+    {
+        printf("%-8s ", names[kind]);
+
+        // Непрерывная нагрузка: пропускная способность.
+        run_bench(bench, kind, false);
+
+        // Пульсирующая нагрузка: задержка пробуждения и загрузка процессора читателем.
+        run_bench(bench, kind, true);
+    }
+
+    free(bench);
+
+    return EXIT_SUCCESS;
+}
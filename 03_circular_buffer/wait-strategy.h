@@ -0,0 +1,140 @@
+// No copyright. Vladislav Alenik && Evgeny Baskov, 2024
+#ifndef MSUSEM_WAIT_STRATEGY
+#define MSUSEM_WAIT_STRATEGY
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <sched.h>
+#include <stdatomic.h>
+
+//------------
+// Eventcount
+//------------
+// Позволяет потоку заснуть до наступления события, не теряя уведомлений.
+// Ожидающий поток:
+//     key = eventcount_prepare(ec);
+//     if (условие выполнено) eventcount_cancel(ec);
+//     else                   eventcount_wait(ec, key);
+// Уведомляющий поток после того, как сделал условие истинным:
+//     eventcount_notify(ec);
+// Системный вызов FUTEX_WAKE выполняется, только если есть зарегистрированные ожидающие.
+
+typedef struct {
+    // Слово фьютекса: меняется при каждом уведомлении с ожидающими.
+    _Atomic uint32_t epoch;
+    // Количество потоков, готовящихся заснуть или уже спящих.
+    _Atomic uint32_t waiters;
+} EVENTCOUNT;
+
+// Обёртка системного вызова futex().
+static int futex(
+    _Atomic uint32_t* uaddr,
+    int futex_op,
+    uint32_t val)
+{
+    return syscall(SYS_futex, uaddr, futex_op, val, NULL, NULL, 0);
+}
+
+void eventcount_init(EVENTCOUNT* ec)
+{
+    atomic_init(&ec->epoch, 0U);
+    atomic_init(&ec->waiters, 0U);
+}
+
+uint32_t eventcount_prepare(EVENTCOUNT* ec)
+{
+    // [1] Регистрация ожидающего упорядочена с последующей проверкой условия (см. [2]).
+    atomic_fetch_add_explicit(&ec->waiters, 1U, memory_order_seq_cst);
+    return atomic_load_explicit(&ec->epoch, memory_order_seq_cst);
+}
+
+void eventcount_cancel(EVENTCOUNT* ec)
+{
+    atomic_fetch_sub_explicit(&ec->waiters, 1U, memory_order_relaxed);
+}
+
+void eventcount_wait(EVENTCOUNT* ec, uint32_t key)
+{
+    // Если уведомление уже произошло, epoch != key и вызов сразу вернётся.
+    futex(&ec->epoch, FUTEX_WAIT_PRIVATE, key);
+
+    atomic_fetch_sub_explicit(&ec->waiters, 1U, memory_order_relaxed);
+}
+
+void eventcount_notify(EVENTCOUNT* ec)
+{
+    // [2] Изменение условия упорядочено с проверкой наличия ожидающих (см. [1]).
+    // Либо ожидающий увидит новое условие, либо мы увидим ожидающего.
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (atomic_load_explicit(&ec->waiters, memory_order_relaxed) != 0U)
+    {
+        atomic_fetch_add_explicit(&ec->epoch, 1U, memory_order_seq_cst);
+        futex(&ec->epoch, FUTEX_WAKE_PRIVATE, INT_MAX);
+    }
+}
+
+//--------------------
+// Стратегии ожидания
+//--------------------
+// - WAIT_SPIN:  активное ожидание с инструкцией x86 "pause";
+// - WAIT_YIELD: num_spins итераций с "pause", затем sched_yield() на каждой итерации;
+// - WAIT_FUTEX: num_spins итераций с "pause", затем сон на фьютексе через eventcount.
+
+#define spinloop_pause() __asm__ volatile("pause")
+
+typedef enum {
+    WAIT_SPIN,
+    WAIT_YIELD,
+    WAIT_FUTEX
+} WAIT_KIND;
+
+typedef struct {
+    WAIT_KIND kind;
+    uint32_t num_spins;
+} WAIT_STRATEGY;
+
+// Ожидает, пока ready(arg) не станет истинным.
+// Для WAIT_FUTEX противоположная сторона обязана вызывать wait_notify() на том же ec.
+void wait_for(const WAIT_STRATEGY* ws, EVENTCOUNT* ec, bool (*ready)(void*), void* arg)
+{
+    for (uint32_t spin = 0U; !ready(arg); ++spin)
+    {
+        if (ws->kind == WAIT_SPIN || spin < ws->num_spins)
+        {
+            spinloop_pause();
+        }
+        else if (ws->kind == WAIT_YIELD)
+        {
+            sched_yield();
+        }
+        else
+        {
+            uint32_t key = eventcount_prepare(ec);
+            if (ready(arg))
+            {
+                eventcount_cancel(ec);
+                return;
+            }
+
+            eventcount_wait(ec, key);
+        }
+    }
+}
+
+// Уведомляет ожидающих на ec об изменении условия.
+void wait_notify(const WAIT_STRATEGY* ws, EVENTCOUNT* ec)
+{
+    if (ws->kind == WAIT_FUTEX)
+    {
+        eventcount_notify(ec);
+    }
+}
+
+#endif // MSUSEM_WAIT_STRATEGY
@@ -0,0 +1,328 @@
+// Copyright 2025, Vladislav Aleinik
+#ifndef MSUSEM_CHECKSUM
+#define MSUSEM_CHECKSUM
+
+#include "common.h"
+
+#include <nmmintrin.h>
+
+//=========================================
+// CRC32C (полином Кастаньоли, 0x1EDC6F41)
+//=========================================
+// Соглашение о вызове совпадает с crc32() из zlib:
+// crc32c(crc32c(0, A), B) == crc32c(0, A||B).
+//
+// Реализации:
+// - Аппаратная: инструкция crc32 из набора SSE4.2 (8 байт за инструкцию).
+// - Программная: табличное вычисление по одному байту.
+//
+// NOTE: для CRC32C векторные расширения AVX2 не дают выигрыша:
+//       инструкция crc32 уже обрабатывает данные быстрее, чем их отдаёт накопитель.
+
+// Полином в обратной (reflected) записи.
+#define CRC32C_POLY 0x82F63B78U
+
+static uint32_t crc32c_table[256];
+
+uint32_t crc32c_scalar(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+
+    crc = ~crc;
+    for (size_t i = 0U; i < len; ++i)
+    {
+        crc = crc32c_table[(crc ^ bytes[i]) & 0xFFU] ^ (crc >> 8U);
+    }
+
+    return ~crc;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const void* data, size_t len)
+{
+    const uint8_t* bytes = (const uint8_t*) data;
+
+    uint64_t crc64 = ~crc;
+
+    // Основной цикл: по 8 байт за инструкцию.
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    // Хвост блока: по одному байту.
+    uint32_t crc32 = (uint32_t) crc64;
+    for (; len != 0U; --len, ++bytes)
+    {
+        crc32 = _mm_crc32_u8(crc32, *bytes);
+    }
+
+    return ~crc32;
+}
+
+// Реализация, выбранная при инициализации.
+static uint32_t (*crc32c)(uint32_t crc, const void* data, size_t len) = crc32c_scalar;
+
+void crc32c_init()
+{
+    // Заполняем таблицу для программной реализации.
+    for (uint32_t byte = 0U; byte < 256U; ++byte)
+    {
+        uint32_t crc = byte;
+        for (unsigned bit = 0U; bit < 8U; ++bit)
+        {
+            crc = (crc & 1U)? (crc >> 1U) ^ CRC32C_POLY : (crc >> 1U);
+        }
+
+        crc32c_table[byte] = crc;
+    }
+
+    // Выбираем реализацию в зависимости от возможностей процессора.
+    __builtin_cpu_init();
+    crc32c = __builtin_cpu_supports("sse4.2")? crc32c_sse42 : crc32c_scalar;
+}
+
+//===========================================
+// Объединение контрольных сумм блоков файла
+//===========================================
+// CRC линеен над GF(2), поэтому crc(A||B) = shift(crc(A), |B|) ^ crc(B),
+// где shift - умножение на матрицу 32x32, соответствующую дописыванию |B| нулевых байт.
+// Матрица для фиксированной длины вычисляется один раз, после чего объединение
+// стоит 32 операции XOR на блок.
+
+typedef struct
+{
+    uint32_t matrix[32];
+} CRC32C_SHIFT;
+
+uint32_t gf2_matrix_times(const uint32_t* matrix, uint32_t vector)
+{
+    uint32_t sum = 0U;
+    for (unsigned i = 0U; vector != 0U; ++i, vector >>= 1U)
+    {
+        if (vector & 1U)
+        {
+            sum ^= matrix[i];
+        }
+    }
+
+    return sum;
+}
+
+// Композиция операторов: result = outer * inner.
+void gf2_matrix_compose(uint32_t* result, const uint32_t* outer, const uint32_t* inner)
+{
+    uint32_t tmp[32];
+    for (unsigned i = 0U; i < 32U; ++i)
+    {
+        tmp[i] = gf2_matrix_times(outer, inner[i]);
+    }
+
+    memcpy(result, tmp, sizeof(tmp));
+}
+
+void crc32c_shift_init(CRC32C_SHIFT* shift, uint64_t len)
+{
+    // Оператор дописывания одного нулевого бита.
+    uint32_t power[32];
+    power[0] = CRC32C_POLY;
+    for (unsigned i = 1U; i < 32U; ++i)
+    {
+        power[i] = 1U << (i - 1U);
+    }
+
+    // Оператор дописывания одного нулевого байта.
+    for (unsigned i = 0U; i < 3U; ++i)
+    {
+        gf2_matrix_compose(power, power, power);
+    }
+
+    // Начинаем с тождественного оператора.
+    for (unsigned i = 0U; i < 32U; ++i)
+    {
+        shift->matrix[i] = 1U << i;
+    }
+
+    // Возведение в степень len методом двоичного разложения.
+    for (; len != 0U; len >>= 1U)
+    {
+        if (len & 1U)
+        {
+            gf2_matrix_compose(shift->matrix, power, shift->matrix);
+        }
+
+        gf2_matrix_compose(power, power, power);
+    }
+}
+
+uint32_t crc32c_combine(const CRC32C_SHIFT* shift, uint32_t crc_head, uint32_t crc_tail)
+{
+    return gf2_matrix_times(shift->matrix, crc_head) ^ crc_tail;
+}
+
+//=========================
+// Контрольная сумма файла
+//=========================
+
+typedef struct
+{
+    // Контрольные суммы отдельных блоков в порядке их следования в файле.
+    uint32_t* block_crcs;
+    size_t num_blocks;
+
+    uint32_t block_size;
+    uint64_t file_size;
+} FILE_DIGEST;
+
+void file_digest_init(FILE_DIGEST* digest, uint64_t file_size, uint32_t block_size)
+{
+    crc32c_init();
+
+    digest->block_size = block_size;
+    digest->file_size  = file_size;
+    digest->num_blocks = (file_size + block_size - 1U) / block_size;
+
+    digest->block_crcs = calloc(digest->num_blocks + 1U, sizeof(uint32_t));
+    uint8_t* zero_block = calloc(block_size, sizeof(uint8_t));
+    if (digest->block_crcs == NULL || zero_block == NULL)
+    {
+        fprintf(stderr, "Unable to allocate block checksums\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Блоки, которые не будут прочитаны (например, "дыры" разреженного файла), состоят из нулей.
+    uint32_t zero_crc = crc32c(0U, zero_block, block_size);
+    for (size_t i = 0U; i < digest->num_blocks; ++i)
+    {
+        digest->block_crcs[i] = zero_crc;
+    }
+
+    if (file_size % block_size != 0U)
+    {
+        digest->block_crcs[digest->num_blocks - 1U] = crc32c(0U, zero_block, file_size % block_size);
+    }
+
+    free(zero_block);
+}
+
+void file_digest_free(FILE_DIGEST* digest)
+{
+    free(digest->block_crcs);
+}
+
+// Вычисляет контрольную сумму блока, пока он находится в промежуточном буфере.
+// Блоки могут обрабатываться в произвольном порядке и из разных потоков.
+void file_digest_update(FILE_DIGEST* digest, uint64_t offset, const void* data, size_t len)
+{
+    digest->block_crcs[offset / digest->block_size] = crc32c(0U, data, len);
+}
+
+uint32_t file_digest_finalize(const FILE_DIGEST* digest)
+{
+    if (digest->num_blocks == 0U)
+    {
+        return 0U;
+    }
+
+    CRC32C_SHIFT full_block;
+    crc32c_shift_init(&full_block, digest->block_size);
+
+    uint32_t crc = digest->block_crcs[0];
+    for (size_t i = 1U; i < digest->num_blocks; ++i)
+    {
+        uint64_t block_offset = (uint64_t) i * digest->block_size;
+        uint64_t block_len    = digest->file_size - block_offset;
+
+        if (block_len >= digest->block_size)
+        {
+            crc = crc32c_combine(&full_block, crc, digest->block_crcs[i]);
+        }
+        else
+        {
+            // Последний блок файла может быть неполным.
+            CRC32C_SHIFT tail_block;
+            crc32c_shift_init(&tail_block, block_len);
+
+            crc = crc32c_combine(&tail_block, crc, digest->block_crcs[i]);
+        }
+    }
+
+    return crc;
+}
+
+//============================
+// Проверка записанного файла
+//============================
+
+#define VERIFY_CHUNK_SIZE (1U << 20U)
+
+// Повторно считывает файл в обход страничного кеша (O_DIRECT).
+// Таким образом проверяются данные на устройстве, а не в памяти.
+uint32_t file_digest_readback(const char* filename)
+{
+    int fd = open(filename, O_RDONLY|O_DIRECT);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Unable to open file '%s' for verification: errno=%i (%s)\n",
+            filename, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    uint8_t* chunk = (uint8_t*) aligned_alloc(VERIFY_CHUNK_SIZE, VERIFY_CHUNK_SIZE);
+    if (chunk == NULL)
+    {
+        fprintf(stderr, "Unable to allocate verification buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t crc = 0U;
+    for (off_t offset = 0;;)
+    {
+        ssize_t bytes_read = pread(fd, chunk, VERIFY_CHUNK_SIZE, offset);
+        if (bytes_read == -1)
+        {
+            fprintf(stderr, "Unable to read file '%s' for verification: errno=%i (%s)\n",
+                filename, errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        if (bytes_read == 0)
+        {
+            break;
+        }
+
+        crc = crc32c(crc, chunk, bytes_read);
+        offset += bytes_read;
+    }
+
+    free(chunk);
+    close(fd);
+
+    return crc;
+}
+
+void file_digest_report(const FILE_DIGEST* digest, const char* dst_filename, bool verify)
+{
+    uint32_t crc = file_digest_finalize(digest);
+    printf("CRC32C: %08x\n", crc);
+
+    if (!verify)
+    {
+        return;
+    }
+
+    uint32_t crc_on_disk = file_digest_readback(dst_filename);
+    if (crc_on_disk != crc)
+    {
+        fprintf(stderr, "Verification failed: '%s' has CRC32C %08x, expected %08x\n",
+            dst_filename, crc_on_disk, crc);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Verified: %s\n", dst_filename);
+}
+
+#endif // MSUSEM_CHECKSUM
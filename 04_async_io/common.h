@@ -17,6 +17,14 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <linux/ioprio.h>
+#include <time.h>
+
 //======================
 // Операции над файлами
 //======================
@@ -45,10 +53,14 @@ void open_src_file(const char* filename, int* fd, uint32_t* file_size)
     *file_size = statbuf.st_size;
 }
 
-void open_dst_file(const char* filename, int* fd, uint32_t src_size)
+// Флаг preallocate управляет предварительным выделением места на диске.
+// При копировании разреженного файла предварительное выделение уничтожило бы "дыры".
+// Флаг direct включает запись в обход страничного кеша (O_DIRECT).
+void open_dst_file(const char* filename, int* fd, uint32_t src_size, bool preallocate, bool direct)
 {
     // Открываем файл на запись.
-    *fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    // Доступ на чтение необходим для отображения файла в память (mmap-cp).
+    *fd = open(filename, O_RDWR|O_CREAT|O_TRUNC|(direct? O_DIRECT : 0), 0644);
     if (*fd == -1)
     {
         fprintf(stderr, "Unable to open destination file '%s': errno=%i (%s)",
@@ -58,7 +70,7 @@ void open_dst_file(const char* filename, int* fd, uint32_t src_size)
 
     // Просим ОС превентивно выделить память под файл.
     // Это позволяет избавиться итеративного довыделения памяти в процессе копирования.
-    if (fallocate(*fd, 0, 0, src_size) == -1)
+    if (preallocate && fallocate(*fd, 0, 0, src_size) == -1)
     {
         fprintf(stderr, "Not enough space for file '%s': errno=%i (%s)",
             filename, errno, strerror(errno));
@@ -66,6 +78,76 @@ void open_dst_file(const char* filename, int* fd, uint32_t src_size)
     }
 }
 
+//===================
+// Прямой ввод-вывод
+//===================
+// При O_DIRECT смещение и длина запроса должны быть кратны dio_offset_align,
+// а адрес буфера - кратен dio_mem_align. Требования зависят от ФС и устройства,
+// поэтому запрашиваются у ядра через statx(STATX_DIOALIGN) (Linux 6.1+).
+
+typedef struct
+{
+    uint32_t mem_align;
+    uint32_t offset_align;
+} DIO_ALIGNMENT;
+
+// Размер логического блока по умолчанию для ядер без поддержки STATX_DIOALIGN.
+#define DIO_DEFAULT_ALIGNMENT 4096U
+
+void query_dio_alignment(int fd, const char* filename, DIO_ALIGNMENT* align)
+{
+    struct statx statxbuf;
+    if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &statxbuf) == -1)
+    {
+        fprintf(stderr, "Unable to query file '%s' attributes: errno=%i (%s)\n",
+            filename, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if ((statxbuf.stx_mask & STATX_DIOALIGN) == 0U)
+    {
+        // Ядро не сообщает требования: используем консервативное значение.
+        align->mem_align    = DIO_DEFAULT_ALIGNMENT;
+        align->offset_align = DIO_DEFAULT_ALIGNMENT;
+        return;
+    }
+
+    if (statxbuf.stx_dio_offset_align == 0U)
+    {
+        fprintf(stderr, "File '%s' does not support direct I/O\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    align->mem_align    = statxbuf.stx_dio_mem_align;
+    align->offset_align = statxbuf.stx_dio_offset_align;
+}
+
+// Выравнивание слотов пула промежуточных буферов (см. "Пул промежуточных буферов").
+#define BUFFER_POOL_PAGE_SIZE     4096U
+
+// Проверяет, что блоки копирования удовлетворяют требованиям O_DIRECT.
+// Буферы пула выровнены на размер страницы (BUFFER_POOL_PAGE_SIZE).
+void check_dio_alignment(int fd, const char* filename, uint32_t block_size)
+{
+    DIO_ALIGNMENT align;
+    query_dio_alignment(fd, filename, &align);
+
+    if (block_size % align.offset_align != 0U || BUFFER_POOL_PAGE_SIZE % align.mem_align != 0U)
+    {
+        fprintf(stderr, "Block size %u is incompatible with direct I/O on '%s' (offset align %u, memory align %u)\n",
+            block_size, filename, align.offset_align, align.mem_align);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Длина записи последнего (неполного) блока при O_DIRECT.
+// Блок дописывается до кратного выравниванию размера, лишние байты отрезает
+// ftruncate() в close_src_dst_files().
+size_t dio_write_size(size_t size, uint32_t block_size)
+{
+    return (size + block_size - 1U) / block_size * block_size;
+}
+
 void close_src_dst_files(
     const char* src_filename, int src_fd, uint32_t src_size,
     const char* dst_filename, int dst_fd)
@@ -103,4 +185,1038 @@ void close_src_dst_files(
     }
 }
 
+//===================
+// Разреженные файлы
+//===================
+// Файл представляется списком отрезков с данными (extent-ов), полученных с помощью
+// lseek(SEEK_DATA/SEEK_HOLE). Копируются только они, "дыры" на приёмнике сохраняются,
+// т.к. под пропущенные блоки место на диске не выделяется.
+
+typedef struct
+{
+    off_t start;
+    off_t end;
+} FILE_EXTENT;
+
+typedef struct
+{
+    FILE_EXTENT* extents;
+    size_t num_extents;
+
+    off_t file_size;
+} FILE_EXTENTS;
+
+void file_extents_append(FILE_EXTENTS* list, off_t start, off_t end)
+{
+    // Отрезки, ставшие смежными после выравнивания, объединяем.
+    if (list->num_extents != 0U && list->extents[list->num_extents - 1U].end >= start)
+    {
+        list->extents[list->num_extents - 1U].end = end;
+        return;
+    }
+
+    list->extents = realloc(list->extents, (list->num_extents + 1U) * sizeof(FILE_EXTENT));
+    if (list->extents == NULL)
+    {
+        fprintf(stderr, "Unable to allocate file extent list\n");
+        exit(EXIT_FAILURE);
+    }
+
+    list->extents[list->num_extents].start = start;
+    list->extents[list->num_extents].end   = end;
+    list->num_extents += 1U;
+}
+
+// Границы отрезков выравниваются на размер блока копирования align.
+// При sparse == false файл считается одним сплошным отрезком.
+void file_extents_scan(int fd, uint32_t file_size, uint32_t align, bool sparse, FILE_EXTENTS* list)
+{
+    list->extents     = NULL;
+    list->num_extents = 0U;
+    list->file_size   = file_size;
+
+    if (!sparse)
+    {
+        file_extents_append(list, 0, file_size);
+        return;
+    }
+
+    for (off_t offset = 0; offset < file_size;)
+    {
+        off_t data = lseek(fd, offset, SEEK_DATA);
+        if (data == -1)
+        {
+            if (errno == ENXIO)
+            {   // Дальше данных нет.
+                break;
+            }
+
+            fprintf(stderr, "Unable to seek to data: errno=%i (%s)\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole == -1)
+        {
+            fprintf(stderr, "Unable to seek to hole: errno=%i (%s)\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        off_t start = data - data % align;
+        off_t end   = (hole + align - 1) - (hole + align - 1) % align;
+        if (end > file_size) end = file_size;
+
+        file_extents_append(list, start, end);
+
+        offset = hole;
+    }
+}
+
+void file_extents_free(FILE_EXTENTS* list)
+{
+    free(list->extents);
+}
+
+// Возвращает наименьшее смещение >= offset, лежащее внутри отрезка с данными.
+// Если таких смещений нет, возвращает размер файла.
+off_t file_extents_next(const FILE_EXTENTS* list, off_t offset)
+{
+    // Двоичный поиск первого отрезка, оканчивающегося после offset.
+    size_t lo = 0U;
+    size_t hi = list->num_extents;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2U;
+        if (list->extents[mid].end <= offset) lo = mid + 1U;
+        else                                  hi = mid;
+    }
+
+    if (lo == list->num_extents)
+    {
+        return list->file_size;
+    }
+
+    return (list->extents[lo].start > offset)? list->extents[lo].start : offset;
+}
+
+// Проверка блока на равенство нулю.
+// Нулевые блоки можно не записывать: на месте незаписанного блока останется "дыра".
+bool block_is_zero(const uint8_t* block, size_t size)
+{
+    if (size == 0U)
+    {
+        return true;
+    }
+
+    // Блок нулевой, если первый байт нулевой и блок совпадает с собой, сдвинутым на байт.
+    return block[0] == 0U && memcmp(block, block + 1U, size - 1U) == 0;
+}
+
+// Пропущенный нулевой блок в заранее выделенном файле (fallocate()) остаётся выделенным:
+// освобождаем его место явно, размер файла при этом не меняется.
+void punch_zero_block(int fd, off_t offset, size_t size)
+{
+    if (size != 0U && fallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, size) == -1)
+    {
+        fprintf(stderr, "Unable to punch hole [%lx, %lx): errno=%i (%s)\n",
+            offset, offset + size, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+//==================================
+// Постепенный сброс данных на диск
+//==================================
+// Без управления записью буферизованное копирование накапливает в страничном кеше
+// гигабайты "грязных" страниц, а финальный fsync() надолго останавливает программу.
+//
+// Контроллер делит файл на окна фиксированного размера. Как только в окно записаны
+// все его данные:
+// - для окна запускается запись на диск: sync_file_range(SYNC_FILE_RANGE_WRITE);
+// - для окна, отстающего на WRITEBACK_LAG окон, дожидаемся окончания записи
+//   и выбрасываем его страницы из кеша: fadvise(DONTNEED).
+// Таким образом объём "грязной" памяти ограничен (WRITEBACK_LAG + 1) окнами.
+// Окна, целиком попадающие в "дыры", не завершаются никогда, поэтому отставание
+// отсчитывается только по окнам с данными.
+//
+// NOTE: предполагается, что каждая запись целиком лежит в одном окне
+//       (размер окна кратен размеру блока записи).
+
+#define WRITEBACK_LAG 2U
+
+// Признак отсутствия завершённого окна.
+#define WRITEBACK_NO_WINDOW (-1)
+
+typedef struct
+{
+    int fd;
+    uint32_t window_size;
+    size_t num_windows;
+
+    // Ожидаемое количество байт данных в каждом окне (с учётом "дыр" исходного файла).
+    uint32_t* window_expected;
+    // Количество уже записанных байт в каждом окне.
+    _Atomic uint32_t* window_written;
+    // Окно с данными, отстающее от данного на WRITEBACK_LAG окон с данными, либо WRITEBACK_NO_WINDOW.
+    int64_t* window_lagged;
+} WRITEBACK_CONTROLLER;
+
+void writeback_init(WRITEBACK_CONTROLLER* ctl, int fd, const FILE_EXTENTS* extents, uint32_t window_size)
+{
+    ctl->fd          = fd;
+    ctl->window_size = window_size;
+    ctl->num_windows = (extents->file_size + window_size - 1U) / window_size;
+
+    ctl->window_expected = calloc(ctl->num_windows + 1U, sizeof(uint32_t));
+    ctl->window_written  = calloc(ctl->num_windows + 1U, sizeof(_Atomic uint32_t));
+    ctl->window_lagged   = calloc(ctl->num_windows + 1U, sizeof(int64_t));
+    if (ctl->window_expected == NULL || ctl->window_written == NULL || ctl->window_lagged == NULL)
+    {
+        fprintf(stderr, "Unable to allocate writeback windows\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Распределяем данные файла по окнам.
+    for (size_t i = 0U; i < extents->num_extents; ++i)
+    {
+        for (off_t offset = extents->extents[i].start; offset < extents->extents[i].end;)
+        {
+            size_t window   = offset / window_size;
+            off_t window_end = (off_t) (window + 1U) * window_size;
+            off_t end        = (extents->extents[i].end < window_end)? extents->extents[i].end : window_end;
+
+            ctl->window_expected[window] += end - offset;
+            offset = end;
+        }
+    }
+
+    // Связываем каждое окно с данными с окном, отстающим на WRITEBACK_LAG окон с данными.
+    int64_t recent[WRITEBACK_LAG] = {0};
+    size_t num_data_windows = 0U;
+    for (size_t window = 0U; window <= ctl->num_windows; ++window)
+    {
+        ctl->window_lagged[window] = WRITEBACK_NO_WINDOW;
+        if (ctl->window_expected[window] == 0U)
+        {
+            continue;
+        }
+
+        if (num_data_windows >= WRITEBACK_LAG)
+        {
+            ctl->window_lagged[window] = recent[num_data_windows % WRITEBACK_LAG];
+        }
+
+        recent[num_data_windows % WRITEBACK_LAG] = window;
+        num_data_windows += 1U;
+    }
+}
+
+void writeback_free(WRITEBACK_CONTROLLER* ctl)
+{
+    free(ctl->window_expected);
+    free(ctl->window_written);
+    free(ctl->window_lagged);
+}
+
+// Учитывает запись [offset, offset + size).
+// Возвращает номер окна, все данные которого записаны, либо WRITEBACK_NO_WINDOW.
+// Может вызываться из нескольких потоков.
+int64_t writeback_account(WRITEBACK_CONTROLLER* ctl, off_t offset, size_t size)
+{
+    // Пустое чтение в конце файла не относится ни к одному окну.
+    if (size == 0U)
+    {
+        return WRITEBACK_NO_WINDOW;
+    }
+
+    size_t window = offset / ctl->window_size;
+
+    uint32_t written = atomic_fetch_add_explicit(&ctl->window_written[window], size, memory_order_relaxed) + size;
+
+    return (written == ctl->window_expected[window])? (int64_t) window : WRITEBACK_NO_WINDOW;
+}
+
+// Диапазон окна в файле.
+void writeback_window_range(const WRITEBACK_CONTROLLER* ctl, size_t window, off_t* offset, off_t* size)
+{
+    *offset = (off_t) window * ctl->window_size;
+    *size   = ctl->window_size;
+}
+
+// Синхронная реализация управления записью (для движков на основе pwrite).
+void writeback_flush_window(WRITEBACK_CONTROLLER* ctl, size_t window)
+{
+    off_t offset, size;
+
+    // Запускаем запись окна на диск, не дожидаясь её окончания.
+    writeback_window_range(ctl, window, &offset, &size);
+    if (sync_file_range(ctl->fd, offset, size, SYNC_FILE_RANGE_WRITE) == -1)
+    {
+        fprintf(stderr, "Unable to start writeback: errno=%i (%s)\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (ctl->window_lagged[window] == WRITEBACK_NO_WINDOW)
+    {
+        return;
+    }
+
+    // Дожидаемся записи более старого окна и выбрасываем его из страничного кеша.
+    writeback_window_range(ctl, ctl->window_lagged[window], &offset, &size);
+    if (sync_file_range(ctl->fd, offset, size,
+            SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER) == -1)
+    {
+        fprintf(stderr, "Unable to wait for writeback: errno=%i (%s)\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Ошибка не влияет на корректность: страницы останутся в кеше.
+    posix_fadvise(ctl->fd, offset, size, POSIX_FADV_DONTNEED);
+}
+
+//===========================
+// Пул промежуточных буферов
+//===========================
+// Свойства пула:
+// - Память выделяется страницами по 2 МиБ (hugetlbfs, либо THP при отсутствии зарезервированных страниц).
+//   Это уменьшает количество промахов TLB при работе с большими блоками.
+// - Память размещается на NUMA-узле вызывающего потока и заранее отображается (pre-fault).
+// - Весь пул - один непрерывный регион, поэтому регистрируется в io_uring одним вектором.
+// - Слоты фиксированного размера выдаются и возвращаются без блокировок (стек Трайбера).
+
+#define BUFFER_POOL_HUGEPAGE_SIZE (2U << 20U)
+
+// Признак пустого стека свободных слотов.
+#define BUFFER_POOL_NO_SLOT UINT32_MAX
+
+typedef struct
+{
+    // Регион памяти, выровненный на 2 МиБ.
+    uint8_t* memory;
+    size_t memory_size;
+
+    // Шаг между соседними слотами (кратен размеру страницы).
+    size_t slot_stride;
+    uint32_t num_slots;
+
+    // Ссылки на следующий свободный слот.
+    _Atomic uint32_t* next;
+
+    // Вершина стека свободных слотов: [счётчик версий:32 | индекс слота:32].
+    // Счётчик версий защищает от ABA-проблемы при одновременных acquire/release.
+    _Atomic uint64_t free_head;
+} BUFFER_POOL;
+
+uint8_t* buffer_pool_map(size_t size)
+{
+    // Пытаемся получить память из пула зарезервированных больших страниц.
+    // NOTE: на x86-64 размер большой страницы по умолчанию - 2 МиБ.
+    void* memory = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED)
+    {
+        return (uint8_t*) memory;
+    }
+
+    // Большие страницы не зарезервированы.
+    // Выделяем регион с запасом и выравниваем его на 2 МиБ вручную,
+    // чтобы механизм THP мог отобразить его большими страницами.
+    uint8_t* region = mmap(NULL, size + BUFFER_POOL_HUGEPAGE_SIZE, PROT_READ|PROT_WRITE,
+                           MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map buffer pool: errno=%i (%s)\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    uintptr_t aligned = ((uintptr_t) region + BUFFER_POOL_HUGEPAGE_SIZE - 1U) & ~((uintptr_t) BUFFER_POOL_HUGEPAGE_SIZE - 1U);
+    size_t head_size  = aligned - (uintptr_t) region;
+    size_t tail_size  = BUFFER_POOL_HUGEPAGE_SIZE - head_size;
+
+    // Возвращаем ОС невыровненные края региона.
+    if (head_size != 0U) munmap(region, head_size);
+    if (tail_size != 0U) munmap((uint8_t*) aligned + size, tail_size);
+
+    // Ошибка не влияет на корректность: память останется отображённой страницами по 4 КиБ.
+    madvise((void*) aligned, size, MADV_HUGEPAGE);
+
+    return (uint8_t*) aligned;
+}
+
+void buffer_pool_init(BUFFER_POOL* pool, uint32_t slot_size, uint32_t num_slots)
+{
+    pool->slot_stride = (slot_size + BUFFER_POOL_PAGE_SIZE - 1U) & ~(BUFFER_POOL_PAGE_SIZE - 1U);
+    pool->num_slots   = num_slots;
+
+    // Округляем размер пула до целого числа больших страниц.
+    pool->memory_size = pool->slot_stride * num_slots;
+    pool->memory_size = (pool->memory_size + BUFFER_POOL_HUGEPAGE_SIZE - 1U) & ~((size_t) BUFFER_POOL_HUGEPAGE_SIZE - 1U);
+
+    pool->memory = buffer_pool_map(pool->memory_size);
+
+    // Привязываем память к NUMA-узлу текущего потока.
+    // Ошибка не влияет на корректность: ядро без поддержки NUMA возвращает ENOSYS.
+    syscall(SYS_mbind, pool->memory, pool->memory_size, MPOL_LOCAL, NULL, 0UL, 0U);
+
+    // Заранее отображаем все страницы, чтобы не получать page fault-ы в процессе копирования.
+    for (size_t offset = 0U; offset < pool->memory_size; offset += BUFFER_POOL_PAGE_SIZE)
+    {
+        ((volatile uint8_t*) pool->memory)[offset] = 0U;
+    }
+
+    // Формируем стек свободных слотов.
+    pool->next = calloc(num_slots, sizeof(_Atomic uint32_t));
+    if (pool->next == NULL)
+    {
+        fprintf(stderr, "Unable to allocate buffer pool free list\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0U; i < num_slots; ++i)
+    {
+        atomic_store_explicit(&pool->next[i], (i + 1U < num_slots)? i + 1U : BUFFER_POOL_NO_SLOT, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&pool->free_head, (num_slots != 0U)? 0U : BUFFER_POOL_NO_SLOT, memory_order_release);
+}
+
+void buffer_pool_free(BUFFER_POOL* pool)
+{
+    munmap(pool->memory, pool->memory_size);
+    free(pool->next);
+}
+
+// Возвращает NULL, если свободных слотов нет.
+uint8_t* buffer_pool_acquire(BUFFER_POOL* pool)
+{
+    uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    while (true)
+    {
+        uint32_t slot = (uint32_t) head;
+        if (slot == BUFFER_POOL_NO_SLOT)
+        {
+            return NULL;
+        }
+
+        uint32_t next = atomic_load_explicit(&pool->next[slot], memory_order_relaxed);
+        uint64_t new_head = ((head >> 32U) + 1U) << 32U | next;
+
+        if (atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                memory_order_acquire, memory_order_acquire))
+        {
+            return pool->memory + slot * pool->slot_stride;
+        }
+    }
+}
+
+void buffer_pool_release(BUFFER_POOL* pool, uint8_t* buffer)
+{
+    uint32_t slot = (buffer - pool->memory) / pool->slot_stride;
+
+    uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    while (true)
+    {
+        atomic_store_explicit(&pool->next[slot], (uint32_t) head, memory_order_relaxed);
+        uint64_t new_head = ((head >> 32U) + 1U) << 32U | slot;
+
+        if (atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                memory_order_release, memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+// Описание всего пула для однократной регистрации (например, io_uring_register_buffers).
+struct iovec buffer_pool_iovec(const BUFFER_POOL* pool)
+{
+    struct iovec iov =
+    {
+        .iov_base = pool->memory,
+        .iov_len  = pool->memory_size
+    };
+
+    return iov;
+}
+
+uint8_t* buffer_pool_acquire_or_die(BUFFER_POOL* pool)
+{
+    uint8_t* buffer = buffer_pool_acquire(pool);
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "Buffer pool is exhausted\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return buffer;
+}
+
+//===========================
+// Фоновый режим копирования
+//===========================
+// Копирование не должно ухудшать задержки (p99) других нагрузок на тех же дисках:
+// - Запросы получают класс приоритета ввода-вывода (IOPRIO_CLASS_IDLE/BE).
+//   Приоритет учитывается планировщиками BFQ и mq-deadline.
+// - Скорость копирования ограничивается "ведром с токенами" по байтам и по операциям.
+// - При росте задержки завершения запросов выше порога глубина очереди уменьшается
+//   вдвое и затем растёт на единицу (AIMD, как окно перегрузки TCP).
+
+// Флаг iocb, включающий учёт поля aio_reqprio (см. linux/aio_abi.h).
+// NOTE: linux/aio_abi.h не подключается, так как конфликтует с libaio.h.
+#ifndef IOCB_FLAG_IOPRIO
+#define IOCB_FLAG_IOPRIO (1 << 1)
+#endif
+
+// Запас токенов: скорость может кратковременно превышать ограничение в течение этого времени.
+#define THROTTLE_BURST_NS (100U * 1000U * 1000U)
+
+uint64_t time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000U + ts.tv_nsec;
+}
+
+typedef struct
+{
+    // Скорость пополнения (единиц в секунду). 0 - без ограничения.
+    double rate;
+    double capacity;
+    // Может уходить в минус: запрос, превышающий запас, оплачивается в долг.
+    double tokens;
+} TOKEN_BUCKET;
+
+void token_bucket_init(TOKEN_BUCKET* bucket, uint64_t rate)
+{
+    bucket->rate     = rate;
+    bucket->capacity = (double) rate * THROTTLE_BURST_NS / 1e9;
+    bucket->tokens   = bucket->capacity;
+}
+
+void token_bucket_refill(TOKEN_BUCKET* bucket, uint64_t elapsed_ns)
+{
+    bucket->tokens += bucket->rate * elapsed_ns / 1e9;
+    if (bucket->tokens > bucket->capacity) bucket->tokens = bucket->capacity;
+}
+
+// Время до погашения долга.
+uint64_t token_bucket_wait_ns(const TOKEN_BUCKET* bucket)
+{
+    if (bucket->rate == 0.0 || bucket->tokens >= 0.0)
+    {
+        return 0U;
+    }
+
+    return (uint64_t) (-bucket->tokens / bucket->rate * 1e9) + 1U;
+}
+
+typedef struct
+{
+    TOKEN_BUCKET bandwidth;
+    TOKEN_BUCKET iops;
+    uint64_t last_refill_ns;
+
+    // Порог задержки завершения запроса. 0 - без адаптации глубины очереди.
+    uint64_t latency_threshold_ns;
+
+    // Допустимое количество одновременно выполняющихся запросов.
+    uint32_t max_depth;
+    uint32_t depth;
+    // Количество завершений с момента последнего изменения глубины.
+    uint32_t num_completions;
+
+    // Статистика.
+    uint32_t min_depth;
+    uint64_t num_backoffs;
+    uint64_t throttled_ns;
+} THROTTLE;
+
+void throttle_init(THROTTLE* throttle, uint64_t bytes_per_sec, uint64_t ops_per_sec,
+                   uint32_t max_depth, uint64_t latency_threshold_ns)
+{
+    token_bucket_init(&throttle->bandwidth, bytes_per_sec);
+    token_bucket_init(&throttle->iops, ops_per_sec);
+    throttle->last_refill_ns = time_ns();
+
+    throttle->latency_threshold_ns = latency_threshold_ns;
+
+    throttle->max_depth       = max_depth;
+    throttle->depth           = max_depth;
+    throttle->num_completions = 0U;
+
+    throttle->min_depth    = max_depth;
+    throttle->num_backoffs = 0U;
+    throttle->throttled_ns = 0U;
+}
+
+// Вызывается перед передачей запроса ядру. Блокирует поток, пока скорость превышена.
+void throttle_acquire(THROTTLE* throttle, size_t bytes)
+{
+    while (true)
+    {
+        uint64_t now = time_ns();
+        token_bucket_refill(&throttle->bandwidth, now - throttle->last_refill_ns);
+        token_bucket_refill(&throttle->iops,      now - throttle->last_refill_ns);
+        throttle->last_refill_ns = now;
+
+        uint64_t wait_bandwidth = token_bucket_wait_ns(&throttle->bandwidth);
+        uint64_t wait_iops      = token_bucket_wait_ns(&throttle->iops);
+        uint64_t wait_ns = (wait_bandwidth > wait_iops)? wait_bandwidth : wait_iops;
+        if (wait_ns == 0U)
+        {
+            break;
+        }
+
+        struct timespec pause =
+        {
+            .tv_sec  = wait_ns / 1000000000U,
+            .tv_nsec = wait_ns % 1000000000U
+        };
+        nanosleep(&pause, NULL);
+
+        throttle->throttled_ns += wait_ns;
+    }
+
+    throttle->bandwidth.tokens -= bytes;
+    throttle->iops.tokens      -= 1.0;
+}
+
+// Вызывается при завершении запроса с измеренной задержкой.
+void throttle_complete(THROTTLE* throttle, uint64_t latency_ns)
+{
+    if (throttle->latency_threshold_ns == 0U)
+    {
+        return;
+    }
+
+    throttle->num_completions += 1U;
+
+    if (latency_ns > throttle->latency_threshold_ns)
+    {
+        // Уменьшаем глубину не чаще раза за "поколение" запросов:
+        // запросы, отправленные до уменьшения, ещё завершаются с высокой задержкой.
+        if (throttle->num_completions >= throttle->depth && throttle->depth > 1U)
+        {
+            throttle->depth /= 2U;
+            throttle->num_backoffs += 1U;
+
+            if (throttle->depth < throttle->min_depth) throttle->min_depth = throttle->depth;
+        }
+
+        if (throttle->num_completions >= throttle->depth)
+        {
+            throttle->num_completions = 0U;
+        }
+    }
+    else if (throttle->num_completions >= throttle->depth && throttle->depth < throttle->max_depth)
+    {
+        // Поколение запросов завершилось без превышения порога.
+        throttle->depth += 1U;
+        throttle->num_completions = 0U;
+    }
+}
+
+uint32_t throttle_depth(const THROTTLE* throttle)
+{
+    return throttle->depth;
+}
+
+void throttle_report(const THROTTLE* throttle)
+{
+    printf("Throttled: %.3f sec\n", throttle->throttled_ns / 1e9);
+    printf("Queue depth backoffs: %lu (min depth %u of %u)\n",
+        throttle->num_backoffs, throttle->min_depth, throttle->max_depth);
+}
+
+//=========================
+// Телеметрия ввода-вывода
+//=========================
+// Позволяет понять, что ограничивает скорость копирования: устройство, глубина очереди
+// или цикл обработки завершений.
+// - Задержка submit->complete каждой операции записывается в лог-линейную гистограмму
+//   отдельно для чтений и записей (как в HdrHistogram: 16 линейных корзин на каждую
+//   степень двойки, относительная погрешность не более 6%).
+// - Глубина очереди (число выполняющихся запросов) усредняется по времени.
+// - Для пачек завершений измеряется время их обработки программой.
+// - Накладные расходы телеметрии оцениваются по измеренной стоимости чтения часов
+//   и записи в гистограмму.
+
+#define LATENCY_HISTOGRAM_SUB_BITS    4U
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1U << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_NUM_BUCKETS ((64U - LATENCY_HISTOGRAM_SUB_BITS + 1U) * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct
+{
+    uint64_t counts[LATENCY_HISTOGRAM_NUM_BUCKETS];
+
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} LATENCY_HISTOGRAM;
+
+uint32_t latency_histogram_bucket(uint64_t value)
+{
+    if (value < LATENCY_HISTOGRAM_SUB_BUCKETS)
+    {
+        return value;
+    }
+
+    // Старший бит определяет группу, следующие SUB_BITS бит - корзину внутри группы.
+    uint32_t exponent = 63U - __builtin_clzll(value);
+    uint32_t group    = exponent - LATENCY_HISTOGRAM_SUB_BITS + 1U;
+    uint32_t sub      = (value >> (exponent - LATENCY_HISTOGRAM_SUB_BITS)) - LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+    return group * LATENCY_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+// Середина диапазона значений, попадающих в корзину.
+uint64_t latency_histogram_bucket_value(uint32_t bucket)
+{
+    uint32_t group = bucket / LATENCY_HISTOGRAM_SUB_BUCKETS;
+    uint32_t sub   = bucket % LATENCY_HISTOGRAM_SUB_BUCKETS;
+
+    if (group == 0U)
+    {
+        return sub;
+    }
+
+    uint32_t shift = group - 1U;
+    uint64_t lower = (uint64_t) (LATENCY_HISTOGRAM_SUB_BUCKETS + sub) << shift;
+
+    return lower + ((1ULL << shift) >> 1U);
+}
+
+void latency_histogram_record(LATENCY_HISTOGRAM* histogram, uint64_t value_ns)
+{
+    histogram->counts[latency_histogram_bucket(value_ns)] += 1U;
+
+    histogram->count  += 1U;
+    histogram->sum_ns += value_ns;
+    if (value_ns > histogram->max_ns) histogram->max_ns = value_ns;
+}
+
+uint64_t latency_histogram_percentile(const LATENCY_HISTOGRAM* histogram, double percentile)
+{
+    if (histogram->count == 0U)
+    {
+        return 0U;
+    }
+
+    uint64_t rank = (uint64_t) (percentile / 100.0 * histogram->count);
+    if (rank == 0U) rank = 1U;
+
+    uint64_t cumulative = 0U;
+    for (uint32_t bucket = 0U; bucket < LATENCY_HISTOGRAM_NUM_BUCKETS; ++bucket)
+    {
+        cumulative += histogram->counts[bucket];
+        if (cumulative >= rank)
+        {
+            uint64_t value = latency_histogram_bucket_value(bucket);
+            return (value < histogram->max_ns)? value : histogram->max_ns;
+        }
+    }
+
+    return histogram->max_ns;
+}
+
+void latency_histogram_merge(LATENCY_HISTOGRAM* dst, const LATENCY_HISTOGRAM* src)
+{
+    for (uint32_t bucket = 0U; bucket < LATENCY_HISTOGRAM_NUM_BUCKETS; ++bucket)
+    {
+        dst->counts[bucket] += src->counts[bucket];
+    }
+
+    dst->count  += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->max_ns > dst->max_ns) dst->max_ns = src->max_ns;
+}
+
+typedef enum
+{
+    IO_OP_READ  = 0,
+    IO_OP_WRITE = 1,
+    IO_NUM_OPS  = 2
+} IO_OP;
+
+typedef struct
+{
+    bool enabled;
+
+    LATENCY_HISTOGRAM latency[IO_NUM_OPS];
+    uint64_t bytes_written;
+
+    // Глубина очереди: интеграл глубины по времени даёт среднюю глубину.
+    uint32_t depth;
+    uint32_t max_depth;
+    uint64_t depth_integral;
+    uint64_t last_depth_ns;
+
+    // Пачки завершений.
+    uint64_t num_batches;
+    uint64_t num_batch_completions;
+    uint64_t batch_ns;
+
+    // Периодический вывод строки JSON (0 - отключён).
+    uint64_t report_interval_ns;
+    uint64_t last_report_ns;
+    uint64_t last_report_bytes;
+    uint64_t last_report_depth_integral;
+
+    // Оценка накладных расходов.
+    uint64_t start_ns;
+    uint64_t num_clock_reads;
+    double clock_read_ns;
+    double record_ns;
+} IO_TELEMETRY;
+
+// Измеряет стоимость чтения часов и записи в гистограмму.
+void io_telemetry_calibrate(IO_TELEMETRY* telemetry)
+{
+    const uint32_t num_iters = 1U << 16U;
+
+    volatile uint64_t sink = 0U;
+
+    LATENCY_HISTOGRAM* scratch = calloc(1U, sizeof(LATENCY_HISTOGRAM));
+    if (scratch == NULL)
+    {
+        fprintf(stderr, "Unable to allocate latency histogram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Первый проход прогревает кеши и отображает страницы, измеряется второй.
+    for (unsigned pass = 0U; pass < 2U; ++pass)
+    {
+        uint64_t start = time_ns();
+        for (uint32_t i = 0U; i < num_iters; ++i)
+        {
+            sink += time_ns();
+        }
+
+        telemetry->clock_read_ns = (double) (time_ns() - start) / num_iters;
+
+        start = time_ns();
+        for (uint32_t i = 0U; i < num_iters; ++i)
+        {
+            latency_histogram_record(scratch, (i * 2654435761U) % 1000000U + sink % 2U);
+        }
+
+        telemetry->record_ns = (double) (time_ns() - start) / num_iters;
+    }
+
+    free(scratch);
+}
+
+void io_telemetry_init(IO_TELEMETRY* telemetry, bool enabled, uint64_t report_interval_ns)
+{
+    memset(telemetry, 0, sizeof(IO_TELEMETRY));
+
+    telemetry->enabled = enabled;
+    if (!enabled)
+    {
+        return;
+    }
+
+    io_telemetry_calibrate(telemetry);
+
+    telemetry->report_interval_ns = report_interval_ns;
+    telemetry->start_ns           = time_ns();
+    telemetry->last_depth_ns      = telemetry->start_ns;
+    telemetry->last_report_ns     = telemetry->start_ns;
+}
+
+void io_telemetry_set_depth(IO_TELEMETRY* telemetry, uint64_t now, int32_t delta)
+{
+    telemetry->depth_integral += (uint64_t) telemetry->depth * (now - telemetry->last_depth_ns);
+    telemetry->last_depth_ns   = now;
+
+    telemetry->depth += delta;
+    if (telemetry->depth > telemetry->max_depth) telemetry->max_depth = telemetry->depth;
+}
+
+void io_telemetry_json(IO_TELEMETRY* telemetry, uint64_t now)
+{
+    io_telemetry_set_depth(telemetry, now, 0);
+
+    uint64_t interval_ns = now - telemetry->last_report_ns;
+    uint64_t interval_bytes = telemetry->bytes_written - telemetry->last_report_bytes;
+    uint64_t interval_depth = telemetry->depth_integral - telemetry->last_report_depth_integral;
+
+    printf("{\"time_ms\": %lu, \"bytes\": %lu, \"bandwidth_mbs\": %.1f, \"depth\": %u, \"avg_depth\": %.2f, "
+           "\"reads\": %lu, \"read_p99_us\": %.1f, \"writes\": %lu, \"write_p99_us\": %.1f}\n",
+        (now - telemetry->start_ns) / 1000000U,
+        telemetry->bytes_written,
+        interval_bytes * 1e3 / interval_ns,
+        telemetry->depth,
+        (double) interval_depth / interval_ns,
+        telemetry->latency[IO_OP_READ].count,
+        latency_histogram_percentile(&telemetry->latency[IO_OP_READ], 99.0) / 1e3,
+        telemetry->latency[IO_OP_WRITE].count,
+        latency_histogram_percentile(&telemetry->latency[IO_OP_WRITE], 99.0) / 1e3);
+
+    telemetry->last_report_ns             = now;
+    telemetry->last_report_bytes          = telemetry->bytes_written;
+    telemetry->last_report_depth_integral = telemetry->depth_integral;
+}
+
+// Вызывается при передаче запроса ядру. Возвращает момент передачи.
+uint64_t io_telemetry_submit(IO_TELEMETRY* telemetry)
+{
+    uint64_t now = time_ns();
+
+    if (telemetry->enabled)
+    {
+        telemetry->num_clock_reads += 1U;
+        io_telemetry_set_depth(telemetry, now, +1);
+    }
+
+    return now;
+}
+
+// Вызывается при передаче ядру пачки запросов одним системным вызовом.
+// Часы читаются один раз: момент передачи общий для всей пачки.
+uint64_t io_telemetry_submit_batch(IO_TELEMETRY* telemetry, uint32_t num_requests)
+{
+    uint64_t now = time_ns();
+
+    if (telemetry->enabled)
+    {
+        telemetry->num_clock_reads += 1U;
+        io_telemetry_set_depth(telemetry, now, (int32_t) num_requests);
+    }
+
+    return now;
+}
+
+// Вызывается при завершении запроса. Возвращает задержку его выполнения.
+uint64_t io_telemetry_complete(IO_TELEMETRY* telemetry, IO_OP op, uint64_t submit_ns, size_t bytes)
+{
+    uint64_t now = time_ns();
+    uint64_t latency_ns = now - submit_ns;
+
+    if (!telemetry->enabled)
+    {
+        return latency_ns;
+    }
+
+    telemetry->num_clock_reads += 1U;
+
+    latency_histogram_record(&telemetry->latency[op], latency_ns);
+    io_telemetry_set_depth(telemetry, now, -1);
+
+    if (op == IO_OP_WRITE)
+    {
+        telemetry->bytes_written += bytes;
+    }
+
+    if (telemetry->report_interval_ns != 0U && now - telemetry->last_report_ns >= telemetry->report_interval_ns)
+    {
+        io_telemetry_json(telemetry, now);
+    }
+
+    return latency_ns;
+}
+
+// Начало обработки пачки завершений (после возврата из ожидания).
+uint64_t io_telemetry_batch_begin(IO_TELEMETRY* telemetry)
+{
+    if (!telemetry->enabled)
+    {
+        return 0U;
+    }
+
+    telemetry->num_clock_reads += 1U;
+    return time_ns();
+}
+
+void io_telemetry_batch_end(IO_TELEMETRY* telemetry, uint64_t batch_start_ns, uint32_t num_completions)
+{
+    if (!telemetry->enabled)
+    {
+        return;
+    }
+
+    telemetry->num_clock_reads += 1U;
+
+    telemetry->num_batches           += 1U;
+    telemetry->num_batch_completions += num_completions;
+    telemetry->batch_ns              += time_ns() - batch_start_ns;
+}
+
+// Объединение телеметрии отдельных потоков.
+// Интегралы глубины складываются: средняя глубина - суммарная по всем потокам.
+// Максимумы глубины достигались в разные моменты, поэтому берётся наибольший из них.
+void io_telemetry_merge(IO_TELEMETRY* dst, const IO_TELEMETRY* src)
+{
+    for (unsigned op = 0U; op < IO_NUM_OPS; ++op)
+    {
+        latency_histogram_merge(&dst->latency[op], &src->latency[op]);
+    }
+
+    dst->bytes_written  += src->bytes_written;
+    dst->max_depth       = (src->max_depth > dst->max_depth)? src->max_depth : dst->max_depth;
+    dst->depth_integral += src->depth_integral;
+
+    dst->num_batches           += src->num_batches;
+    dst->num_batch_completions += src->num_batch_completions;
+    dst->batch_ns              += src->batch_ns;
+
+    dst->num_clock_reads += src->num_clock_reads;
+}
+
+void io_telemetry_report(IO_TELEMETRY* telemetry)
+{
+    if (!telemetry->enabled)
+    {
+        return;
+    }
+
+    uint64_t now = time_ns();
+    uint64_t elapsed_ns = now - telemetry->start_ns;
+
+    io_telemetry_set_depth(telemetry, now, 0);
+
+    static const char* op_names[IO_NUM_OPS] = {"Read", "Write"};
+    for (unsigned op = 0U; op < IO_NUM_OPS; ++op)
+    {
+        const LATENCY_HISTOGRAM* histogram = &telemetry->latency[op];
+        if (histogram->count == 0U)
+        {
+            continue;
+        }
+
+        printf("%s latency (us): count=%lu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+            op_names[op], histogram->count,
+            (double) histogram->sum_ns / histogram->count / 1e3,
+            latency_histogram_percentile(histogram, 50.0) / 1e3,
+            latency_histogram_percentile(histogram, 90.0) / 1e3,
+            latency_histogram_percentile(histogram, 99.0) / 1e3,
+            latency_histogram_percentile(histogram, 99.9) / 1e3,
+            histogram->max_ns / 1e3);
+    }
+
+    printf("Queue depth: avg=%.2f max=%u\n", (double) telemetry->depth_integral / elapsed_ns, telemetry->max_depth);
+
+    if (telemetry->num_batches != 0U)
+    {
+        printf("Completion batches: %lu, avg %.2f completions, %.0f ns/batch, %.0f ns/completion\n",
+            telemetry->num_batches,
+            (double) telemetry->num_batch_completions / telemetry->num_batches,
+            (double) telemetry->batch_ns / telemetry->num_batches,
+            (double) telemetry->batch_ns / telemetry->num_batch_completions);
+    }
+
+    uint64_t num_records = telemetry->latency[IO_OP_READ].count + telemetry->latency[IO_OP_WRITE].count;
+    double overhead_ns = telemetry->num_clock_reads * telemetry->clock_read_ns + num_records * telemetry->record_ns;
+
+    printf("Telemetry overhead: %lu clock reads x %.1f ns + %lu records x %.1f ns = %.3f ms (%.2f%% of run)\n",
+        telemetry->num_clock_reads, telemetry->clock_read_ns, num_records, telemetry->record_ns,
+        overhead_ns / 1e6, 100.0 * overhead_ns / elapsed_ns);
+}
+
 #endif // MSUSEM_ASYNC_IO
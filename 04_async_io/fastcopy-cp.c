@@ -0,0 +1,102 @@
+// Copyright 2025, Vladislav Aleinik
+#include "common.h"
+#include "fastcopy.h"
+
+//=================================
+// Параметры процедуры копирования
+//=================================
+
+#define BLOCK_SIZE (128U << 10U)
+
+//=====================
+// Индикация прогресса
+//=====================
+
+typedef struct
+{
+    uint32_t file_size;
+    _Atomic uint64_t bytes_copied;
+} PROGRESS;
+
+void on_progress(void* arg, off_t, size_t size)
+{
+    PROGRESS* progress = (PROGRESS*) arg;
+    atomic_fetch_add_explicit(&progress->bytes_copied, size, memory_order_relaxed);
+}
+
+void on_complete(void* arg, int status)
+{
+    PROGRESS* progress = (PROGRESS*) arg;
+
+    if (status != 0)
+    {
+        fprintf(stderr, "Copy failed: errno=%i (%s)\n", -status, strerror(-status));
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Copied: %lu of %u bytes\n", atomic_load(&progress->bytes_copied), progress->file_size);
+}
+
+//=======================
+// Процедура копирования
+//=======================
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        fprintf(stderr, "Usage: fastcopy-cp <src> <dst> [sync|kernel]");
+        exit(EXIT_FAILURE);
+    }
+
+    // Открываем исходный файл и определяем его размер.
+    int src_fd;
+    uint32_t src_size;
+    open_src_file(argv[1], &src_fd, &src_size);
+
+    // Открываем результирующий файл и аллоцируем место на диске.
+    int dst_fd;
+    open_dst_file(argv[2], &dst_fd, src_size, true, false);
+
+    // Выбираем движок: явно указанный пользователем или самый быстрый из доступных.
+    const FASTCOPY_ENGINE* engine = (argc == 4)? fastcopy_engine_by_name(argv[3]) : fastcopy_probe(src_fd, dst_fd);
+    if (engine == NULL)
+    {
+        fprintf(stderr, "Unknown copy engine '%s'\n", argv[3]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!engine->probe(src_fd, dst_fd))
+    {
+        fprintf(stderr, "Copy engine '%s' is not available\n", engine->name);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Copy engine: %s\n", engine->name);
+
+    PROGRESS progress = {.file_size = src_size, .bytes_copied = 0U};
+
+    FASTCOPY_OPTIONS opts =
+    {
+        .engine      = engine,
+        .block_size  = BLOCK_SIZE,
+        .on_progress = on_progress,
+        .on_complete = on_complete,
+        .arg         = &progress
+    };
+
+    // Копирование выполняется в фоновом потоке.
+    FASTCOPY_FUTURE* future = fastcopy_copy_range_async(src_fd, dst_fd, 0, src_size, &opts);
+    if (future == NULL)
+    {
+        fprintf(stderr, "Unable to start copy\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fastcopy_wait(future);
+
+    // Закрываем файлы.
+    close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,375 @@
+// Copyright 2025, Vladislav Aleinik
+#define _GNU_SOURCE
+
+#include "fastcopy.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+//========================
+// Параметры по умолчанию
+//========================
+
+#define FASTCOPY_DEFAULT_BLOCK_SIZE (128U << 10U)
+
+// Выравнивание буферов, достаточное для O_DIRECT.
+#define FASTCOPY_ALIGNMENT 4096U
+
+//====================
+// Общие подпрограммы
+//====================
+// В отличие от программ 04_async_io, библиотека не завершает процесс при ошибке,
+// а возвращает код -errno вызывающей стороне.
+
+typedef struct
+{
+    uint32_t block_size;
+
+    // Результирующий файл открыт с O_DIRECT.
+    bool dst_direct;
+
+    const FASTCOPY_OPTIONS* opts;
+} FASTCOPY_PARAMS;
+
+static bool fd_is_direct(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    return flags != -1 && (flags & O_DIRECT) != 0;
+}
+
+static int init_params(FASTCOPY_PARAMS* params, int dst_fd, const FASTCOPY_OPTIONS* opts)
+{
+    params->block_size = FASTCOPY_DEFAULT_BLOCK_SIZE;
+    params->dst_direct = fd_is_direct(dst_fd);
+    params->opts       = opts;
+
+    if (opts != NULL && opts->block_size != 0U) params->block_size = opts->block_size;
+
+    if (params->block_size % FASTCOPY_ALIGNMENT != 0U)
+    {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+static uint8_t* alloc_buffers(const FASTCOPY_PARAMS* params, size_t num_buffers)
+{
+    return (uint8_t*) aligned_alloc(FASTCOPY_ALIGNMENT, num_buffers * params->block_size);
+}
+
+static void report_progress(const FASTCOPY_PARAMS* params, off_t offset, size_t size)
+{
+    if (params->opts != NULL && params->opts->on_progress != NULL)
+    {
+        params->opts->on_progress(params->opts->arg, offset, size);
+    }
+}
+
+// Размер блока для чтения с диапазона: чтение всегда производится целым блоком,
+// что допустимо для O_DIRECT. Результат ограничивается границей диапазона.
+static size_t block_bytes_left(const FASTCOPY_PARAMS* params, off_t block_offset, off_t end)
+{
+    off_t bytes_left = end - block_offset;
+
+    return (bytes_left < (off_t) params->block_size)? (size_t) bytes_left : params->block_size;
+}
+
+// Размер записи: при O_DIRECT неполный блок дописывается нулями до выровненного размера.
+static size_t block_write_size(const FASTCOPY_PARAMS* params, uint8_t* buffer, size_t size)
+{
+    if (!params->dst_direct)
+    {
+        return size;
+    }
+
+    size_t write_size = (size + FASTCOPY_ALIGNMENT - 1U) / FASTCOPY_ALIGNMENT * FASTCOPY_ALIGNMENT;
+    memset(buffer + size, 0, write_size - size);
+
+    return write_size;
+}
+
+// Копирует один блок с помощью pread/pwrite.
+// Возвращает количество скопированных байт (0 - конец файла) или -errno.
+// После короткого чтения следующий блок начинается с конца скопированных данных.
+static ssize_t copy_block_sync(const FASTCOPY_PARAMS* params, int src_fd, int dst_fd,
+                               uint8_t* buffer, off_t offset, off_t end)
+{
+    ssize_t bytes_read = pread(src_fd, buffer, params->block_size, offset);
+    if (bytes_read == -1)
+    {
+        return -errno;
+    }
+
+    size_t size = block_bytes_left(params, offset, end);
+    if ((size_t) bytes_read < size) size = bytes_read;
+
+    if (size == 0U)
+    {
+        return 0;
+    }
+
+    size_t write_size = block_write_size(params, buffer, size);
+
+    ssize_t bytes_written = pwrite(dst_fd, buffer, write_size, offset);
+    if (bytes_written == -1)
+    {
+        return -errno;
+    }
+
+    if ((size_t) bytes_written != write_size)
+    {
+        return -EIO;
+    }
+
+    report_progress(params, offset, size);
+
+    return size;
+}
+
+//=================================
+// Движок: синхронный pread/pwrite
+//=================================
+
+static bool sync_probe(int, int)
+{
+    return true;
+}
+
+static int sync_copy_range(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts)
+{
+    FASTCOPY_PARAMS params;
+    int ret = init_params(&params, dst_fd, opts);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    uint8_t* buffer = alloc_buffers(&params, 1U);
+    if (buffer == NULL)
+    {
+        return -ENOMEM;
+    }
+
+    off_t end = offset + size;
+    for (off_t block = offset; block < end;)
+    {
+        ssize_t copied = copy_block_sync(&params, src_fd, dst_fd, buffer, block, end);
+        if (copied <= 0)
+        {
+            ret = copied;
+            break;
+        }
+
+        block += copied;
+    }
+
+    free(buffer);
+
+    return ret;
+}
+
+//===========================================
+// Движок: копирование силами ядра (offload)
+//===========================================
+// copy_file_range() позволяет ФС скопировать данные без передачи через user-space:
+// reflink (btrfs, XFS), серверное копирование (NFS 4.2, SMB) или splice внутри ядра.
+
+static bool kernel_probe(int src_fd, int dst_fd)
+{
+    // Ускорение достигается только в пределах одной ФС.
+    struct stat src_stat, dst_stat;
+    if (fstat(src_fd, &src_stat) == -1 || fstat(dst_fd, &dst_stat) == -1)
+    {
+        return false;
+    }
+
+    if (src_stat.st_dev != dst_stat.st_dev)
+    {
+        return false;
+    }
+
+    // Проверяем наличие системного вызова.
+    return copy_file_range(src_fd, NULL, dst_fd, NULL, 0U, 0U) != -1 || errno != ENOSYS;
+}
+
+static int kernel_copy_range(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts)
+{
+    FASTCOPY_PARAMS params;
+    int ret = init_params(&params, dst_fd, opts);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    for (size_t done = 0U; done < size;)
+    {
+        loff_t src_off = offset + done;
+        loff_t dst_off = offset + done;
+
+        ssize_t copied = copy_file_range(src_fd, &src_off, dst_fd, &dst_off, size - done, 0U);
+        if (copied == -1)
+        {
+            if (errno == EINTR) continue;
+
+            // Ядро может отказаться копировать остаток диапазона: например, невыровненный
+            // хвост файла, открытого с O_DIRECT, или пару ФС без поддержки копирования.
+            // Остаток копируется через промежуточный буфер.
+            if (errno == EINVAL || errno == EXDEV || errno == EOPNOTSUPP)
+            {
+                return sync_copy_range(src_fd, dst_fd, offset + done, size - done, opts);
+            }
+
+            return -errno;
+        }
+
+        if (copied == 0)
+        {   // Достигнут конец исходного файла.
+            break;
+        }
+
+        report_progress(&params, offset + done, copied);
+        done += copied;
+    }
+
+    return 0;
+}
+
+//==============
+// Выбор движка
+//==============
+
+static const FASTCOPY_ENGINE fastcopy_engines[FASTCOPY_NUM_ENGINES] =
+{
+    [FASTCOPY_ENGINE_SYNC]   = {FASTCOPY_ENGINE_SYNC,   "sync",   sync_probe,   sync_copy_range},
+    [FASTCOPY_ENGINE_KERNEL] = {FASTCOPY_ENGINE_KERNEL, "kernel", kernel_probe, kernel_copy_range}
+};
+
+// Порядок предпочтения движков: от самого быстрого к самому медленному.
+static const FASTCOPY_ENGINE_ID fastcopy_preference[FASTCOPY_NUM_ENGINES] =
+{
+    FASTCOPY_ENGINE_KERNEL,
+    FASTCOPY_ENGINE_SYNC
+};
+
+const FASTCOPY_ENGINE* fastcopy_engine(FASTCOPY_ENGINE_ID id)
+{
+    return (id < FASTCOPY_NUM_ENGINES)? &fastcopy_engines[id] : NULL;
+}
+
+const FASTCOPY_ENGINE* fastcopy_engine_by_name(const char* name)
+{
+    for (size_t i = 0U; i < FASTCOPY_NUM_ENGINES; ++i)
+    {
+        if (strcmp(fastcopy_engines[i].name, name) == 0)
+        {
+            return &fastcopy_engines[i];
+        }
+    }
+
+    return NULL;
+}
+
+const FASTCOPY_ENGINE* fastcopy_probe(int src_fd, int dst_fd)
+{
+    for (size_t i = 0U; i < FASTCOPY_NUM_ENGINES; ++i)
+    {
+        const FASTCOPY_ENGINE* engine = &fastcopy_engines[fastcopy_preference[i]];
+        if (engine->probe(src_fd, dst_fd))
+        {
+            return engine;
+        }
+    }
+
+    return &fastcopy_engines[FASTCOPY_ENGINE_SYNC];
+}
+
+//=======================
+// Копирование диапазона
+//=======================
+
+int fastcopy_copy_range(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts)
+{
+    const FASTCOPY_ENGINE* engine = (opts != NULL && opts->engine != NULL)?
+        opts->engine : fastcopy_probe(src_fd, dst_fd);
+
+    int ret = engine->copy_range(src_fd, dst_fd, offset, size, opts);
+
+    if (opts != NULL && opts->on_complete != NULL)
+    {
+        opts->on_complete(opts->arg, ret);
+    }
+
+    return ret;
+}
+
+struct FASTCOPY_FUTURE
+{
+    pthread_t tid;
+
+    int src_fd;
+    int dst_fd;
+    off_t offset;
+    size_t size;
+
+    bool has_opts;
+    FASTCOPY_OPTIONS opts;
+
+    int result;
+};
+
+static void* fastcopy_future_func(void* arg)
+{
+    FASTCOPY_FUTURE* future = (FASTCOPY_FUTURE*) arg;
+
+    future->result = fastcopy_copy_range(future->src_fd, future->dst_fd, future->offset, future->size,
+                                         future->has_opts? &future->opts : NULL);
+
+    return NULL;
+}
+
+FASTCOPY_FUTURE* fastcopy_copy_range_async(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts)
+{
+    FASTCOPY_FUTURE* future = calloc(1U, sizeof(FASTCOPY_FUTURE));
+    if (future == NULL)
+    {
+        return NULL;
+    }
+
+    future->src_fd   = src_fd;
+    future->dst_fd   = dst_fd;
+    future->offset   = offset;
+    future->size     = size;
+    future->has_opts = opts != NULL;
+
+    if (opts != NULL)
+    {
+        future->opts = *opts;
+    }
+
+    if (pthread_create(&future->tid, NULL, fastcopy_future_func, future) != 0)
+    {
+        free(future);
+        return NULL;
+    }
+
+    return future;
+}
+
+int fastcopy_wait(FASTCOPY_FUTURE* future)
+{
+    pthread_join(future->tid, NULL);
+
+    int result = future->result;
+    free(future);
+
+    return result;
+}
@@ -0,0 +1,87 @@
+// Copyright 2025, Vladislav Aleinik
+#ifndef MSUSEM_FASTCOPY
+#define MSUSEM_FASTCOPY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <sys/types.h>
+
+//============================================
+// libfastcopy: копирование диапазонов файлов
+//============================================
+// Библиотека предоставляет единый интерфейс копирования с выбором движка во время исполнения.
+// Движки на основе пула потоков, POSIX AIO, Linux AIO и io_uring реализованы в программах
+// 04_async_io (*-cp.c) вместе с их телеметрией и режимами копирования и в библиотеке не дублируются.
+// Диапазон [offset, offset + size) исходного файла копируется в тот же диапазон
+// результирующего файла. Файлы открывает и закрывает вызывающая сторона.
+//
+// NOTE: если результирующий файл открыт с O_DIRECT, неполный последний блок
+//       дописывается нулями до размера блока, и вызывающая сторона должна
+//       обрезать файл до нужного размера (ftruncate).
+
+typedef enum
+{
+    FASTCOPY_ENGINE_SYNC   = 0, // pread/pwrite в одном потоке.
+    FASTCOPY_ENGINE_KERNEL = 1, // Копирование силами ядра (copy_file_range).
+    FASTCOPY_NUM_ENGINES   = 2
+} FASTCOPY_ENGINE_ID;
+
+typedef struct FASTCOPY_ENGINE FASTCOPY_ENGINE;
+
+typedef struct
+{
+    // Движок копирования. NULL - выбрать самый быстрый из доступных (fastcopy_probe).
+    const FASTCOPY_ENGINE* engine;
+
+    // Размер блока копирования (кратен 4096). 0 - значение по умолчанию.
+    uint32_t block_size;
+
+    // Вызывается по окончании копирования каждого блока.
+    void (*on_progress)(void* arg, off_t offset, size_t size);
+    // Вызывается по окончании копирования диапазона с кодом возврата (0 или -errno).
+    void (*on_complete)(void* arg, int status);
+    void* arg;
+} FASTCOPY_OPTIONS;
+
+struct FASTCOPY_ENGINE
+{
+    FASTCOPY_ENGINE_ID id;
+    const char* name;
+
+    // Проверяет, доступен ли движок на текущем ядре для данной пары файлов.
+    bool (*probe)(int src_fd, int dst_fd);
+
+    // Копирует диапазон. Возвращает 0 или -errno.
+    int (*copy_range)(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts);
+};
+
+//==============
+// Выбор движка
+//==============
+
+const FASTCOPY_ENGINE* fastcopy_engine(FASTCOPY_ENGINE_ID id);
+
+// Возвращает NULL, если движка с таким именем нет.
+const FASTCOPY_ENGINE* fastcopy_engine_by_name(const char* name);
+
+// Возвращает самый быстрый движок, доступный для данной пары файлов.
+const FASTCOPY_ENGINE* fastcopy_probe(int src_fd, int dst_fd);
+
+//=======================
+// Копирование диапазона
+//=======================
+
+// Синхронное копирование. Возвращает 0 или -errno.
+int fastcopy_copy_range(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts);
+
+// Асинхронное копирование в фоновом потоке.
+// Результат ожидается с помощью fastcopy_wait(), который освобождает FASTCOPY_FUTURE.
+typedef struct FASTCOPY_FUTURE FASTCOPY_FUTURE;
+
+FASTCOPY_FUTURE* fastcopy_copy_range_async(int src_fd, int dst_fd, off_t offset, size_t size, const FASTCOPY_OPTIONS* opts);
+
+int fastcopy_wait(FASTCOPY_FUTURE* future);
+
+#endif // MSUSEM_FASTCOPY
@@ -1,5 +1,6 @@
 // Copyright 2025, Vladislav Aleinik
 #include "common.h"
+#include "checksum.h"
 
 #include <memory.h>
 #include <liburing.h>
@@ -11,6 +12,47 @@
 #define READ_BLOCK_SIZE 4096U
 #define QUEUE_SIZE 16U
 
+// Запись в обход страничного кеша (O_DIRECT на обоих концах копирования).
+// Запись всегда производится целыми блоками, лишнее отрезается ftruncate().
+#define ENABLE_DIRECT_IO 0
+
+// Подсчёт контрольной суммы копируемых данных "на лету".
+#define ENABLE_CHECKSUM 0
+// Повторное чтение записанного файла и сравнение контрольных сумм.
+#define ENABLE_VERIFY   0
+
+// Копирование только отрезков с данными (SEEK_DATA/SEEK_HOLE) с сохранением "дыр".
+#define ENABLE_SPARSE_COPY 1
+// Пропуск записи нулевых блоков внутри отрезков с данными.
+#define ENABLE_ZERO_PUNCH  0
+
+// Постепенный сброс записанных данных на диск окнами фиксированного размера.
+#define ENABLE_WRITEBACK      0
+#define WRITEBACK_WINDOW_SIZE (8U << 20U)
+
+// Фоновый режим: копирование не должно мешать другим нагрузкам на те же диски.
+#define ENABLE_BACKGROUND_MODE 0
+// Класс приоритета запросов: IOPRIO_CLASS_IDLE или IOPRIO_CLASS_BE (с уровнем 0-7).
+#define BACKGROUND_IOPRIO      IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+// Ограничение скорости копирования (байт/с) и количества запросов в секунду. 0 - без ограничения.
+#define THROTTLE_BANDWIDTH     (64U << 20U)
+#define THROTTLE_IOPS          0U
+// Порог задержки завершения запроса, при превышении которого глубина очереди уменьшается.
+#define THROTTLE_LATENCY_NS    (5U * 1000U * 1000U)
+
+// Гистограммы задержек операций, глубина очереди и стоимость обработки пачек завершений.
+#define ENABLE_TELEMETRY       0
+// Период вывода строки JSON с текущими показателями (0 - только итоговая сводка).
+#define TELEMETRY_INTERVAL_NS  0U
+
+// Задержка запросов измеряется для фонового режима и для телеметрии.
+#define MEASURE_LATENCY        (ENABLE_BACKGROUND_MODE || ENABLE_TELEMETRY)
+
+// Идентификатор запросов управления записью (не совпадает с номерами ячеек).
+#define WRITEBACK_CELL QUEUE_SIZE
+// Максимальное число запросов управления записью на одно окно.
+#define WRITEBACK_SQES 3U
+
 //====================
 // Статус копирования
 //====================
@@ -28,6 +70,9 @@ struct BlockStatus
 
     off64_t offset;
     uint32_t size;
+
+    // Момент передачи запроса ядру (для измерения задержки).
+    uint64_t submit_ns;
 };
 
 // Состояние процесса копиования файла.
@@ -43,10 +88,30 @@ struct CopyStatus
 
     struct BlockStatus block_statuses[QUEUE_SIZE];
 
-    char* aligned_buffers;
-    struct iovec* fixed_buffers;
+    // Пул промежуточных буферов: по одному буферу на ячейку очереди.
+    BUFFER_POOL buffer_pool;
+    uint8_t* cell_buffers[QUEUE_SIZE];
 
     struct io_uring io_ring;
+
+    // Ячейки с подготовленными, но ещё не переданными ядру запросами.
+    unsigned pending_cells[QUEUE_SIZE];
+    unsigned num_pending;
+
+    FILE_DIGEST digest;
+
+    // Отрезки исходного файла, содержащие данные.
+    FILE_EXTENTS extents;
+
+    // Управление сбросом данных на диск.
+    WRITEBACK_CONTROLLER writeback;
+    uint16_t num_writeback_in_progress;
+
+    // Ограничение скорости и глубины очереди в фоновом режиме.
+    THROTTLE throttle;
+
+    // Телеметрия ввода-вывода.
+    IO_TELEMETRY telemetry;
 };
 
 void init_copying_status(struct CopyStatus* status, uint32_t src_size, int src_fd, int dst_fd)
@@ -57,6 +122,7 @@ void init_copying_status(struct CopyStatus* status, uint32_t src_size, int src_f
     status->src_size = src_size;
 
     status->num_block_in_progress = 0;
+    status->num_pending = 0;
 
     for (uint16_t i = 0; i < QUEUE_SIZE; ++i)
     {
@@ -65,27 +131,43 @@ void init_copying_status(struct CopyStatus* status, uint32_t src_size, int src_f
         status->block_statuses[i].size   = 0;
     }
 
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_init(&status->digest, src_size, READ_BLOCK_SIZE);
+    }
+
+    file_extents_scan(src_fd, src_size, READ_BLOCK_SIZE, ENABLE_SPARSE_COPY, &status->extents);
+
+    status->num_writeback_in_progress = 0;
+    if (ENABLE_WRITEBACK)
+    {
+        writeback_init(&status->writeback, dst_fd, &status->extents, WRITEBACK_WINDOW_SIZE);
+    }
+
+    throttle_init(&status->throttle, THROTTLE_BANDWIDTH, THROTTLE_IOPS, QUEUE_SIZE, THROTTLE_LATENCY_NS);
+    io_telemetry_init(&status->telemetry, ENABLE_TELEMETRY, TELEMETRY_INTERVAL_NS);
+
     // Инициализируем кольцевой буфер адресном в пространстве пользователя.
-    int init_ret = io_uring_queue_init(QUEUE_SIZE, &status->io_ring, 0U);
+    // Дополнительные места в очереди отводятся под запросы управления записью.
+    int init_ret = io_uring_queue_init(QUEUE_SIZE + WRITEBACK_SQES, &status->io_ring, 0U);
     if (init_ret != 0)
     {
         printf("Unable to initialize IO-ring: errno=%i (%s)", init_ret, strerror(init_ret));
         exit(EXIT_FAILURE);
     }
 
-    // Аллоцируем буферы для хранения промежуточных данных.
-    status->aligned_buffers = (char*) aligned_alloc(READ_BLOCK_SIZE, QUEUE_SIZE * READ_BLOCK_SIZE);
-
-    status->fixed_buffers = calloc(QUEUE_SIZE, sizeof(struct iovec));
+    // Получаем буферы для хранения промежуточных данных из пула.
+    buffer_pool_init(&status->buffer_pool, READ_BLOCK_SIZE, QUEUE_SIZE);
 
     for (unsigned i = 0; i < QUEUE_SIZE; ++i)
     {
-        status->fixed_buffers[i].iov_base = status->aligned_buffers + i * READ_BLOCK_SIZE;
-        status->fixed_buffers[i].iov_len  = READ_BLOCK_SIZE;
+        status->cell_buffers[i] = buffer_pool_acquire_or_die(&status->buffer_pool);
     }
 
     // Оповещаем ядро о расположении буферов.
-    if (io_uring_register_buffers(&status->io_ring, status->fixed_buffers, QUEUE_SIZE) != 0)
+    // Пул непрерывен, поэтому регистрируется один раз одним вектором с индексом 0.
+    struct iovec pool_iovec = buffer_pool_iovec(&status->buffer_pool);
+    if (io_uring_register_buffers(&status->io_ring, &pool_iovec, 1U) != 0)
     {
         printf("Unable to register intermediate buffers: errno=%i (%s)", errno, strerror(errno));
         exit(EXIT_FAILURE);
@@ -94,18 +176,70 @@ void init_copying_status(struct CopyStatus* status, uint32_t src_size, int src_f
 
 void free_copying_status(struct CopyStatus* status)
 {
-    free(status->aligned_buffers);
-    free(status->fixed_buffers);
+    for (unsigned i = 0; i < QUEUE_SIZE; ++i)
+    {
+        buffer_pool_release(&status->buffer_pool, status->cell_buffers[i]);
+    }
+
+    buffer_pool_free(&status->buffer_pool);
+    file_extents_free(&status->extents);
+
+    if (ENABLE_WRITEBACK)
+    {
+        writeback_free(&status->writeback);
+    }
+
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_free(&status->digest);
+    }
 }
 
 //=======================
 // Процедура копирования
 //=======================
 
+// Фиксирует момент передачи ядру для всех подготовленных запросов.
+// Вызывается непосредственно перед io_uring_submit(): ожидание в throttle_acquire()
+// не должно входить в задержку устройства.
+void stamp_pending_requests(struct CopyStatus* status)
+{
+    if (!MEASURE_LATENCY || status->num_pending == 0)
+    {
+        return;
+    }
+
+    uint64_t submit_ns = io_telemetry_submit_batch(&status->telemetry, status->num_pending);
+    for (unsigned i = 0; i < status->num_pending; ++i)
+    {
+        status->block_statuses[status->pending_cells[i]].submit_ns = submit_ns;
+    }
+
+    status->num_pending = 0;
+}
+
+struct io_uring_sqe* get_sqe(struct CopyStatus* status)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&status->io_ring);
+    if (sqe == NULL)
+    {
+        // Очередь запросов заполнена: передаём накопленные запросы ядру.
+        stamp_pending_requests(status);
+        io_uring_submit(&status->io_ring);
+
+        sqe = io_uring_get_sqe(&status->io_ring);
+    }
+
+    return sqe;
+}
+
 void prepare_read_request(struct CopyStatus* status, unsigned cell)
 {
     struct BlockStatus* block = &status->block_statuses[cell];
 
+    // Пропускаем "дыры" исходного файла.
+    status->src_off = file_extents_next(&status->extents, status->src_off);
+
     uint32_t bytes_left = status->src_size - status->src_off;
     if (bytes_left == 0)
     {
@@ -118,14 +252,27 @@ void prepare_read_request(struct CopyStatus* status, unsigned cell)
     block->size   = (bytes_left < READ_BLOCK_SIZE)? bytes_left : READ_BLOCK_SIZE;
 
     // Формируем запрос на чтение.
-    struct io_uring_sqe* read_sqe = io_uring_get_sqe(&status->io_ring);
+    struct io_uring_sqe* read_sqe = get_sqe(status);
 
     io_uring_prep_read_fixed(read_sqe, status->src_fd,
-                             status->fixed_buffers[cell].iov_base,
-                             READ_BLOCK_SIZE, block->offset, cell);
+                             status->cell_buffers[cell],
+                             READ_BLOCK_SIZE, block->offset, 0);
 
     read_sqe->user_data = cell;
 
+    // Понижаем приоритет запроса и соблюдаем ограничение скорости.
+    if (ENABLE_BACKGROUND_MODE)
+    {
+        read_sqe->ioprio = BACKGROUND_IOPRIO;
+
+        throttle_acquire(&status->throttle, block->size);
+    }
+
+    if (MEASURE_LATENCY)
+    {
+        status->pending_cells[status->num_pending++] = cell;
+    }
+
     // Обновляем состояни передачи.
     status->src_off += block->size;
     status->num_block_in_progress += 1;
@@ -133,6 +280,56 @@ void prepare_read_request(struct CopyStatus* status, unsigned cell)
     // printf("Cell#%02d:  read (off=%lu, size=%u)\n", cell, block->offset, block->size);
 }
 
+// Возвращает false, если блок не требуется записывать.
+bool finish_read_request(struct CopyStatus* status, unsigned cell)
+{
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    // Считаем контрольную сумму, пока блок находится в промежуточном буфере.
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_update(&status->digest, block->offset,
+                           status->cell_buffers[cell], block->size);
+    }
+
+    if (!ENABLE_ZERO_PUNCH || !block_is_zero(status->cell_buffers[cell], block->size))
+    {
+        return true;
+    }
+
+    // Нулевой блок не записываем: на его месте в файле останется "дыра".
+    if (!ENABLE_SPARSE_COPY)
+    {
+        punch_zero_block(status->dst_fd, block->offset, block->size);
+    }
+
+    return false;
+}
+
+// В фоновом режиме ячейка остаётся свободной, если превышена допустимая глубина очереди.
+void prepare_next_read_request(struct CopyStatus* status, unsigned cell)
+{
+    if (ENABLE_BACKGROUND_MODE && status->num_block_in_progress >= throttle_depth(&status->throttle))
+    {
+        return;
+    }
+
+    prepare_read_request(status, cell);
+}
+
+// Возобновляет работу свободных ячеек после увеличения допустимой глубины очереди.
+void resume_idle_cells(struct CopyStatus* status)
+{
+    for (unsigned cell = 0; cell < QUEUE_SIZE && status->src_off != status->src_size; ++cell)
+    {
+        if (status->block_statuses[cell].stage == BLOCK_IDLE &&
+            status->num_block_in_progress < throttle_depth(&status->throttle))
+        {
+            prepare_read_request(status, cell);
+        }
+    }
+}
+
 void prepare_write_request(struct CopyStatus* status, unsigned cell)
 {
     struct BlockStatus* block = &status->block_statuses[cell];
@@ -140,24 +337,83 @@ void prepare_write_request(struct CopyStatus* status, unsigned cell)
     block->stage = BLOCK_IN_WRITE;
 
     // Формируем запрос на запись.
-    struct io_uring_sqe* write_sqe = io_uring_get_sqe(&status->io_ring);
+    struct io_uring_sqe* write_sqe = get_sqe(status);
 
     io_uring_prep_write_fixed(write_sqe, status->dst_fd,
-                              status->fixed_buffers[cell].iov_base,
-                              READ_BLOCK_SIZE, block->offset, cell);
+                              status->cell_buffers[cell],
+                              READ_BLOCK_SIZE, block->offset, 0);
 
     // Обновляем состояни передачи.
     write_sqe->user_data = cell;
 
+    // Понижаем приоритет запроса и соблюдаем ограничение скорости.
+    if (ENABLE_BACKGROUND_MODE)
+    {
+        write_sqe->ioprio = BACKGROUND_IOPRIO;
+
+        throttle_acquire(&status->throttle, 0U);
+    }
+
+    if (MEASURE_LATENCY)
+    {
+        status->pending_cells[status->num_pending++] = cell;
+    }
+
     // printf("Cell#%02d: write (off=%lu, size=%u)\n", cell, block->offset, block->size);
 }
 
+void prepare_writeback_requests(struct CopyStatus* status, size_t window)
+{
+    off_t offset, size;
+
+    // Запускаем запись окна на диск, не дожидаясь её окончания.
+    writeback_window_range(&status->writeback, window, &offset, &size);
+
+    struct io_uring_sqe* start_sqe = get_sqe(status);
+    io_uring_prep_sync_file_range(start_sqe, status->dst_fd, size, offset, SYNC_FILE_RANGE_WRITE);
+    start_sqe->user_data = WRITEBACK_CELL;
+
+    status->num_writeback_in_progress += 1;
+
+    int64_t lagged = status->writeback.window_lagged[window];
+    if (lagged == WRITEBACK_NO_WINDOW)
+    {
+        return;
+    }
+
+    // Дожидаемся записи более старого окна и выбрасываем его из страничного кеша.
+    // Запросы связаны флагом IOSQE_IO_LINK: fadvise выполнится только после окончания записи.
+    writeback_window_range(&status->writeback, lagged, &offset, &size);
+
+    struct io_uring_sqe* wait_sqe = get_sqe(status);
+    io_uring_prep_sync_file_range(wait_sqe, status->dst_fd, size, offset,
+        SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER);
+    io_uring_sqe_set_flags(wait_sqe, IOSQE_IO_LINK);
+    wait_sqe->user_data = WRITEBACK_CELL;
+
+    struct io_uring_sqe* drop_sqe = get_sqe(status);
+    io_uring_prep_fadvise(drop_sqe, status->dst_fd, offset, size, POSIX_FADV_DONTNEED);
+    drop_sqe->user_data = WRITEBACK_CELL;
+
+    status->num_writeback_in_progress += 2;
+}
+
 void finish_write_request(struct CopyStatus* status, unsigned cell)
 {
     struct BlockStatus* block = &status->block_statuses[cell];
 
     block->stage = BLOCK_IDLE;
 
+    // Сбрасываем на диск полностью записанное окно.
+    if (ENABLE_WRITEBACK)
+    {
+        int64_t window = writeback_account(&status->writeback, block->offset, block->size);
+        if (window != WRITEBACK_NO_WINDOW)
+        {
+            prepare_writeback_requests(status, window);
+        }
+    }
+
     // Обновляем состояни передачи.
     status->num_block_in_progress -= 1;
 
@@ -185,7 +441,14 @@ int main(int argc, char* argv[])
 
     // Открываем результирующий файл и аллоцируем место на диске.
     int dst_fd;
-    open_dst_file(argv[2], &dst_fd, src_size);
+    open_dst_file(argv[2], &dst_fd, src_size, !ENABLE_SPARSE_COPY, ENABLE_DIRECT_IO);
+
+    // Проверяем, что размер блока удовлетворяет требованиям прямого ввода-вывода.
+    if (ENABLE_DIRECT_IO)
+    {
+        check_dio_alignment(src_fd, argv[1], READ_BLOCK_SIZE);
+        check_dio_alignment(dst_fd, argv[2], READ_BLOCK_SIZE);
+    }
 
     // Производим инициализацию копирования.
     struct CopyStatus status;
@@ -201,11 +464,16 @@ int main(int argc, char* argv[])
         prepare_read_request(&status, cell_i);
     }
 
-    while (status.src_off != status.src_size || status.num_block_in_progress != 0)
+    while (status.src_off != status.src_size || status.num_block_in_progress != 0 ||
+           status.num_writeback_in_progress != 0)
     {
         // Разом передаём все имеющиеся запросы.
+        stamp_pending_requests(&status);
         io_uring_submit_and_wait(&status.io_ring, 1U);
 
+        uint64_t batch_start = io_telemetry_batch_begin(&status.telemetry);
+        uint32_t batch_size  = 0U;
+
         int64_t cell_i = -1;
         do
         {
@@ -215,7 +483,19 @@ int main(int argc, char* argv[])
             if (ret == 0) cell_i = done_req->user_data;
             else          cell_i = -1;
 
-            if (cell_i != -1 && status.block_statuses[cell_i].stage == BLOCK_IN_READ)
+            if (cell_i != -1) batch_size += 1U;
+
+            if (cell_i == WRITEBACK_CELL)
+            {
+                if (done_req->res < 0)
+                {
+                    printf("Writeback operation failed: errno=%i (%s)", -done_req->res, strerror(-done_req->res));
+                    exit(EXIT_FAILURE);
+                }
+
+                status.num_writeback_in_progress -= 1;
+            }
+            else if (cell_i != -1 && status.block_statuses[cell_i].stage == BLOCK_IN_READ)
             {
                 if (done_req->res < 0)
                 {
@@ -223,7 +503,26 @@ int main(int argc, char* argv[])
                     exit(EXIT_FAILURE);
                 }
 
-                prepare_write_request(&status, cell_i);
+                if (MEASURE_LATENCY)
+                {
+                    uint64_t latency_ns = io_telemetry_complete(&status.telemetry, IO_OP_READ,
+                        status.block_statuses[cell_i].submit_ns, status.block_statuses[cell_i].size);
+
+                    if (ENABLE_BACKGROUND_MODE)
+                    {
+                        throttle_complete(&status.throttle, latency_ns);
+                    }
+                }
+
+                if (finish_read_request(&status, cell_i))
+                {
+                    prepare_write_request(&status, cell_i);
+                }
+                else
+                {
+                    finish_write_request(&status, cell_i);
+                    prepare_next_read_request(&status, cell_i);
+                }
             }
             else if (cell_i != -1 && status.block_statuses[cell_i].stage == BLOCK_IN_WRITE)
             {
@@ -233,22 +532,54 @@ int main(int argc, char* argv[])
                     exit(EXIT_FAILURE);
                 }
 
+                if (MEASURE_LATENCY)
+                {
+                    uint64_t latency_ns = io_telemetry_complete(&status.telemetry, IO_OP_WRITE,
+                        status.block_statuses[cell_i].submit_ns, status.block_statuses[cell_i].size);
+
+                    if (ENABLE_BACKGROUND_MODE)
+                    {
+                        throttle_complete(&status.throttle, latency_ns);
+                    }
+                }
+
                 finish_write_request(&status, cell_i);
-                prepare_read_request(&status, cell_i);
+                prepare_next_read_request(&status, cell_i);
             }
 
             io_uring_cqe_seen(&status.io_ring, done_req);
         }
         while (cell_i != -1);
+
+        if (ENABLE_BACKGROUND_MODE)
+        {
+            resume_idle_cells(&status);
+        }
+
+        io_telemetry_batch_end(&status.telemetry, batch_start, batch_size);
+    }
+
+    if (ENABLE_BACKGROUND_MODE)
+    {
+        throttle_report(&status.throttle);
     }
 
+    // Выводим сводку телеметрии.
+    io_telemetry_report(&status.telemetry);
+
     // Освобождаем выделенные ресурсы.
     io_uring_queue_exit(&status.io_ring);
 
-    free_copying_status(&status);
-
     // Закрываем файлы.
     close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
 
+    // Выводим контрольную сумму и, при необходимости, сверяем её с записанным файлом.
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_report(&status.digest, argv[2], ENABLE_VERIFY);
+    }
+
+    free_copying_status(&status);
+
     return EXIT_SUCCESS;
 }
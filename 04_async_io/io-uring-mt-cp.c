@@ -0,0 +1,557 @@
+// Copyright 2025, Vladislav Aleinik
+#include "common.h"
+#include "checksum.h"
+
+#include <memory.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <liburing.h>
+
+//=================================
+// Параметры процедуры копирования
+//=================================
+
+// Количество потоков по умолчанию (переопределяется третьим аргументом программы).
+#define NUM_THREADS             2U
+#define MAX_THREADS             64U
+
+// Блоки крупнее, чем в io-uring-cp: один поток должен загружать устройство целиком.
+#define READ_BLOCK_SIZE         (128U << 10U)
+#define QUEUE_SIZE              32U
+
+// Запись в обход страничного кеша (O_DIRECT на обоих концах копирования).
+// Без O_DIRECT измеряется скорость копирования в страничный кеш, а не на устройства.
+#define ENABLE_DIRECT_IO        0
+
+// Подсчёт контрольной суммы копируемых данных "на лету".
+#define ENABLE_CHECKSUM         0
+// Повторное чтение записанного файла и сравнение контрольных сумм.
+#define ENABLE_VERIFY           0
+
+// Копирование только отрезков с данными (SEEK_DATA/SEEK_HOLE) с сохранением "дыр".
+#define ENABLE_SPARSE_COPY      1
+
+// Кольцо используется только создавшим его потоком (IORING_SETUP_SINGLE_ISSUER).
+// Ядро отказывается от синхронизации доступа к кольцу.
+#define ENABLE_SINGLE_ISSUER    1
+// Завершение запросов откладывается до вызова io_uring_submit_and_wait()
+// (IORING_SETUP_DEFER_TASKRUN). Поток не прерывается на обработку завершений,
+// а забирает их пачкой. Требует ENABLE_SINGLE_ISSUER.
+#define ENABLE_DEFER_TASKRUN    1
+// Кольца потоков разделяют общий пул рабочих потоков ядра (IORING_SETUP_ATTACH_WQ).
+// Без этого каждое кольцо порождает собственный пул io-wq.
+#define ENABLE_SHARED_WQ        1
+
+// Гистограммы задержек операций, глубина очереди и стоимость обработки пачек завершений.
+#define ENABLE_TELEMETRY        0
+// Период вывода строки JSON с текущими показателями потока 0 (0 - только итоговая сводка).
+#define TELEMETRY_INTERVAL_NS   0U
+
+//==========================
+// Кольцо отдельного потока
+//==========================
+
+// Состояние одного копируемого блока данных.
+typedef enum {
+    BLOCK_IDLE     = 0,
+    BLOCK_IN_READ  = 1,
+    BLOCK_IN_WRITE = 2
+} BlockStage;
+
+struct BlockStatus
+{
+    BlockStage stage;
+
+    off_t offset;
+    uint32_t size;
+
+    // Момент передачи запроса ядру (для измерения задержки).
+    uint64_t submit_ns;
+};
+
+typedef struct {
+    size_t thread_i;
+    int src_fd;
+    int dst_fd;
+    // Диапазон файла, копируемый потоком.
+    off_t range_start;
+    off_t range_end;
+    // Кольцо, пул рабочих потоков которого разделяют кольца всех потоков.
+    int wq_fd;
+    BUFFER_POOL* pool;
+    const FILE_EXTENTS* extents;
+    FILE_DIGEST* digest;
+    // Телеметрия потока (объединяется по окончании копирования).
+    IO_TELEMETRY* telemetry;
+} THREAD_ARGS;
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+// Состояние копирования диапазона одним потоком.
+struct RingStatus
+{
+    const THREAD_ARGS* args;
+
+    struct io_uring io_ring;
+
+    off_t src_off;
+    uint16_t num_block_in_progress;
+
+    struct BlockStatus block_statuses[QUEUE_SIZE];
+    uint8_t* cell_buffers[QUEUE_SIZE];
+
+    // Ячейки подготовленных, но ещё не переданных ядру запросов.
+    unsigned pending_cells[QUEUE_SIZE];
+    unsigned num_pending;
+};
+
+void init_thread_ring(struct io_uring* ring, int wq_fd)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    if (ENABLE_SINGLE_ISSUER)
+    {
+        params.flags |= IORING_SETUP_SINGLE_ISSUER;
+    }
+
+    if (ENABLE_SINGLE_ISSUER && ENABLE_DEFER_TASKRUN)
+    {
+        params.flags |= IORING_SETUP_DEFER_TASKRUN;
+    }
+
+    if (ENABLE_SHARED_WQ)
+    {
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd  = wq_fd;
+    }
+
+    int init_ret = io_uring_queue_init_params(QUEUE_SIZE, ring, &params);
+    if (init_ret == -EINVAL && (params.flags & (IORING_SETUP_SINGLE_ISSUER|IORING_SETUP_DEFER_TASKRUN)) != 0U)
+    {
+        // Флаги SINGLE_ISSUER и DEFER_TASKRUN поддерживаются ядрами начиная с 6.0/6.1.
+        memset(&params, 0, sizeof(params));
+
+        if (ENABLE_SHARED_WQ)
+        {
+            params.flags |= IORING_SETUP_ATTACH_WQ;
+            params.wq_fd  = wq_fd;
+        }
+
+        init_ret = io_uring_queue_init_params(QUEUE_SIZE, ring, &params);
+    }
+
+    if (init_ret != 0)
+    {
+        fprintf(stderr, "Unable to initialize IO-ring: errno=%i (%s)\n", -init_ret, strerror(-init_ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void prepare_read_request(struct RingStatus* status, unsigned cell)
+{
+    const THREAD_ARGS* args = status->args;
+    struct BlockStatus* block = &status->block_statuses[cell];
+
+    // Пропускаем "дыры" исходного файла.
+    status->src_off = file_extents_next(args->extents, status->src_off);
+    if (status->src_off >= args->range_end)
+    {
+        status->src_off = args->range_end;
+        return;
+    }
+
+    // Диапазоны потоков выровнены на размер блока, поэтому блок не выходит за пределы диапазона.
+    off_t bytes_left = args->range_end - status->src_off;
+
+    block->stage  = BLOCK_IN_READ;
+    block->offset = status->src_off;
+    block->size   = (bytes_left < READ_BLOCK_SIZE)? bytes_left : READ_BLOCK_SIZE;
+
+    // Формируем запрос на чтение.
+    struct io_uring_sqe* read_sqe = io_uring_get_sqe(&status->io_ring);
+
+    io_uring_prep_read_fixed(read_sqe, args->src_fd,
+                             status->cell_buffers[cell],
+                             READ_BLOCK_SIZE, block->offset, cell);
+
+    read_sqe->user_data = cell;
+
+    if (ENABLE_TELEMETRY)
+    {
+        status->pending_cells[status->num_pending++] = cell;
+    }
+
+    // Обновляем состояние передачи.
+    status->src_off += block->size;
+    status->num_block_in_progress += 1;
+}
+
+void prepare_write_request(struct RingStatus* status, unsigned cell)
+{
+    const THREAD_ARGS* args = status->args;
+    struct BlockStatus* block = &status->block_statuses[cell];
+    uint8_t* buffer = status->cell_buffers[cell];
+
+    block->stage = BLOCK_IN_WRITE;
+
+    // Считаем контрольную сумму, пока блок находится в промежуточном буфере.
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_update(args->digest, block->offset, buffer, block->size);
+    }
+
+    // При O_DIRECT неполный последний блок дописывается нулями до выровненного размера.
+    uint32_t write_size = ENABLE_DIRECT_IO? dio_write_size(block->size, READ_BLOCK_SIZE) : block->size;
+    memset(buffer + block->size, 0, write_size - block->size);
+
+    // Формируем запрос на запись.
+    struct io_uring_sqe* write_sqe = io_uring_get_sqe(&status->io_ring);
+
+    io_uring_prep_write_fixed(write_sqe, args->dst_fd, buffer, write_size, block->offset, cell);
+
+    write_sqe->user_data = cell;
+
+    if (ENABLE_TELEMETRY)
+    {
+        status->pending_cells[status->num_pending++] = cell;
+    }
+}
+
+// Фиксирует момент передачи ядру для всех подготовленных запросов.
+// Вызывается непосредственно перед io_uring_submit_and_wait().
+void stamp_pending_requests(struct RingStatus* status)
+{
+    if (!ENABLE_TELEMETRY || status->num_pending == 0)
+    {
+        return;
+    }
+
+    uint64_t submit_ns = io_telemetry_submit_batch(status->args->telemetry, status->num_pending);
+    for (unsigned i = 0; i < status->num_pending; ++i)
+    {
+        status->block_statuses[status->pending_cells[i]].submit_ns = submit_ns;
+    }
+
+    status->num_pending = 0;
+}
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    // Кольцо создаётся в том же потоке, который его использует (требование SINGLE_ISSUER).
+    struct RingStatus status;
+    status.args    = args;
+    status.src_off = args->range_start;
+    status.num_block_in_progress = 0;
+    status.num_pending = 0;
+
+    init_thread_ring(&status.io_ring, args->wq_fd);
+
+    // Получаем буферы для хранения промежуточных данных из общего пула.
+    for (unsigned i = 0; i < QUEUE_SIZE; ++i)
+    {
+        status.block_statuses[i].stage = BLOCK_IDLE;
+        status.cell_buffers[i] = buffer_pool_acquire_or_die(args->pool);
+    }
+
+    // Оповещаем ядро о расположении буферов.
+    // Каждое кольцо закрепляет в памяти только буферы своего потока (индекс буфера - номер ячейки),
+    // иначе общий пул закреплялся бы num_threads раз и быстрее упирался в RLIMIT_MEMLOCK.
+    struct iovec cell_iovecs[QUEUE_SIZE];
+    for (unsigned i = 0; i < QUEUE_SIZE; ++i)
+    {
+        cell_iovecs[i].iov_base = status.cell_buffers[i];
+        cell_iovecs[i].iov_len  = READ_BLOCK_SIZE;
+    }
+
+    int register_ret = io_uring_register_buffers(&status.io_ring, cell_iovecs, QUEUE_SIZE);
+    if (register_ret != 0)
+    {
+        fprintf(stderr, "Unable to register intermediate buffers: errno=%i (%s)\n",
+            -register_ret, strerror(-register_ret));
+        exit(EXIT_FAILURE);
+    }
+
+    //===================
+    // Копирование файла
+    //===================
+
+    // Запускаем первоначальные запросы на чтение.
+    for (uint32_t cell_i = 0; cell_i < QUEUE_SIZE; ++cell_i)
+    {
+        prepare_read_request(&status, cell_i);
+    }
+
+    while (status.num_block_in_progress != 0)
+    {
+        // Разом передаём все имеющиеся запросы.
+        // При DEFER_TASKRUN завершения обрабатываются именно здесь.
+        stamp_pending_requests(&status);
+        io_uring_submit_and_wait(&status.io_ring, 1U);
+
+        uint64_t batch_start = io_telemetry_batch_begin(args->telemetry);
+        uint32_t batch_size  = 0U;
+
+        struct io_uring_cqe* done_req;
+        while (io_uring_peek_cqe(&status.io_ring, &done_req) == 0)
+        {
+            unsigned cell_i = done_req->user_data;
+            int res = done_req->res;
+            io_uring_cqe_seen(&status.io_ring, done_req);
+
+            struct BlockStatus* block = &status.block_statuses[cell_i];
+            if (res < 0)
+            {
+                fprintf(stderr, "%s operation failed at offset %lx: errno=%i (%s)\n",
+                    (block->stage == BLOCK_IN_READ)? "Read" : "Write", block->offset, -res, strerror(-res));
+                exit(EXIT_FAILURE);
+            }
+
+            if (ENABLE_TELEMETRY)
+            {
+                io_telemetry_complete(args->telemetry, (block->stage == BLOCK_IN_READ)? IO_OP_READ : IO_OP_WRITE,
+                                      block->submit_ns, block->size);
+            }
+
+            batch_size += 1U;
+
+            if (block->stage == BLOCK_IN_READ)
+            {
+                prepare_write_request(&status, cell_i);
+            }
+            else
+            {
+                block->stage = BLOCK_IDLE;
+                status.num_block_in_progress -= 1;
+
+                prepare_read_request(&status, cell_i);
+            }
+        }
+
+        io_telemetry_batch_end(args->telemetry, batch_start, batch_size);
+    }
+
+    // Освобождаем выделенные ресурсы.
+    io_uring_queue_exit(&status.io_ring);
+
+    for (unsigned i = 0; i < QUEUE_SIZE; ++i)
+    {
+        buffer_pool_release(args->pool, status.cell_buffers[i]);
+    }
+
+    return NULL;
+}
+
+//=======================
+// Процедура копирования
+//=======================
+
+// Выписывает номера аппаратных потоков, на которых процессу разрешено исполняться.
+size_t find_allowed_harts(int* harts)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        fprintf(stderr, "Unable to call sched_getaffinity\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num_harts = 0U;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            harts[num_harts++] = cpu;
+        }
+    }
+
+    return num_harts;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        fprintf(stderr, "Usage: io-uring-mt-cp <src> <dst> [num-threads]");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num_threads = (argc == 4)? strtoul(argv[3], NULL, 10) : NUM_THREADS;
+    if (num_threads == 0U || num_threads > MAX_THREADS)
+    {
+        fprintf(stderr, "Number of threads must be in range [1, %u]\n", MAX_THREADS);
+        exit(EXIT_FAILURE);
+    }
+
+    // Открываем исходный файл и определяем его размер.
+    int src_fd;
+    uint32_t src_size;
+    open_src_file(argv[1], &src_fd, &src_size);
+
+    // Открываем результирующий файл и аллоцируем место на диске.
+    int dst_fd;
+    open_dst_file(argv[2], &dst_fd, src_size, !ENABLE_SPARSE_COPY, ENABLE_DIRECT_IO);
+
+    // Проверяем, что размер блока удовлетворяет требованиям прямого ввода-вывода.
+    if (ENABLE_DIRECT_IO)
+    {
+        check_dio_alignment(src_fd, argv[1], READ_BLOCK_SIZE);
+        check_dio_alignment(dst_fd, argv[2], READ_BLOCK_SIZE);
+    }
+
+    // Определяем отрезки исходного файла, содержащие данные.
+    FILE_EXTENTS extents;
+    file_extents_scan(src_fd, src_size, READ_BLOCK_SIZE, ENABLE_SPARSE_COPY, &extents);
+
+    // Создаём пул промежуточных буферов: по QUEUE_SIZE буферов на поток.
+    BUFFER_POOL pool;
+    buffer_pool_init(&pool, READ_BLOCK_SIZE, QUEUE_SIZE * num_threads);
+
+    // Контрольные суммы блоков файла.
+    FILE_DIGEST digest;
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_init(&digest, src_size, READ_BLOCK_SIZE);
+    }
+
+    // Кольцо-владелец общего пула рабочих потоков ядра.
+    // Запросы через него не передаются.
+    struct io_uring wq_ring;
+    if (ENABLE_SHARED_WQ)
+    {
+        int init_ret = io_uring_queue_init(1U, &wq_ring, 0U);
+        if (init_ret != 0)
+        {
+            fprintf(stderr, "Unable to initialize IO-ring: errno=%i (%s)\n", -init_ret, strerror(-init_ret));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Телеметрия: каждый поток ведёт собственную, без синхронизации.
+    IO_TELEMETRY telemetry;
+    io_telemetry_init(&telemetry, ENABLE_TELEMETRY, 0U);
+
+    static IO_TELEMETRY thread_telemetry[MAX_THREADS];
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        io_telemetry_init(&thread_telemetry[i], ENABLE_TELEMETRY, (i == 0U)? TELEMETRY_INTERVAL_NS : 0U);
+    }
+
+    //=======================
+    // Создание пула потоков
+    //=======================
+
+    // Делим файл на непрерывные диапазоны, выровненные на размер блока.
+    off_t range_size = (src_size / num_threads + READ_BLOCK_SIZE - 1U) / READ_BLOCK_SIZE * READ_BLOCK_SIZE;
+
+    // Инициализируем данные потоков.
+    THREAD_ARGS args[MAX_THREADS];
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        args[i].thread_i    = i;
+        args[i].src_fd      = src_fd;
+        args[i].dst_fd      = dst_fd;
+        args[i].range_start = ((off_t) i * range_size < src_size)? (off_t) i * range_size : src_size;
+        args[i].range_end   = ((off_t) (i + 1U) * range_size < src_size)? (off_t) (i + 1U) * range_size : src_size;
+        args[i].wq_fd       = ENABLE_SHARED_WQ? wq_ring.ring_fd : -1;
+        args[i].pool        = &pool;
+        args[i].extents     = &extents;
+        args[i].digest      = &digest;
+        args[i].telemetry   = &thread_telemetry[i];
+    }
+
+    // Аппаратные потоки, доступные процессу.
+    static int harts[CPU_SETSIZE];
+    size_t num_harts = find_allowed_harts(harts);
+
+    uint64_t copy_start = time_ns();
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[MAX_THREADS];
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Поток i закрепляется за i-м разрешённым аппаратным потоком (по кругу, если потоков больше).
+        CPU_SET(harts[i % num_harts], &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t copy_ns = time_ns() - copy_start;
+
+    printf("Threads: %zu\n", num_threads);
+    printf("Bandwidth: %.2f GB/s\n", (double) src_size / copy_ns);
+
+    // Объединяем телеметрию потоков и выводим сводку.
+    for (size_t i = 0U; i < num_threads; ++i)
+    {
+        io_telemetry_merge(&telemetry, &thread_telemetry[i]);
+    }
+
+    io_telemetry_report(&telemetry);
+
+    if (ENABLE_SHARED_WQ)
+    {
+        io_uring_queue_exit(&wq_ring);
+    }
+
+    // Закрываем файлы.
+    close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
+
+    // Выводим контрольную сумму и, при необходимости, сверяем её с записанным файлом.
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_report(&digest, argv[2], ENABLE_VERIFY);
+        file_digest_free(&digest);
+    }
+
+    buffer_pool_free(&pool);
+    file_extents_free(&extents);
+
+    return EXIT_SUCCESS;
+}
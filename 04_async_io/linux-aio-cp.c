@@ -10,8 +10,29 @@
 
 #define READ_BLOCK_SIZE 4096U
 #define QUEUE_SIZE 16U
+
+// Запись в обход страничного кеша (O_DIRECT на обоих концах копирования).
+#define ENABLE_DIRECT_IO 0
 #define FILE_SIZE "256M"
 
+// Фоновый режим: копирование не должно мешать другим нагрузкам на те же диски.
+#define ENABLE_BACKGROUND_MODE 0
+// Класс приоритета запросов: IOPRIO_CLASS_IDLE или IOPRIO_CLASS_BE (с уровнем 0-7).
+#define BACKGROUND_IOPRIO      IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0)
+// Ограничение скорости копирования (байт/с) и количества запросов в секунду. 0 - без ограничения.
+#define THROTTLE_BANDWIDTH     (64U << 20U)
+#define THROTTLE_IOPS          0U
+// Порог задержки завершения запроса, при превышении которого глубина очереди уменьшается.
+#define THROTTLE_LATENCY_NS    (5U * 1000U * 1000U)
+
+// Гистограммы задержек операций, глубина очереди и стоимость обработки пачек завершений.
+#define ENABLE_TELEMETRY       0
+// Период вывода строки JSON с текущими показателями (0 - только итоговая сводка).
+#define TELEMETRY_INTERVAL_NS  0U
+
+// Задержка запросов измеряется для фонового режима и для телеметрии.
+#define MEASURE_LATENCY        (ENABLE_BACKGROUND_MODE || ENABLE_TELEMETRY)
+
 //==============
 // Операции AIO
 //==============
@@ -27,6 +48,12 @@ void io_read_setup(struct iocb* aio, int fd, off_t offset, void *buf, size_t siz
     aio->u.c.buf        = buf;          // Буфер данных, в который будем производить чтение.
     aio->u.c.nbytes     = size;         // Кол-во байт данных для считывания.
     aio->u.c.offset     = offset;       // Сдвиг от начала файла.
+
+    if (ENABLE_BACKGROUND_MODE)
+    {
+        aio->aio_reqprio  = BACKGROUND_IOPRIO; // Класс приоритета ввода-вывода.
+        aio->u.c.flags   |= IOCB_FLAG_IOPRIO;  // Ядро учитывает aio_reqprio только с этим флагом.
+    }
 }
 
 void io_write_setup(struct iocb* aio, int fd, off_t offset, void *buf, size_t size)
@@ -40,6 +67,12 @@ void io_write_setup(struct iocb* aio, int fd, off_t offset, void *buf, size_t si
     aio->u.c.buf        = buf;           // Буфер с данными, которые будем записывать в файл.
     aio->u.c.nbytes     = size;          // Кол-во байт данных для записи.
     aio->u.c.offset     = offset;        // Сдвиг от начала файла.
+
+    if (ENABLE_BACKGROUND_MODE)
+    {
+        aio->aio_reqprio  = BACKGROUND_IOPRIO; // Класс приоритета ввода-вывода.
+        aio->u.c.flags   |= IOCB_FLAG_IOPRIO;  // Ядро учитывает aio_reqprio только с этим флагом.
+    }
 }
 
 //=======================
@@ -61,15 +94,24 @@ int main(int argc, char* argv[])
 
     // Открываем результирующий файл и аллоцируем место на диске.
     int dst_fd;
-    open_dst_file(argv[2], &dst_fd, src_size);
+    open_dst_file(argv[2], &dst_fd, src_size, true, ENABLE_DIRECT_IO);
+
+    // Проверяем, что размер блока удовлетворяет требованиям прямого ввода-вывода.
+    if (ENABLE_DIRECT_IO)
+    {
+        check_dio_alignment(src_fd, argv[1], READ_BLOCK_SIZE);
+        check_dio_alignment(dst_fd, argv[2], READ_BLOCK_SIZE);
+    }
+
 
+    // Получаем промежуточные буферы из пула: по одному буферу на запрос.
+    BUFFER_POOL pool;
+    buffer_pool_init(&pool, READ_BLOCK_SIZE, QUEUE_SIZE);
 
-    // Выделяем память для промежуточного буфера.
-    uint8_t* buffer = (uint8_t*) aligned_alloc(READ_BLOCK_SIZE, READ_BLOCK_SIZE * QUEUE_SIZE);
-    if (buffer == NULL)
+    uint8_t* buffers[QUEUE_SIZE];
+    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE; ++aio_i)
     {
-        fprintf(stderr, "Unable to allocate aligned buffer\n");
-        exit(EXIT_FAILURE);
+        buffers[aio_i] = buffer_pool_acquire_or_die(&pool);
     }
 
     //===================
@@ -100,20 +142,41 @@ int main(int argc, char* argv[])
         submit_list[aio_i] = NULL;
     }
 
+    // Ограничение скорости и глубины очереди в фоновом режиме.
+    THROTTLE throttle;
+    throttle_init(&throttle, THROTTLE_BANDWIDTH, THROTTLE_IOPS, QUEUE_SIZE, THROTTLE_LATENCY_NS);
+
+    // Телеметрия ввода-вывода.
+    IO_TELEMETRY telemetry;
+    io_telemetry_init(&telemetry, ENABLE_TELEMETRY, TELEMETRY_INTERVAL_NS);
+
+    // Моменты передачи запросов ядру (для измерения задержки).
+    uint64_t submit_times[QUEUE_SIZE];
+
+    // Запросы, приостановленные из-за уменьшения глубины очереди.
+    size_t idle_list[QUEUE_SIZE];
+    size_t num_idle = 0U;
+
     //===================
     // Копирование файла
     //===================
 
-    // Округляем размер файла.
-    src_size = src_size + READ_BLOCK_SIZE - (src_size % READ_BLOCK_SIZE);
+    // Округляем размер файла до целого числа блоков.
+    // Исходный размер сохраняется: по нему файл обрезается после копирования.
+    uint32_t aligned_size = dio_write_size(src_size, READ_BLOCK_SIZE);
 
     // Запускам первоначальный набор чтений.
     off_t src_off = 0U;
     size_t num_io_reqs = 0U;
-    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE && src_off < src_size; ++aio_i, ++num_io_reqs)
+    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE && src_off < aligned_size; ++aio_i, ++num_io_reqs)
     {
         io_read_setup(&iocbs[aio_i], src_fd, src_off,
-            &buffer[aio_i * READ_BLOCK_SIZE], READ_BLOCK_SIZE);
+            buffers[aio_i], READ_BLOCK_SIZE);
+
+        if (ENABLE_BACKGROUND_MODE)
+        {
+            throttle_acquire(&throttle, READ_BLOCK_SIZE);
+        }
 
         // Добавляем запрос в список запросов для передачи в ОС.
         submit_list[aio_i] = &iocbs[aio_i];
@@ -125,6 +188,17 @@ int main(int argc, char* argv[])
     size_t num_to_submit = num_io_reqs;
     while (num_io_reqs != 0U)
     {
+        // Момент передачи фиксируется для всей пачки непосредственно перед io_submit():
+        // ожидание в throttle_acquire() не должно входить в задержку устройства.
+        if (MEASURE_LATENCY)
+        {
+            uint64_t submit_ns = io_telemetry_submit_batch(&telemetry, num_to_submit);
+            for (size_t i = 0U; i < num_to_submit; ++i)
+            {
+                submit_times[submit_list[i] - iocbs] = submit_ns;
+            }
+        }
+
         // Передаём запросы в ОС.
         int submit_ret = io_submit(io_ctx, num_to_submit, submit_list);
         if (submit_ret < 0)
@@ -141,6 +215,8 @@ int main(int argc, char* argv[])
             exit(EXIT_FAILURE);
         }
 
+        uint64_t batch_start = io_telemetry_batch_begin(&telemetry);
+
         // Читаем полученный из ядра список окончившихся запросов.
         num_to_submit = 0U;
         for (int ev = 0U; ev < num_events; ++ev)
@@ -148,6 +224,20 @@ int main(int argc, char* argv[])
             // Получаем управляющий блок запроса.
             struct iocb* iocb = events[ev].obj;
             int io_ret        = events[ev].res;
+            size_t aio_i      = iocb - iocbs;
+
+            // Учитываем задержку выполнения запроса.
+            if (MEASURE_LATENCY)
+            {
+                IO_OP op = (iocb->aio_lio_opcode == IO_CMD_PREAD)? IO_OP_READ : IO_OP_WRITE;
+                // Код ошибки (отрицательный io_ret) не учитывается как переданные байты.
+                uint64_t latency_ns = io_telemetry_complete(&telemetry, op, submit_times[aio_i], (io_ret > 0)? io_ret : 0);
+
+                if (ENABLE_BACKGROUND_MODE)
+                {
+                    throttle_complete(&throttle, latency_ns);
+                }
+            }
 
             if (iocb->aio_lio_opcode == IO_CMD_PREAD)
             {   // Выполнялась операция чтения.
@@ -155,7 +245,15 @@ int main(int argc, char* argv[])
                 if (bytes_read != 0)
                 {
                     // Подготавливаем запроса на запись.
-                    io_write_setup(iocb, dst_fd, iocb->u.c.offset, iocb->u.c.buf, bytes_read);
+                    // При O_DIRECT неполный последний блок записывается целиком.
+                    size_t write_size = ENABLE_DIRECT_IO? dio_write_size(bytes_read, READ_BLOCK_SIZE) : (size_t) bytes_read;
+                    memset((uint8_t*) iocb->u.c.buf + bytes_read, 0, write_size - bytes_read);
+                    io_write_setup(iocb, dst_fd, iocb->u.c.offset, iocb->u.c.buf, write_size);
+
+                    if (ENABLE_BACKGROUND_MODE)
+                    {
+                        throttle_acquire(&throttle, 0U);
+                    }
 
                     // Добавляем запрос в список для передачи в ядро.
                     submit_list[num_to_submit] = iocb;
@@ -171,11 +269,24 @@ int main(int argc, char* argv[])
             else if (iocb->aio_lio_opcode == IO_CMD_PWRITE)
             {   // Выполнялась операция записи.
                 int bytes_written = io_ret;
-                if (bytes_written != 0 && src_off < src_size)
+
+                // При превышении допустимой глубины очереди запрос приостанавливается.
+                bool over_depth = ENABLE_BACKGROUND_MODE && num_io_reqs > throttle_depth(&throttle);
+                if (bytes_written != 0 && src_off < aligned_size && over_depth)
+                {
+                    idle_list[num_idle++] = aio_i;
+                    num_io_reqs -= 1U;
+                }
+                else if (bytes_written != 0 && src_off < aligned_size)
                 {
                     // Подготавливаем запроса на следующее чтение.
                     io_read_setup(iocb, src_fd, src_off, iocb->u.c.buf, READ_BLOCK_SIZE);
 
+                    if (ENABLE_BACKGROUND_MODE)
+                    {
+                        throttle_acquire(&throttle, READ_BLOCK_SIZE);
+                    }
+
                     // Добавляем запрос в список для передачи в ядро.
                     submit_list[num_to_submit] = iocb;
                     num_to_submit++;
@@ -188,10 +299,44 @@ int main(int argc, char* argv[])
                 }
             }
         }
+
+        // Возобновляем приостановленные запросы, если глубина очереди снова выросла.
+        while (num_idle != 0U && src_off < aligned_size &&
+               (num_io_reqs == 0U || num_io_reqs < throttle_depth(&throttle)))
+        {
+            size_t aio_i = idle_list[--num_idle];
+            io_read_setup(&iocbs[aio_i], src_fd, src_off, buffers[aio_i], READ_BLOCK_SIZE);
+
+            throttle_acquire(&throttle, READ_BLOCK_SIZE);
+
+            submit_list[num_to_submit] = &iocbs[aio_i];
+            num_to_submit++;
+            num_io_reqs++;
+
+            src_off += READ_BLOCK_SIZE;
+        }
+
+        io_telemetry_batch_end(&telemetry, batch_start, num_events);
+    }
+
+    if (ENABLE_BACKGROUND_MODE)
+    {
+        throttle_report(&throttle);
     }
 
+    // Выводим сводку телеметрии.
+    io_telemetry_report(&telemetry);
+
     // Закрываем файлы.
     close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
 
+    // Возвращаем буферы в пул.
+    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE; ++aio_i)
+    {
+        buffer_pool_release(&pool, buffers[aio_i]);
+    }
+
+    buffer_pool_free(&pool);
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,338 @@
+// Copyright 2025, Vladislav Aleinik
+#include "common.h"
+
+#include <memory.h>
+
+#include <sched.h>
+#include <pthread.h>
+#include <immintrin.h>
+
+//=================================
+// Параметры процедуры копирования
+//=================================
+
+#define NUM_THREADS             2U
+
+// Размер окна отображения файла в память.
+#define WINDOW_SIZE             (64U << 20U)
+
+// Копирование с помощью потоковых (non-temporal) записей в обход кеша.
+// При значении 0 используется memcpy.
+#define ENABLE_STREAMING_STORES 1
+
+// Размер рабочего набора, вытеснение которого из кеша измеряется при копировании.
+#define WORKING_SET_SIZE        (8U << 20U)
+#define CACHE_LINE_SIZE         64U
+
+//===================================
+// Копирование с потоковыми записями
+//===================================
+// Инструкции vmovntdq записывают данные в память через буферы объединения записи,
+// минуя иерархию кешей. Копируемые данные не вытесняют из кеша рабочий набор программы.
+// Адрес назначения должен быть выровнен на размер вектора.
+
+__attribute__((target("avx512f")))
+void copy_streaming_avx512(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    size_t i = 0U;
+    for (; i + 4U * 64U <= size; i += 4U * 64U)
+    {
+        __m512i v0 = _mm512_loadu_si512((const void*) (src + i +   0U));
+        __m512i v1 = _mm512_loadu_si512((const void*) (src + i +  64U));
+        __m512i v2 = _mm512_loadu_si512((const void*) (src + i + 128U));
+        __m512i v3 = _mm512_loadu_si512((const void*) (src + i + 192U));
+
+        _mm512_stream_si512((void*) (dst + i +   0U), v0);
+        _mm512_stream_si512((void*) (dst + i +  64U), v1);
+        _mm512_stream_si512((void*) (dst + i + 128U), v2);
+        _mm512_stream_si512((void*) (dst + i + 192U), v3);
+    }
+
+    // Потоковые записи не упорядочены с обычными: дожидаемся их завершения.
+    _mm_sfence();
+
+    memcpy(dst + i, src + i, size - i);
+}
+
+__attribute__((target("avx2")))
+void copy_streaming_avx2(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    size_t i = 0U;
+    for (; i + 4U * 32U <= size; i += 4U * 32U)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*) (src + i +  0U));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*) (src + i + 32U));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*) (src + i + 64U));
+        __m256i v3 = _mm256_loadu_si256((const __m256i*) (src + i + 96U));
+
+        _mm256_stream_si256((__m256i*) (dst + i +  0U), v0);
+        _mm256_stream_si256((__m256i*) (dst + i + 32U), v1);
+        _mm256_stream_si256((__m256i*) (dst + i + 64U), v2);
+        _mm256_stream_si256((__m256i*) (dst + i + 96U), v3);
+    }
+
+    // Потоковые записи не упорядочены с обычными: дожидаемся их завершения.
+    _mm_sfence();
+
+    memcpy(dst + i, src + i, size - i);
+}
+
+void copy_memcpy(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    memcpy(dst, src, size);
+}
+
+// Реализация, выбранная в зависимости от возможностей процессора.
+void (*copy_block)(uint8_t* dst, const uint8_t* src, size_t size) = copy_memcpy;
+
+void select_copy_method()
+{
+    __builtin_cpu_init();
+
+    if (ENABLE_STREAMING_STORES && __builtin_cpu_supports("avx512f"))
+    {
+        copy_block = copy_streaming_avx512;
+        printf("Copy method: AVX-512 streaming stores\n");
+    }
+    else if (ENABLE_STREAMING_STORES && __builtin_cpu_supports("avx2"))
+    {
+        copy_block = copy_streaming_avx2;
+        printf("Copy method: AVX2 streaming stores\n");
+    }
+    else
+    {
+        copy_block = copy_memcpy;
+        printf("Copy method: memcpy\n");
+    }
+}
+
+//========================================
+// Организация многопоточного копирования
+//========================================
+
+typedef struct {
+    size_t thread_i;
+    int src_fd;
+    int dst_fd;
+    // Диапазон файла, копируемый потоком.
+    off_t range_start;
+    off_t range_end;
+} THREAD_ARGS;
+
+typedef struct {
+    pthread_t tid;
+} THREAD_INFO;
+
+void* map_window(int fd, int prot, int flags, off_t offset, size_t size)
+{
+    void* window = mmap(NULL, size, prot, MAP_SHARED|flags, fd, offset);
+    if (window == MAP_FAILED)
+    {
+        fprintf(stderr, "Unable to map file window [%lx, %lx): errno=%i (%s)\n",
+            offset, offset + size, errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    return window;
+}
+
+void* thread_func(void* thread_args)
+{
+    THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
+
+    //===================
+    // Копирование файла
+    //===================
+
+    for (off_t offset = args->range_start; offset < args->range_end; offset += WINDOW_SIZE)
+    {
+        size_t size = args->range_end - offset;
+        if (size > WINDOW_SIZE) size = WINDOW_SIZE;
+
+        // Отображаем окно исходного файла, сразу подкачивая его страницы.
+        uint8_t* src = map_window(args->src_fd, PROT_READ, MAP_POPULATE, offset, size);
+
+        // Подсказываем ядру последовательный характер доступа (агрессивное упреждающее чтение).
+        madvise(src, size, MADV_SEQUENTIAL);
+
+        // Отображаем окно результирующего файла (место под него выделено fallocate()).
+        uint8_t* dst = map_window(args->dst_fd, PROT_READ|PROT_WRITE, 0, offset, size);
+
+        copy_block(dst, src, size);
+
+        if (munmap(src, size) == -1 || munmap(dst, size) == -1)
+        {
+            fprintf(stderr, "Unable to unmap file window\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return NULL;
+}
+
+//============================
+// Измерение загрязнения кеша
+//============================
+// Перед копированием программа "прогревает" рабочий набор, после копирования -
+// повторно читает его. Рост времени чтения показывает, какую часть рабочего набора
+// вытеснили из кеша копируемые данные.
+
+double working_set_read_ns_per_line(const volatile uint8_t* working_set)
+{
+    uint64_t start = time_ns();
+
+    for (size_t i = 0U; i < WORKING_SET_SIZE; i += CACHE_LINE_SIZE)
+    {
+        (void) working_set[i];
+    }
+
+    return (double) (time_ns() - start) / (WORKING_SET_SIZE / CACHE_LINE_SIZE);
+}
+
+//=======================
+// Процедура копирования
+//=======================
+
+// Выписывает номера аппаратных потоков, на которых процессу разрешено исполняться.
+size_t find_allowed_harts(int* harts)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        fprintf(stderr, "Unable to call sched_getaffinity\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t num_harts = 0U;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            harts[num_harts++] = cpu;
+        }
+    }
+
+    return num_harts;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: mmap-cp <src> <dst>");
+        exit(EXIT_FAILURE);
+    }
+
+    // Открываем исходный файл и определяем его размер.
+    int src_fd;
+    uint32_t src_size;
+    open_src_file(argv[1], &src_fd, &src_size);
+
+    // Открываем результирующий файл и аллоцируем место на диске.
+    // NOTE: fallocate() устанавливает размер файла, поэтому всё окно отображения лежит внутри файла.
+    int dst_fd;
+    open_dst_file(argv[2], &dst_fd, src_size, true, false);
+
+    select_copy_method();
+
+    // Прогреваем рабочий набор.
+    uint8_t* working_set = (uint8_t*) aligned_alloc(CACHE_LINE_SIZE, WORKING_SET_SIZE);
+    if (working_set == NULL)
+    {
+        fprintf(stderr, "Unable to allocate working set\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(working_set, 1, WORKING_SET_SIZE);
+    working_set_read_ns_per_line(working_set);
+    double hot_ns = working_set_read_ns_per_line(working_set);
+
+    //=======================
+    // Создание пула потоков
+    //=======================
+
+    // Делим файл на непрерывные диапазоны, выровненные на размер страницы.
+    off_t range_size = (src_size / NUM_THREADS + BUFFER_POOL_PAGE_SIZE - 1U) & ~((off_t) BUFFER_POOL_PAGE_SIZE - 1);
+
+    // Инициализируем данные потоков.
+    THREAD_ARGS args[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        args[i].thread_i    = i;
+        args[i].src_fd      = src_fd;
+        args[i].dst_fd      = dst_fd;
+        args[i].range_start = (i * range_size < src_size)? i * range_size : src_size;
+        args[i].range_end   = ((i + 1U) * range_size < src_size)? (i + 1U) * range_size : src_size;
+    }
+
+    // Аппаратные потоки, доступные процессу.
+    static int harts[CPU_SETSIZE];
+    size_t num_harts = find_allowed_harts(harts);
+
+    uint64_t copy_start = time_ns();
+
+    // Запуск потоков.
+    THREAD_INFO thread_info[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        // Инициализируем аттрибуты потока.
+        pthread_attr_t thread_attributes;
+        int ret = pthread_attr_init(&thread_attributes);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_init\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Назначаем аппаратные потоки для потоков POSIX.
+        cpu_set_t assigned_harts;
+        CPU_ZERO(&assigned_harts);
+
+        // Поток i закрепляется за i-м разрешённым аппаратным потоком (по кругу, если потоков больше).
+        CPU_SET(harts[i % num_harts], &assigned_harts);
+
+        // Устанавливаем аффинность потока.
+        ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Создаём потоки POSIX.
+        ret = pthread_create(&thread_info[i].tid, &thread_attributes, thread_func, &args[i]);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Удаляем объект с аттрибутами потока.
+        pthread_attr_destroy(&thread_attributes);
+    }
+
+    // Ждём, пока все потоки закончат выполнение.
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+    {
+        int ret = pthread_join(thread_info[i].tid, NULL);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to join thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t copy_ns = time_ns() - copy_start;
+
+    // Измеряем, насколько копирование вытеснило рабочий набор из кеша.
+    double cold_ns = working_set_read_ns_per_line(working_set);
+    free(working_set);
+
+    printf("Copy bandwidth: %.2f GB/s\n", (double) src_size / copy_ns);
+    printf("Working set re-read: %.2f ns/line before copy, %.2f ns/line after copy\n", hot_ns, cold_ns);
+
+    // Закрываем файлы.
+    close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
+
+    return EXIT_SUCCESS;
+}
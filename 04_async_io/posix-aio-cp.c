@@ -11,6 +11,14 @@
 #define READ_BLOCK_SIZE 4096U
 #define QUEUE_SIZE 16U
 
+// Запись в обход страничного кеша (O_DIRECT на обоих концах копирования).
+#define ENABLE_DIRECT_IO 0
+
+// Гистограммы задержек операций, глубина очереди и стоимость обработки пачек завершений.
+#define ENABLE_TELEMETRY        0
+// Период вывода строки JSON с текущими показателями (0 - только итоговая сводка).
+#define TELEMETRY_INTERVAL_NS   0U
+
 //==============
 // Операции AIO
 //==============
@@ -70,15 +78,24 @@ int main(int argc, char* argv[])
 
     // Открываем результирующий файл и аллоцируем место на диске.
     int dst_fd;
-    open_dst_file(argv[2], &dst_fd, src_size);
+    open_dst_file(argv[2], &dst_fd, src_size, true, ENABLE_DIRECT_IO);
+
+    // Проверяем, что размер блока удовлетворяет требованиям прямого ввода-вывода.
+    if (ENABLE_DIRECT_IO)
+    {
+        check_dio_alignment(src_fd, argv[1], READ_BLOCK_SIZE);
+        check_dio_alignment(dst_fd, argv[2], READ_BLOCK_SIZE);
+    }
+
 
+    // Получаем промежуточные буферы из пула: по одному буферу на запрос.
+    BUFFER_POOL pool;
+    buffer_pool_init(&pool, READ_BLOCK_SIZE, QUEUE_SIZE);
 
-    // Выделяем память для промежуточного буфера.
-    uint8_t* buffer = (uint8_t*) aligned_alloc(READ_BLOCK_SIZE, READ_BLOCK_SIZE * QUEUE_SIZE);
-    if (buffer == NULL)
+    uint8_t* buffers[QUEUE_SIZE];
+    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE; ++aio_i)
     {
-        fprintf(stderr, "Unable to allocate aligned buffer\n");
-        exit(EXIT_FAILURE);
+        buffers[aio_i] = buffer_pool_acquire_or_die(&pool);
     }
 
     //====================================
@@ -100,20 +117,29 @@ int main(int argc, char* argv[])
         wait_list[aio_i] = NULL;
     }
 
+    // Телеметрия и моменты передачи запросов.
+    IO_TELEMETRY telemetry;
+    io_telemetry_init(&telemetry, ENABLE_TELEMETRY, TELEMETRY_INTERVAL_NS);
+
+    uint64_t submit_times[QUEUE_SIZE];
+
     //===================
     // Копирование файла
     //===================
 
-    // Округляем размер файла.
-    src_size = src_size + READ_BLOCK_SIZE - (src_size % READ_BLOCK_SIZE);
+    // Округляем размер файла до целого числа блоков.
+    // Исходный размер сохраняется: по нему файл обрезается после копирования.
+    uint32_t aligned_size = dio_write_size(src_size, READ_BLOCK_SIZE);
 
     // Запускам первоначальный набор чтений.
     off_t src_off = 0U;
     size_t num_io_reqs = 0U;
-    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE && src_off < src_size; ++aio_i, ++num_io_reqs)
+    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE && src_off < aligned_size; ++aio_i, ++num_io_reqs)
     {
+        if (ENABLE_TELEMETRY) submit_times[aio_i] = io_telemetry_submit(&telemetry);
+
         aio_read_setup(&aiocbs[aio_i], src_fd, src_off,
-            &buffer[aio_i * READ_BLOCK_SIZE], READ_BLOCK_SIZE);
+            buffers[aio_i], READ_BLOCK_SIZE);
 
         // Размещаем AIO в список выполняющихся запросов.
         wait_list[aio_i] = &aiocbs[aio_i];
@@ -132,6 +158,9 @@ int main(int argc, char* argv[])
             exit(EXIT_FAILURE);
         }
 
+        uint64_t batch_start = io_telemetry_batch_begin(&telemetry);
+        uint32_t batch_size  = 0U;
+
         // Проверяем, какие из задач закончили выполнение.
         for (size_t aio_i = 0U; aio_i < QUEUE_SIZE; ++aio_i)
         {
@@ -142,15 +171,30 @@ int main(int argc, char* argv[])
             int error_ret = aio_error(&aiocbs[aio_i]);
             if (error_ret == EINPROGRESS) continue;
 
+            batch_size += 1U;
+
             if (aiocbs[aio_i].aio_lio_opcode == LIO_READ)
             {   // Выполнялась операция чтения.
                 // Получаем код возврата операции.
                 int bytes_read = aio_return(&aiocbs[aio_i]);
+
+                if (ENABLE_TELEMETRY)
+                {
+                    io_telemetry_complete(&telemetry, IO_OP_READ, submit_times[aio_i], (bytes_read > 0)? bytes_read : 0);
+                }
+
                 if (bytes_read != 0)
                 {
                     // Запускаем операцию записи.
+                    // При O_DIRECT неполный последний блок записывается целиком.
+                    size_t write_size = ENABLE_DIRECT_IO? dio_write_size(bytes_read, READ_BLOCK_SIZE) : (size_t) bytes_read;
+                    memset(buffers[aio_i] + bytes_read, 0, write_size - bytes_read);
+
+                    // Запрос учитывается в телеметрии, только если он действительно передаётся.
+                    if (ENABLE_TELEMETRY) submit_times[aio_i] = io_telemetry_submit(&telemetry);
+
                     aio_write_setup(&aiocbs[aio_i], dst_fd, aiocbs[aio_i].aio_offset,
-                        &buffer[aio_i * READ_BLOCK_SIZE], bytes_read);
+                        buffers[aio_i], write_size);
                 }
                 else
                 {
@@ -163,11 +207,19 @@ int main(int argc, char* argv[])
             {   // Выполнялась операция записи.
                 // Получаем код возврата операции.
                 int bytes_written = aio_return(&aiocbs[aio_i]);
-                if (bytes_written != 0 && src_off < src_size)
+
+                if (ENABLE_TELEMETRY)
                 {
+                    io_telemetry_complete(&telemetry, IO_OP_WRITE, submit_times[aio_i], (bytes_written > 0)? bytes_written : 0);
+                }
+
+                if (bytes_written != 0 && src_off < aligned_size)
+                {
+                    if (ENABLE_TELEMETRY) submit_times[aio_i] = io_telemetry_submit(&telemetry);
+
                     // Инициируем следующую операцию записи.
                     aio_read_setup(&aiocbs[aio_i], src_fd, src_off,
-                        &buffer[aio_i * READ_BLOCK_SIZE], READ_BLOCK_SIZE);
+                        buffers[aio_i], READ_BLOCK_SIZE);
 
                     src_off += READ_BLOCK_SIZE;
                 }
@@ -181,10 +233,23 @@ int main(int argc, char* argv[])
                 }
             }
         }
+
+        io_telemetry_batch_end(&telemetry, batch_start, batch_size);
     }
 
+    // Выводим сводку телеметрии.
+    io_telemetry_report(&telemetry);
+
     // Закрываем файлы.
     close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
 
+    // Возвращаем буферы в пул.
+    for (size_t aio_i = 0U; aio_i < QUEUE_SIZE; ++aio_i)
+    {
+        buffer_pool_release(&pool, buffers[aio_i]);
+    }
+
+    buffer_pool_free(&pool);
+
     return EXIT_SUCCESS;
 }
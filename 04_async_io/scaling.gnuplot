@@ -0,0 +1,17 @@
+# Copyright Vladislav Aleinik, 2025
+# Bandwidth of io-uring-mt-cp against the number of threads (rings).
+# Usage: gnuplot -e "datafile='build/scaling.dat'; outfile='build/scaling.png'" scaling.gnuplot
+
+set terminal pngcairo size 800,600
+set output outfile
+
+set title "io-uring-mt-cp: one ring per thread"
+set xlabel "Threads"
+set ylabel "Bandwidth, GB/s"
+
+set logscale x 2
+set grid
+set key off
+set yrange [0:*]
+
+plot datafile using 1:2 with linespoints linewidth 2 pointtype 7
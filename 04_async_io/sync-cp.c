@@ -9,6 +9,23 @@
 
 #define READ_BLOCK_SIZE 4096U
 
+// Запись в обход страничного кеша (O_DIRECT на обоих концах копирования).
+#define ENABLE_DIRECT_IO 0
+
+// Копирование только отрезков с данными (SEEK_DATA/SEEK_HOLE) с сохранением "дыр".
+#define ENABLE_SPARSE_COPY 1
+// Пропуск записи нулевых блоков внутри отрезков с данными.
+#define ENABLE_ZERO_PUNCH  0
+
+// Постепенный сброс записанных данных на диск окнами фиксированного размера.
+#define ENABLE_WRITEBACK      0
+#define WRITEBACK_WINDOW_SIZE (8U << 20U)
+
+// Гистограммы задержек операций, глубина очереди и стоимость обработки пачек завершений.
+#define ENABLE_TELEMETRY        0
+// Период вывода строки JSON с текущими показателями (0 - только итоговая сводка).
+#define TELEMETRY_INTERVAL_NS   0U
+
 //=======================
 // Процедура копирования
 //=======================
@@ -28,36 +45,92 @@ int main(int argc, char* argv[])
 
     // Открываем результирующий файл и аллоцируем место на диске.
     int dst_fd;
-    open_dst_file(argv[2], &dst_fd, src_size);
+    open_dst_file(argv[2], &dst_fd, src_size, !ENABLE_SPARSE_COPY, ENABLE_DIRECT_IO);
 
-    // Выделяем память для промежуточного буфера.
-    uint8_t* buffer = (uint8_t*) aligned_alloc(READ_BLOCK_SIZE, READ_BLOCK_SIZE);
-    if (buffer == NULL)
+    // Проверяем, что размер блока удовлетворяет требованиям прямого ввода-вывода.
+    if (ENABLE_DIRECT_IO)
     {
-        fprintf(stderr, "Unable to allocate aligned buffer\n");
-        exit(EXIT_FAILURE);
+        check_dio_alignment(src_fd, argv[1], READ_BLOCK_SIZE);
+        check_dio_alignment(dst_fd, argv[2], READ_BLOCK_SIZE);
+    }
+
+    // Определяем отрезки исходного файла, содержащие данные.
+    FILE_EXTENTS extents;
+    file_extents_scan(src_fd, src_size, READ_BLOCK_SIZE, ENABLE_SPARSE_COPY, &extents);
+
+    // Инициализируем управление сбросом данных на диск.
+    WRITEBACK_CONTROLLER writeback;
+    if (ENABLE_WRITEBACK)
+    {
+        writeback_init(&writeback, dst_fd, &extents, WRITEBACK_WINDOW_SIZE);
     }
 
+    // Получаем промежуточный буфер из пула.
+    BUFFER_POOL pool;
+    buffer_pool_init(&pool, READ_BLOCK_SIZE, 1U);
+
+    uint8_t* buffer = buffer_pool_acquire_or_die(&pool);
+
+    // Телеметрия: в синхронном копировании глубина очереди не превышает единицы.
+    IO_TELEMETRY telemetry;
+    io_telemetry_init(&telemetry, ENABLE_TELEMETRY, TELEMETRY_INTERVAL_NS);
+
     //===================
     // Копирование файла
     //===================
 
-    for (uint32_t i = 0U; i < src_size;)
+    for (off_t i = file_extents_next(&extents, 0); i < src_size; i = file_extents_next(&extents, i))
     {
         // Производим чтение в буфер.
-        ssize_t bytes_read = read(src_fd, buffer, READ_BLOCK_SIZE);
+        uint64_t read_start = ENABLE_TELEMETRY? io_telemetry_submit(&telemetry) : 0U;
+
+        ssize_t bytes_read = pread(src_fd, buffer, READ_BLOCK_SIZE, i);
         if (bytes_read == -1)
         {
-            fprintf(stderr, "Unable to read block [%x, %x)\n", i, i + READ_BLOCK_SIZE);
+            fprintf(stderr, "Unable to read block [%lx, %lx)\n", i, i + READ_BLOCK_SIZE);
             exit(EXIT_FAILURE);
         }
 
+        if (ENABLE_TELEMETRY)
+        {
+            io_telemetry_complete(&telemetry, IO_OP_READ, read_start, bytes_read);
+        }
+
         // Производим запись из буфера.
-        ssize_t bytes_written = write(dst_fd, buffer, bytes_read);
-        if (bytes_written == -1 || bytes_written != bytes_read)
+        // Нулевой блок не записываем: на его месте в файле останется "дыра".
+        if (!ENABLE_ZERO_PUNCH || !block_is_zero(buffer, bytes_read))
         {
-            fprintf(stderr, "Unable to write block [%x, %lx)\n", i, i + bytes_read);
-            exit(EXIT_FAILURE);
+            // При O_DIRECT неполный последний блок дописывается нулями до выровненного размера.
+            ssize_t write_size = ENABLE_DIRECT_IO? (ssize_t) dio_write_size(bytes_read, READ_BLOCK_SIZE) : bytes_read;
+            memset(buffer + bytes_read, 0, write_size - bytes_read);
+
+            uint64_t write_start = ENABLE_TELEMETRY? io_telemetry_submit(&telemetry) : 0U;
+
+            ssize_t bytes_written = pwrite(dst_fd, buffer, write_size, i);
+            if (bytes_written == -1 || bytes_written != write_size)
+            {
+                fprintf(stderr, "Unable to write block [%lx, %lx)\n", i, i + bytes_read);
+                exit(EXIT_FAILURE);
+            }
+
+            if (ENABLE_TELEMETRY)
+            {
+                io_telemetry_complete(&telemetry, IO_OP_WRITE, write_start, bytes_read);
+            }
+        }
+        else if (!ENABLE_SPARSE_COPY)
+        {
+            punch_zero_block(dst_fd, i, bytes_read);
+        }
+
+        // Сбрасываем на диск полностью записанное окно.
+        if (ENABLE_WRITEBACK)
+        {
+            int64_t window = writeback_account(&writeback, i, bytes_read);
+            if (window != WRITEBACK_NO_WINDOW)
+            {
+                writeback_flush_window(&writeback, window);
+            }
         }
 
         i += bytes_read;
@@ -67,8 +140,22 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Выводим сводку телеметрии.
+    io_telemetry_report(&telemetry);
+
+    file_extents_free(&extents);
+
+    if (ENABLE_WRITEBACK)
+    {
+        writeback_free(&writeback);
+    }
+
     // Закрываем файлы.
     close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
 
+    // Освобождаем промежуточный буфер.
+    buffer_pool_release(&pool, buffer);
+    buffer_pool_free(&pool);
+
     return EXIT_SUCCESS;
 }
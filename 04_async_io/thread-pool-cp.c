@@ -1,5 +1,6 @@
 // Copyright 2025, Vladislav Aleinik
 #include "common.h"
+#include "checksum.h"
 
 #include <memory.h>
 
@@ -14,16 +15,43 @@
 #define NUM_HARDWARE_THREADS    1U
 #define READ_BLOCK_SIZE         4096U
 
+// Запись в обход страничного кеша (O_DIRECT на обоих концах копирования).
+#define ENABLE_DIRECT_IO        0
+
+// Подсчёт контрольной суммы копируемых данных "на лету".
+#define ENABLE_CHECKSUM         0
+// Повторное чтение записанного файла и сравнение контрольных сумм.
+#define ENABLE_VERIFY           0
+
+// Копирование только отрезков с данными (SEEK_DATA/SEEK_HOLE) с сохранением "дыр".
+#define ENABLE_SPARSE_COPY      1
+// Пропуск записи нулевых блоков внутри отрезков с данными.
+#define ENABLE_ZERO_PUNCH       0
+
+// Постепенный сброс записанных данных на диск окнами фиксированного размера.
+#define ENABLE_WRITEBACK        0
+#define WRITEBACK_WINDOW_SIZE   (8U << 20U)
+
+// Гистограммы задержек операций, глубина очереди и стоимость обработки пачек завершений.
+#define ENABLE_TELEMETRY        0
+// Период вывода строки JSON с текущими показателями (0 - только итоговая сводка).
+#define TELEMETRY_INTERVAL_NS   0U
+
 //========================================
 // Организация многопоточного копирования
 //========================================
 
 typedef struct {
     size_t thread_i;
-    uint8_t* buffer;
+    BUFFER_POOL* pool;
     size_t src_size;
     int src_fd;
     int dst_fd;
+    FILE_DIGEST* digest;
+    const FILE_EXTENTS* extents;
+    WRITEBACK_CONTROLLER* writeback;
+    // Телеметрия потока (объединяется по окончании копирования).
+    IO_TELEMETRY* telemetry;
 } THREAD_ARGS;
 
 typedef struct {
@@ -34,6 +62,9 @@ void* thread_func(void* thread_args)
 {
     THREAD_ARGS* args = (THREAD_ARGS*) thread_args;
 
+    // Получаем промежуточный буфер из общего пула.
+    uint8_t* buffer = buffer_pool_acquire_or_die(args->pool);
+
     //===================
     // Копирование файла
     //===================
@@ -42,25 +73,77 @@ void* thread_func(void* thread_args)
     {
         // Вычисление сдвига в файле.
         size_t offset = i + args->thread_i * READ_BLOCK_SIZE;
-        if (offset > args->src_size)
+        if (offset >= args->src_size)
         {
             break;
         }
 
+        // Пропускаем блоки, попадающие в "дыры" исходного файла.
+        off_t data_offset = file_extents_next(args->extents, offset);
+        if (data_offset != (off_t) offset)
+        {
+            // Переходим к первому блоку потока, не лежащему левее следующего отрезка с данными.
+            const size_t stride = READ_BLOCK_SIZE * NUM_THREADS;
+            i = (data_offset - args->thread_i * READ_BLOCK_SIZE + stride - 1U) / stride * stride;
+            continue;
+        }
+
         // Чтение данных в буфер.
-        ssize_t bytes_read = pread(args->src_fd, args->buffer, READ_BLOCK_SIZE, offset);
+        uint64_t read_start = ENABLE_TELEMETRY? io_telemetry_submit(args->telemetry) : 0U;
+
+        ssize_t bytes_read = pread(args->src_fd, buffer, READ_BLOCK_SIZE, offset);
         if (bytes_read == -1)
         {
             fprintf(stderr, "Unable to read block [%x, %x)\n", i, i + READ_BLOCK_SIZE);
             exit(EXIT_FAILURE);
         }
 
+        if (ENABLE_TELEMETRY)
+        {
+            io_telemetry_complete(args->telemetry, IO_OP_READ, read_start, bytes_read);
+        }
+
+        // Считаем контрольную сумму, пока блок находится в буфере.
+        if (ENABLE_CHECKSUM)
+        {
+            file_digest_update(args->digest, offset, buffer, bytes_read);
+        }
+
         // Запись данных из буфера.
-        ssize_t bytes_written = pwrite(args->dst_fd, args->buffer, bytes_read, offset);
-        if (bytes_written == -1 || bytes_written != bytes_read)
+        // Нулевой блок не записываем: на его месте в файле останется "дыра".
+        if (!ENABLE_ZERO_PUNCH || !block_is_zero(buffer, bytes_read))
         {
-            fprintf(stderr, "Unable to write block [%x, %lx)\n", i, i + bytes_read);
-            exit(EXIT_FAILURE);
+            // При O_DIRECT неполный последний блок дописывается нулями до выровненного размера.
+            ssize_t write_size = ENABLE_DIRECT_IO? (ssize_t) dio_write_size(bytes_read, READ_BLOCK_SIZE) : bytes_read;
+            memset(buffer + bytes_read, 0, write_size - bytes_read);
+
+            uint64_t write_start = ENABLE_TELEMETRY? io_telemetry_submit(args->telemetry) : 0U;
+
+            ssize_t bytes_written = pwrite(args->dst_fd, buffer, write_size, offset);
+            if (bytes_written == -1 || bytes_written != write_size)
+            {
+                fprintf(stderr, "Unable to write block [%x, %lx)\n", i, i + bytes_read);
+                exit(EXIT_FAILURE);
+            }
+
+            if (ENABLE_TELEMETRY)
+            {
+                io_telemetry_complete(args->telemetry, IO_OP_WRITE, write_start, bytes_read);
+            }
+        }
+        else if (!ENABLE_SPARSE_COPY)
+        {
+            punch_zero_block(args->dst_fd, offset, bytes_read);
+        }
+
+        // Поток, дописавший окно последним, сбрасывает его на диск.
+        if (ENABLE_WRITEBACK)
+        {
+            int64_t window = writeback_account(args->writeback, offset, bytes_read);
+            if (window != WRITEBACK_NO_WINDOW)
+            {
+                writeback_flush_window(args->writeback, window);
+            }
         }
 
         i += READ_BLOCK_SIZE * NUM_THREADS;
@@ -70,6 +153,9 @@ void* thread_func(void* thread_args)
         }
     }
 
+    // Возвращаем буфер в пул.
+    buffer_pool_release(args->pool, buffer);
+
     return NULL;
 }
 
@@ -92,14 +178,46 @@ int main(int argc, char* argv[])
 
     // Открываем результирующий файл и аллоцируем место на диске.
     int dst_fd;
-    open_dst_file(argv[2], &dst_fd, src_size);
+    open_dst_file(argv[2], &dst_fd, src_size, !ENABLE_SPARSE_COPY, ENABLE_DIRECT_IO);
 
-    // Выделяем память для промежуточного буфера.
-    uint8_t* buffer = (uint8_t*) aligned_alloc(READ_BLOCK_SIZE, READ_BLOCK_SIZE * NUM_THREADS);
-    if (buffer == NULL)
+    // Проверяем, что размер блока удовлетворяет требованиям прямого ввода-вывода.
+    if (ENABLE_DIRECT_IO)
     {
-        fprintf(stderr, "Unable to allocate aligned buffer\n");
-        exit(EXIT_FAILURE);
+        check_dio_alignment(src_fd, argv[1], READ_BLOCK_SIZE);
+        check_dio_alignment(dst_fd, argv[2], READ_BLOCK_SIZE);
+    }
+
+    // Определяем отрезки исходного файла, содержащие данные.
+    FILE_EXTENTS extents;
+    file_extents_scan(src_fd, src_size, READ_BLOCK_SIZE, ENABLE_SPARSE_COPY, &extents);
+
+    // Инициализируем управление сбросом данных на диск.
+    WRITEBACK_CONTROLLER writeback;
+    if (ENABLE_WRITEBACK)
+    {
+        writeback_init(&writeback, dst_fd, &extents, WRITEBACK_WINDOW_SIZE);
+    }
+
+    // Создаём пул промежуточных буферов: по одному буферу на поток.
+    BUFFER_POOL pool;
+    buffer_pool_init(&pool, READ_BLOCK_SIZE, NUM_THREADS);
+
+    // Контрольные суммы блоков файла.
+    FILE_DIGEST digest;
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_init(&digest, src_size, READ_BLOCK_SIZE);
+    }
+
+    // Телеметрия: каждый поток ведёт собственную, без синхронизации.
+    // Периодический вывод JSON выполняет только поток 0.
+    IO_TELEMETRY telemetry;
+    io_telemetry_init(&telemetry, ENABLE_TELEMETRY, 0U);
+
+    static IO_TELEMETRY thread_telemetry[NUM_THREADS];
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        io_telemetry_init(&thread_telemetry[i], ENABLE_TELEMETRY, (i == 0U)? TELEMETRY_INTERVAL_NS : 0U);
     }
 
     //=======================
@@ -110,11 +228,15 @@ int main(int argc, char* argv[])
     THREAD_ARGS args[NUM_THREADS];
     for (size_t i = 0U; i < NUM_THREADS; ++i)
     {
-        args[i].thread_i = i;
-        args[i].buffer   = &buffer[i * READ_BLOCK_SIZE];
-        args[i].src_size = src_size;
-        args[i].src_fd   = src_fd;
-        args[i].dst_fd   = dst_fd;
+        args[i].thread_i  = i;
+        args[i].pool      = &pool;
+        args[i].src_size  = src_size;
+        args[i].src_fd    = src_fd;
+        args[i].dst_fd    = dst_fd;
+        args[i].digest    = &digest;
+        args[i].extents   = &extents;
+        args[i].writeback = &writeback;
+        args[i].telemetry = &thread_telemetry[i];
     }
 
     // Запуск потоков.
@@ -173,8 +295,31 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Объединяем телеметрию потоков и выводим сводку.
+    for (size_t i = 0U; i < NUM_THREADS; ++i)
+    {
+        io_telemetry_merge(&telemetry, &thread_telemetry[i]);
+    }
+
+    io_telemetry_report(&telemetry);
+
     // Закрываем файлы.
     close_src_dst_files(argv[1], src_fd, src_size, argv[2], dst_fd);
 
+    // Выводим контрольную сумму и, при необходимости, сверяем её с записанным файлом.
+    if (ENABLE_CHECKSUM)
+    {
+        file_digest_report(&digest, argv[2], ENABLE_VERIFY);
+        file_digest_free(&digest);
+    }
+
+    buffer_pool_free(&pool);
+    file_extents_free(&extents);
+
+    if (ENABLE_WRITEBACK)
+    {
+        writeback_free(&writeback);
+    }
+
     return EXIT_SUCCESS;
 }
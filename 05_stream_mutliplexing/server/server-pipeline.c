@@ -0,0 +1,360 @@
+// Сopyright Vladislav Aleinik, 2025
+#include "server-common.h"
+
+// Кольцевой буфер SPSC и стратегии ожидания.
+#define ENABLE_PADDING 1
+#include "../../03_circular_buffer/circular-buffer.h"
+#include "../../03_circular_buffer/wait-strategy.h"
+
+#include <sched.h>
+#include <pthread.h>
+
+//=====================
+// Параметры конвейера
+//=====================
+
+// Размер блока, считываемого с диска одним вызовом pread().
+#define PIPELINE_BLOCK_SIZE (1U << 20U)
+// Количество блоков в пуле.
+#define NUM_PIPELINE_BLOCKS 8U
+
+// Размер колец: в обращении находятся все блоки пула и дескриптор конца передачи.
+#define PIPELINE_RING_SIZE (2U * NUM_PIPELINE_BLOCKS)
+
+// Число итераций активного ожидания перед сном на фьютексе.
+#define PIPELINE_NUM_SPINS 1000U
+
+#define NUM_HARDWARE_THREADS 4U
+
+//=====================================
+// Конвейер чтение с диска -> отправка
+//=====================================
+// Поток-читатель заранее считывает крупные блоки файла в пул буферов
+// и передаёт их дескрипторы потоку-отправителю через кольцо full.
+// Отправитель только пишет в сокет и возвращает буферы читателю через кольцо free.
+// Задержка чтения с диска перекрывается отправкой предыдущих блоков по сети.
+//
+// Дескриптор блока: младшие 32 бита - номер буфера в пуле, старшие - длина данных.
+// Дескриптор с нулевой длиной означает ошибку чтения, PIPELINE_END - конец передачи.
+
+#define PIPELINE_END UINT64_MAX
+
+typedef struct
+{
+    QUEUE ring;
+    // Уведомление о появлении элемента в кольце.
+    EVENTCOUNT not_empty;
+} PIPELINE_RING;
+
+typedef struct
+{
+    FILESHARE_SERVER* server;
+    FILESHARE_CONNECTION* conn;
+
+    // Пул буферов.
+    uint8_t* blocks;
+
+    // Заполненные блоки: читатель -> отправитель.
+    PIPELINE_RING full;
+    // Свободные блоки: отправитель -> читатель.
+    PIPELINE_RING free;
+
+    // Отправитель прекратил передачу: читателю больше не нужно читать файл.
+    _Atomic bool aborted;
+} PIPELINE;
+
+const WAIT_STRATEGY pipeline_wait = {.kind = WAIT_FUTEX, .num_spins = PIPELINE_NUM_SPINS};
+
+uint64_t pipeline_desc(uint32_t block_i, uint32_t len)
+{
+    return ((uint64_t) len << 32U) | block_i;
+}
+
+bool pipeline_ring_not_empty(void* arg)
+{
+    QUEUE* ring = &((PIPELINE_RING*) arg)->ring;
+
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+void pipeline_ring_send(PIPELINE_RING* ring, uint64_t desc)
+{
+    // Кольцо вмещает все дескрипторы в обращении: переполнение - ошибка программы.
+    if (!queue_enqueue(&ring->ring, desc))
+    {
+        fprintf(stderr, "[PIPELINE] Ring overflow\n");
+        exit(EXIT_FAILURE);
+    }
+
+    wait_notify(&pipeline_wait, &ring->not_empty);
+}
+
+uint64_t pipeline_ring_recv(PIPELINE_RING* ring)
+{
+    uint64_t desc;
+    while (!queue_dequeue(&ring->ring, &desc))
+    {
+        wait_for(&pipeline_wait, &ring->not_empty, pipeline_ring_not_empty, ring);
+    }
+
+    return desc;
+}
+
+void pipeline_init(PIPELINE* pipeline, FILESHARE_SERVER* server, FILESHARE_CONNECTION* conn, uint8_t* blocks)
+{
+    pipeline->server = server;
+    pipeline->conn = conn;
+    pipeline->blocks = blocks;
+
+    queue_init(&pipeline->full.ring, PIPELINE_RING_SIZE);
+    queue_init(&pipeline->free.ring, PIPELINE_RING_SIZE);
+    eventcount_init(&pipeline->full.not_empty);
+    eventcount_init(&pipeline->free.not_empty);
+
+    atomic_init(&pipeline->aborted, false);
+
+    // Изначально все буферы пула свободны.
+    for (uint32_t block_i = 0U; block_i < NUM_PIPELINE_BLOCKS; ++block_i)
+    {
+        pipeline_ring_send(&pipeline->free, pipeline_desc(block_i, 0U));
+    }
+}
+
+void pipeline_free(PIPELINE* pipeline)
+{
+    queue_free(&pipeline->full.ring);
+    queue_free(&pipeline->free.ring);
+}
+
+//================
+// Поток-читатель
+//================
+
+void* pipeline_reader(void* arg)
+{
+    PIPELINE* pipeline = (PIPELINE*) arg;
+    const FILESHARE_SERVER* server = pipeline->server;
+
+    size_t offset = 0U;
+    while (offset < server->src_file_size && !atomic_load_explicit(&pipeline->aborted, memory_order_relaxed))
+    {
+        // Ждём свободный буфер.
+        uint32_t block_i = (uint32_t) pipeline_ring_recv(&pipeline->free);
+        uint8_t* block = pipeline->blocks + (size_t) block_i * PIPELINE_BLOCK_SIZE;
+
+        size_t to_read = server->src_file_size - offset;
+        to_read = (to_read < PIPELINE_BLOCK_SIZE)? to_read : PIPELINE_BLOCK_SIZE;
+
+        ssize_t bytes_read = pread(server->src_file_fd, block, to_read, offset);
+        if (bytes_read <= 0)
+        {
+            fprintf(stderr, "Unable to read data from file\n");
+
+            // Возвращаем буфер отправителю с нулевой длиной - признаком ошибки.
+            pipeline_ring_send(&pipeline->full, pipeline_desc(block_i, 0U));
+            break;
+        }
+
+        offset += bytes_read;
+
+        // Передаём заполненный блок отправителю.
+        pipeline_ring_send(&pipeline->full, pipeline_desc(block_i, bytes_read));
+    }
+
+    pipeline_ring_send(&pipeline->full, PIPELINE_END);
+
+    return NULL;
+}
+
+//===================
+// Поток-отправитель
+//===================
+
+bool pipeline_send_all(int sock_fd, const uint8_t* data, size_t len)
+{
+    while (len != 0U)
+    {
+        ssize_t bytes_written = write(sock_fd, data, len);
+        if (bytes_written <= 0)
+        {
+            return false;
+        }
+
+        data += bytes_written;
+        len  -= bytes_written;
+    }
+
+    return true;
+}
+
+// Передаёт файл через конвейер. Отправителем выступает вызывающий поток.
+bool server_send_file_pipeline(PIPELINE* pipeline, size_t hart_i)
+{
+    // Инициализируем аттрибуты потока.
+    pthread_attr_t thread_attributes;
+    int ret = pthread_attr_init(&thread_attributes);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_init\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Читатель работает на соседнем аппаратном потоке.
+    cpu_set_t assigned_harts;
+    CPU_ZERO(&assigned_harts);
+    CPU_SET(hart_i % NUM_HARDWARE_THREADS, &assigned_harts);
+
+    // Устанавливаем аффинность потока.
+    ret = pthread_attr_setaffinity_np(&thread_attributes, sizeof(cpu_set_t), &assigned_harts);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to call pthread_attr_setaffinity_np\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Создаём поток-читатель.
+    pthread_t reader_tid;
+    ret = pthread_create(&reader_tid, &thread_attributes, pipeline_reader, pipeline);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to create thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Удаляем объект с аттрибутами потока.
+    pthread_attr_destroy(&thread_attributes);
+
+    bool success = true;
+    while (true)
+    {
+        uint64_t desc = pipeline_ring_recv(&pipeline->full);
+        if (desc == PIPELINE_END)
+        {
+            break;
+        }
+
+        uint32_t block_i = (uint32_t) desc;
+        uint32_t len = (uint32_t) (desc >> 32U);
+
+        if (len == 0U)
+        {
+            success = false;
+        }
+
+        // После ошибки блоки только возвращаются читателю, пока он не остановится.
+        if (success)
+        {
+            const uint8_t* block = pipeline->blocks + (size_t) block_i * PIPELINE_BLOCK_SIZE;
+
+            success = pipeline_send_all(pipeline->conn->client_sock_fd, block, len);
+            if (success)
+            {
+                pipeline->conn->src_file_offset += len;
+            }
+            else
+            {
+                fprintf(stderr, "Unable to send data block to client\n");
+                atomic_store_explicit(&pipeline->aborted, true, memory_order_relaxed);
+            }
+        }
+
+        // Возвращаем буфер читателю.
+        pipeline_ring_send(&pipeline->free, pipeline_desc(block_i, 0U));
+    }
+
+    ret = pthread_join(reader_tid, NULL);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to join thread\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return success;
+}
+
+//============================
+// Основная процедура сервера
+//============================
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: server <src-file> <num-clients>\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char* endptr = argv[2];
+    long num_clients = strtol(argv[2], &endptr, 10);
+    if (*argv[2] == '\0' || *endptr != '\0')
+    {
+        fprintf(stderr, "Unable to parse number of clients!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Структура данных с представлением сервера.
+    FILESHARE_SERVER server;
+
+    // Открываем файл для раздачи.
+    const char* src_filename = argv[1];
+    server_open_src_file(&server, src_filename);
+
+    // Пул буферов конвейера используется всеми клиентами по очереди.
+    uint8_t* blocks = (uint8_t*) malloc((size_t) NUM_PIPELINE_BLOCKS * PIPELINE_BLOCK_SIZE);
+    if (blocks == NULL)
+    {
+        fprintf(stderr, "Unable to allocate pipeline blocks\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Настраиваем действие по нажатию Ctrl+C в консоли.
+    // Код сервера не использует этот механизим.
+    // Возмодное адекватное применение - окончание подключений новых клиентов.
+    init_shutdown_control();
+
+    // Активируем подключение клиентов.
+    server_init_listen_socket(&server);
+
+    // Создаём соединие с клиентом.
+    FILESHARE_CONNECTION conn;
+
+    for (long client_i = 0; !program_in_shutdown() && client_i < num_clients; ++client_i)
+    {
+        // Ждём подключения одного клиента.
+        bool success = server_accept_connection_request(&server, &conn);
+        if (!success)
+        {
+            break;
+        }
+
+        // Передаём размер файла клиенту.
+        success = server_send_file_size(&server, &conn);
+        if (!success)
+        {
+            server_close_conn_socket(&conn);
+            continue;
+        }
+
+        // Передаём файл по сети через конвейер.
+        PIPELINE pipeline;
+        pipeline_init(&pipeline, &server, &conn, blocks);
+
+        server_send_file_pipeline(&pipeline, 1U);
+
+        pipeline_free(&pipeline);
+
+        server_close_conn_socket(&conn);
+    }
+
+    free(blocks);
+
+    // Останавливаем приём новых клиентов.
+    server_close_listen_socket(&server);
+    // Закрываем файл.
+    server_close_src_file(&server);
+
+    printf("Transfer finished\n");
+
+    return EXIT_SUCCESS;
+}